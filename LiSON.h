@@ -25,6 +25,19 @@
 #include <variant>
 #include <functional>
 #include <optional>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <tuple>
+#include <type_traits>
+#include <charconv>
+#ifdef LISON_TRACE
+#include <chrono>
+#endif
 
 /**
  * LiSON - LiSp Object Notation
@@ -65,7 +78,10 @@
  * The Object class has some functions to easily access the inside data of the Object. These
  * are the expectLiteralData, expectObjectData and foreachObjectData. The functions starting with
  * expect return an optional of the literal's or the object's contents and the foreach can take a
- * function of type const Object& -> void. Adding an Object to another instance of object can be
+ * function of type const Object& -> void. The expectLiteralView, expectObjectList and visitObjectData
+ * variants do the same without copying: they return a string_view or a pointer into the object
+ * and the visitor is inlined instead of being wrapped in a std::function.
+ * Adding an Object to another instance of object can be
  * done with the add function. The Object class also provides factory methods to create itself
  * from strings, LiSON implementations and even arbitrary objects with a conversion functon provided.
  * Other way of accessing the inner data is the overload pattern and std::visit() functions, seen
@@ -73,8 +89,81 @@
  * works with type specific lambda functions that get matched to the actual value of the std::variant.
  * The LiSON interface does the conversion between Object and custom class.
  *
+ * When no tree is needed at all, Parser::parse can also drive a Handler: it gets on_list_begin,
+ * on_list_end and on_literal calls in document order, so the input is processed in constant memory.
+ * The Object and Document trees are built by such handlers (ObjectBuilder, DocumentBuilder).
+ *
+ * For single lookups the Cursor navigates the source text itself (child, next_sibling, literal),
+ * skipping the unneeded elements by counting parens instead of parsing them.
+ *
+ * For big documents there is also a flat representation, the Document. It stores every node
+ * in one contiguous array in document order and every literal in one pool, and can be read through
+ * the Object-like DocumentView. It is created by Parser::parseDocument or Document::fromObject.
+ *
+ * A big top-level list can be parsed on several threads with the ParallelParser: the children
+ * of the root are split into ranges by a pre-scan of the parens, and the parts are joined in order
+ * into the same Object or Document the Parser would give.
+ *
+ * Files with one document per line (LiSON lines) are read by the LinesReader, one at a time with
+ * next, or on a pool of threads with forEach (in the order of the file or as they are done), and
+ * written by the LinesWriter. Only a few batches of lines are in memory at a time.
+ *
  * The serialization process can be done with the Serializer class, and its pre-implemented
  * convenience operators.
+ * Objects are written with Object::write in a single pass into a string or a stream, either in
+ * the padded format of to_string, or in the compact one (Write_Compact) without the extra spaces.
+ * Big lists are written on several threads by the ParallelWriter (Serializer::write uses it):
+ * the runs of siblings are written into buffers of their own at the same time, and the buffers
+ * go to the file in order, with the same bytes as Object::write.
+ *
+ * With LISON_TRACE defined, a Trace can be attached to a LiSON or a Serializer (set_trace). It gets
+ * the calls, the time and the bytes of every stage (read, parse, interpret, revert, write), and the
+ * number of symbols, nodes and literal bytes and the deepest nesting of the parsed sources, as a plain
+ * Metrics struct. Without the define none of it is compiled in.
+ *
+ * Object::memoryUsage and Document::memoryUsage report the nodes, the literal bytes, the overhead of
+ * the containers and the heap bytes of a tree, so the representations can be compared by bytes per
+ * node. With LISON_COUNT_ALLOCATIONS defined the library replaces the global operator new and delete
+ * and counts every allocation (Allocations::stats), and a Trace gets the allocations of every stage.
+ *
+ * The lists and the literals of an Object are std::pmr containers (ObjectList, std::pmr::string).
+ * A Parser or an ObjectBuilder given a memory resource (set_memory_resource) builds the whole tree in
+ * it, so a document can be parsed into a std::pmr::monotonic_buffer_resource and released at once.
+ * The copies of an Object always go to the default resource.
+ *
+ * A Parser given a SymbolTable (set_symbols) interns the short literals of its Documents: each
+ * distinct literal is stored once in the table, and the nodes only hold its id. The table can be
+ * shared by the documents, and a key is looked up by comparing ids: find the id once with
+ * SymbolTable::find, then compare it to DocumentView::symbol.
+ *
+ * Structs can also be bound without a LiSON class: LISON_SCHEMA lists the fields of a struct once,
+ * and Binder::read parses a source right into the members (a struct is a list of ('name' value)
+ * pairs, std::vector and std::list are lists, strings are literals, numbers are native numbers
+ * or literals, bool is 'true' or 'false'), while Binder::write and Binder::to_string write them
+ * back. No Object is built on the way, the binding is resolved at compile time on the PullParser,
+ * and any other type can be bound by specializing Binding.
+ *
+ * Numbers can also be written without quotes: 42, -7, 0.25 or 1e+300 are native integers and floats
+ * (Tkn_Integer, Tkn_Float, Object::fromInteger, Object::fromFloat), parsed and written with
+ * std::from_chars and std::to_chars without a string on the way. A float is always written so that
+ * it is read back as a float with the same value (100.0, not 100). A number too large for an int64
+ * or a double is kept as a literal of its digits (by the parsers and the Cursor alike), so it is
+ * written back quoted, and infinities and NaN are written as quoted literals too. The handlers and
+ * writers that don't know about numbers (on_integer, on_float, integer, floating) get their text as
+ * a literal, and expectFloat also accepts an integer.
+ *
+ * A LiSON class can also skip the Object completely by overriding emit next to revert:
+ * it writes its elements (begin_list, end_list, literal) straight to a Writer, which can be a
+ * StringWriter, a buffered StreamWriter or FileWriter, or an ObjectBuilder when a tree is needed
+ * (revert can then just return emitted()).
+ *
+ * There is also a binary encoding of the same data (Object::to_binary, Document::to_binary),
+ * where every literal and list is prefixed with its length, so the Decoder reads it without scanning.
+ * Serializer::encode writes it, and the Serializer recognizes it on read by its header.
+ *
+ * A Document can also be saved as a snapshot (Serializer::snapshot), the node table and the pool
+ * exactly as they are in memory. Snapshot::open maps such a file and reads it in place through
+ * the SnapshotView, so loading it costs the same for any size and the pages are shared between processes.
  *
  * Examples:
  * 1. parsing lison: the MyObj class contains one string, that can be represented as a single
@@ -141,25 +230,109 @@
  */
 namespace lison
 {
-    /**
-     * Structure to hold the actual data and token
-     */
+	/**
+	 * The lists and the literals take their memory from a std::pmr::memory_resource,
+	 * so a whole tree can be parsed into e.g. a monotonic_buffer_resource and released at
+	 * once. The default resource is used if none is given, and by the copies.
+	 */
+	struct Object;
+	using ObjectList = std::pmr::list<Object>;
 
 	struct Tkn_Literal
 	{
-		std::string value;
+		std::pmr::string value;
+		Tkn_Literal() = default;
+		Tkn_Literal(std::string_view _value, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 	};
 
-	struct Object;
 	struct Tkn_Object
 	{
-		std::list<Object> value;
+		ObjectList value;
 	};
 
 	struct Tkn_Error
 	{};
 
-	using Token = std::variant<Tkn_Literal,Tkn_Object,Tkn_Error>;
+	// unquoted number literals
+	struct Tkn_Integer
+	{
+		std::int64_t value;
+	};
+
+	struct Tkn_Float
+	{
+		double value;
+	};
+
+	using Token = std::variant<Tkn_Literal,Tkn_Object,Tkn_Error,Tkn_Integer,Tkn_Float>;
+
+	enum NumberType
+	{
+		Number_None,
+		Number_Integer,
+		Number_Float,
+		// a number out of the range of both, kept as a literal of its text
+		Number_Large,
+	};
+
+	/**
+	 * Text of the unquoted number literals.
+	 * A number starts with a digit or a minus sign. It is an integer if it fits in an
+	 * std::int64_t, a float if it has a '.' or an exponent and fits in a double, and a
+	 * literal of its text otherwise, so no digit is lost (it is written back quoted, as
+	 * any literal). They are read with std::from_chars and written with
+	 * std::to_chars in the shortest form that reads back the same (a float always gets a
+	 * '.' or an exponent), so they round-trip exactly and don't depend on the locale.
+	 * The infinite and NaN floats have no number form ("inf", "nan" would not read back as
+	 * numbers), the writers write them as literals.
+	 */
+	class Number
+	{
+	public:
+		// room for the longest number, to format into
+		static constexpr std::size_t MaxLength = 32;
+
+		static NumberType parse(std::string_view text, std::int64_t& integer, double& floating);
+		// the buffer has to be MaxLength long
+		static std::string_view format(std::int64_t value, char* buffer);
+		static std::string_view format(double value, char* buffer);
+		// a float as it is stored in a Node
+		static std::uint64_t toBits(double value);
+		static double fromBits(std::uint64_t bits);
+	};
+
+	/**
+	 * Output formats of the writers.
+	 * Padded is the original one with a space after every element: ( 'a' 'b' ) 
+	 * Compact leaves only the spaces between the elements: ('a' 'b')
+	 */
+	enum WriteMode
+	{
+		Write_Padded,
+		Write_Compact,
+	};
+
+	/**
+	 * Memory taken by an Object tree or a Document, estimated from the sizes of the
+	 * containers (the bookkeeping of the allocator itself is not counted).
+	 * Every byte is either literal data or overhead of the representation, so the two
+	 * representations can be compared by bytes per node.
+	 */
+	struct MemoryReport
+	{
+		std::size_t nodes = 0;
+		std::size_t lists = 0;
+		std::size_t literals = 0;
+		// the characters of the literals
+		std::size_t literalBytes = 0;
+		// everything else: list links, variants, nodes, unused capacity
+		std::size_t containerBytes = 0;
+		// allocated on the heap, the root itself may not be
+		std::size_t heapBytes = 0;
+
+		std::size_t totalBytes() const;
+		double bytesPerNode() const;
+	};
 
 	template <class... Ts>
 	struct overload : Ts...
@@ -171,16 +344,36 @@ namespace lison
 	overload(Ts...) -> overload<Ts...>;
 
 	class LiSON;
+	class Serializer;
+	class Writer;
 	struct Object
 	{
 		Token token;
 		Object(const Token& t); 
+		Object(Token&& t);
+		// copying and destroying don't recurse, so any depth is fine
 		Object(const Object& other);
-		~Object() = default;
-		std::string to_string() const;
+		Object(Object&& other) = default;
+		Object& operator =(const Object& other);
+		Object& operator =(Object&& other) = default;
+		~Object();
+		std::string to_string(WriteMode mode = Write_Padded) const;
+
+		// the writer API, appends to a buffer or a stream in one pass
+		void write(std::string& out, WriteMode mode = Write_Padded) const;
+		void write(std::ostream& out, WriteMode mode = Write_Padded) const;
+		void write(Writer& writer) const;
+		// binary encoding, read back by the Decoder
+		std::string to_binary() const;
+		void encode(std::string& out) const;
+		// exact length of the written object, to reserve the buffer in advance
+		std::size_t serializedSize(WriteMode mode = Write_Padded) const;
+		MemoryReport memoryUsage() const;
 
 		// the factory API
 		static Object fromString(const std::string& str);
+		static Object fromInteger(std::int64_t value);
+		static Object fromFloat(double value);
 		static Object fromLiSON(const LiSON& lison);
 
 		template <class T>
@@ -191,23 +384,398 @@ namespace lison
 		// injection
 		void foreachObjectData(
 			std::function<void(const Object&)> f) const;
+		// same as foreach, but the function is inlined instead of wrapped
+		template <class F>
+		void visitObjectData(F&& f) const;
 
 		// adding
 		void add(const Object& obj);
+		void add(Object&& obj);
 
 		// maybe getting
 		std::optional<std::string> expectLiteralData() const;
+		std::optional<std::int64_t> expectInteger() const;
+		// an integer is taken as a float too
+		std::optional<double> expectFloat() const;
+		// a copy of the children, in the default resource
 		std::optional<std::list<Object>> expectObjectData() const;
+
+		// getting without copying, only valid as long as the object is alive
+		std::optional<std::string_view> expectLiteralView() const;
+		const ObjectList* expectObjectList() const;
 	};
 
+	template <class F>
+	void Object::visitObjectData(F&& f) const
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return;
+		for (const Object& it : std::get<Tkn_Object>(token).value)
+			f(it);
+	}
+
+    /**
+     * Receiver of the parser events (SAX-style API).
+     * The parser calls them in document order, without building any tree. The view of a
+     * literal's body (with the whitespaces already folded) is only valid during the call.
+     */
+    class Handler
+    {
+    public:
+        virtual ~Handler() = default;
+        virtual void on_list_begin() = 0;
+        virtual void on_list_end() = 0;
+        virtual void on_literal(std::string_view value) = 0;
+        // the numbers are reported as their text by default
+        virtual void on_integer(std::int64_t value);
+        virtual void on_float(double value);
+        // a top-level element is complete
+        virtual void on_element_end() {}
+        // the source is not valid LiSON, no more events follow
+        virtual void on_error() {}
+    };
+
+    /**
+     * Receiver of the elements to write, the mirror of the Handler.
+     * Anything can be written to it element by element, without building an Object first.
+     */
+    class Writer
+    {
+    public:
+        virtual ~Writer() = default;
+        virtual void begin_list() = 0;
+        virtual void end_list() = 0;
+        virtual void literal(std::string_view value) = 0;
+        // the numbers are written as their text by default
+        virtual void integer(std::int64_t value);
+        virtual void floating(double value);
+        // an element that could not be made (Tkn_Error)
+        virtual void error() {}
+    };
+
+    /**
+     * Writer of the LiSON text.
+     * The text goes to a buffer, that is drained to the actual output by the subclasses
+     * whenever it is over the limit.
+     */
+    class TextWriter : public Writer
+    {
+    private:
+        WriteMode mode;
+        // the last thing written was an element, so the next one needs a separator
+        bool separate = false;
+
+        void element();
+    protected:
+        std::string* out;
+        std::size_t limit;
+
+        virtual void drain() {}
+        void put(char c);
+        void put(std::string_view s);
+        // ends the line, the next element is the first one of a new document
+        void newline();
+    public:
+        TextWriter(std::string* _out, std::size_t _limit, WriteMode _mode);
+        void begin_list() override;
+        void end_list() override;
+        void literal(std::string_view value) override;
+        void integer(std::int64_t value) override;
+        void floating(double value) override;
+        void error() override;
+    };
+
+    // appends to a string
+    class StringWriter : public TextWriter
+    {
+    public:
+        StringWriter(std::string& _out, WriteMode _mode = Write_Padded);
+    };
+
+    // buffered writer of a stream
+    class StreamWriter : public TextWriter
+    {
+    private:
+        std::ostream& stream;
+        std::string buffer;
+    protected:
+        void drain() override;
+    public:
+        static constexpr std::size_t BufferSize = 64 * 1024;
+        StreamWriter(std::ostream& _stream, WriteMode _mode = Write_Padded);
+        ~StreamWriter();
+        void flush();
+    };
+
+    // buffered writer of a file
+    class FileWriter : public TextWriter
+    {
+    private:
+        std::ofstream file;
+        std::string buffer;
+    protected:
+        void drain() override;
+    public:
+        FileWriter(const std::string& filename, WriteMode _mode = Write_Padded);
+        ~FileWriter();
+        bool is_open() const;
+        void flush();
+    };
+
+    /**
+     * events -> writer, e.g. to reformat a source without a tree
+     */
+    class WriteHandler : public Handler
+    {
+    private:
+        Writer& writer;
+    public:
+        WriteHandler(Writer& _writer);
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_error() override;
+    };
+
+    /**
+     * events -> Object
+     * It takes the elements both from a parser (Handler) and from a Writer.
+     */
+    class ObjectBuilder : public Handler, public Writer
+    {
+    private:
+        Object result;
+        // the lists that are still open, the pointers stay valid in the std::list
+        std::vector<Object*> open;
+        std::pmr::memory_resource* resource;
+
+        Object& add(Token&& token);
+    public:
+        // the objects are built in the resource, it must outlive them
+        ObjectBuilder(std::pmr::memory_resource* _resource = std::pmr::get_default_resource());
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_error() override;
+        void begin_list() override;
+        void end_list() override;
+        void literal(std::string_view value) override;
+        void integer(std::int64_t value) override;
+        void floating(double value) override;
+        void error() override;
+        Object take();
+    };
+
+    /**
+     * events -> one Object for every top-level element, as soon as it is closed
+     */
+    class ObjectStream : public ObjectBuilder
+    {
+    private:
+        std::function<void(Object&&)> f;
+    public:
+        ObjectStream(std::function<void(Object&&)> _f, std::pmr::memory_resource* _resource = std::pmr::get_default_resource());
+        void on_element_end() override;
+    };
+
+    /**
+     * Flat representation of a document.
+     * The nodes are stored in one contiguous array in document order, a list is followed
+     * by its children, and every node knows its parent and the index right after its own
+     * subtree (that is where the next sibling starts, if there is one). The literals are
+     * stored back to back in one pool, the nodes only hold spans into it.
+     * Walking the array from the front to the back visits the whole document in order.
+     *
+     * In borrowed mode the literals are not copied: a node points right into the source
+     * buffer, only the literals with folded whitespaces get into the pool. Such a document
+     * needs the source to be alive (that is taken care of, if it is a SourceBuffer), or it
+     * can be materialized to own every literal.
+     */
+    enum NodeType : std::uint16_t
+    {
+        Node_Literal,
+        Node_List,
+        Node_Error,
+        // the value is in the offset, a float by its bits
+        Node_Integer,
+        Node_Float,
+    };
+
+    enum NodeFlag : std::uint16_t
+    {
+        Node_Borrowed = 1,      // the literal is in the source, not in the pool
+        Node_Interned = 2,      // the offset is the id of the literal in the symbol table
+    };
+
+    enum DocumentMode
+    {
+        Document_Owned,
+        Document_Borrowed,
+    };
+
+    struct Node
+    {
+        NodeType type;
+        std::uint16_t flags;
+        std::uint32_t parent;   // index of the parent, the root points to itself
+        std::uint32_t next;     // index after the subtree
+        std::uint32_t length;   // literal: size in the pool, list: number of children
+        std::uint64_t offset;   // literal: start in the pool (or the source), number: the value
+    };
+
+    class Document;
+    class SourceBuffer;
+
+    /**
+     * Table of interned literals: every distinct literal is stored once, and gets a small
+     * id in the order they were first seen. The names stay where they are as long as the
+     * table is alive, so two interned literals are equal if their ids are.
+     * It is not synchronized, a table shared by several documents must be filled by one
+     * parser at a time.
+     */
+    class SymbolTable
+    {
+    private:
+        // a deque, so the names don't move when it grows
+        std::deque<std::string> names;
+        std::unordered_map<std::string_view, std::uint32_t> ids;
+    public:
+        // longer literals are rarely repeated, they are not interned
+        static constexpr std::size_t MaxLength = 64;
+
+        std::uint32_t intern(std::string_view name);
+        std::optional<std::uint32_t> find(std::string_view name) const;
+        std::string_view name(std::uint32_t id) const;
+        std::size_t size() const;
+    };
+
+    /**
+     * Read-only Object-like view of a node of a Document.
+     * Only valid as long as the Document is alive.
+     */
+    class DocumentView
+    {
+    private:
+        const Document* doc = nullptr;
+        std::uint32_t index = 0;
+    public:
+        DocumentView() = default;
+        DocumentView(const Document* _doc, std::uint32_t _index);
+
+        bool valid() const;
+        NodeType type() const;
+        // number of children of a list
+        std::size_t size() const;
+        DocumentView child(std::size_t i) const;
+        DocumentView parent() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+        Object toObject() const;
+
+        void foreachObjectData(
+            std::function<void(const DocumentView&)> f) const;
+        template <class F>
+        void visitObjectData(F&& f) const;
+        std::optional<std::string_view> expectLiteralData() const;
+        std::optional<std::int64_t> expectInteger() const;
+        std::optional<double> expectFloat() const;
+        // id of an interned literal in the symbol table of the document
+        std::optional<std::uint32_t> symbol() const;
+    };
+
+    class Document
+    {
+    friend class DocumentView;
+    friend class DocumentBuilder;
+    friend class ParallelParser;
+    private:
+        std::vector<Node> nodes;
+        std::string pool;
+        // the source of the borrowed literals, the owner keeps it alive
+        std::string_view source;
+        std::shared_ptr<const SourceBuffer> owner;
+        // the table of the interned literals, if they are interned
+        std::shared_ptr<const SymbolTable> symbolTable;
+
+        std::string_view literal(const Node& n) const;
+        // appends the nodes of a subtree in document order
+        void write(std::uint32_t from, std::uint32_t to, std::string& out, WriteMode mode) const;
+        // the nodes of a subtree to a writer, an error node is an error element like in the Object
+        void write(std::uint32_t from, std::uint32_t to, Writer& writer) const;
+    public:
+        Document() = default;
+        static Document fromObject(const Object& obj);
+
+        DocumentView root() const;
+        std::size_t size() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+        std::string to_binary() const;
+        void encode(std::string& out) const;
+        // the node table and the pool as they are, to be mapped by a Snapshot
+        std::string to_snapshot() const;
+        // the borrowed and the interned literals are not counted, they belong to the source and the table
+        MemoryReport memoryUsage() const;
+
+        bool borrowed() const;
+        const SymbolTable* symbols() const;
+        // copies the borrowed and the interned literals into the pool, the source and the
+        // symbol table are not needed after it
+        void materialize();
+    };
+
+    /**
+     * events -> Document
+     */
+    class DocumentBuilder : public Handler
+    {
+    private:
+        Document doc;
+        std::vector<std::uint32_t> open;
+        std::shared_ptr<SymbolTable> symbols;
+        bool failed = false;
+
+        // false if the document has no room for one more node
+        bool add(NodeType type);
+    public:
+        DocumentBuilder() = default;
+        // borrowed mode: the literals that are in the source are not copied
+        DocumentBuilder(std::string_view source, std::shared_ptr<const SourceBuffer> owner = nullptr);
+        // the short literals are interned in the table instead of being copied
+        void set_symbols(std::shared_ptr<SymbolTable> _symbols);
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_error() override;
+        Document take();
+    };
+
+    template <class F>
+    void DocumentView::visitObjectData(F&& f) const
+    {
+        if (type() != Node_List)
+            return;
+        const std::vector<Node>& nodes = doc->nodes;
+        for (std::uint32_t c = index + 1; c < nodes[index].next; c = nodes[c].next)
+            f(DocumentView(doc, c));
+    }
+
     /**
      * string -> set of symbols
-     * conversion class
      */
     class Tokenizer
     {
     friend class Parser;
     friend class LiSON;
+    friend class Lexer;
+    friend class PushParser;
+    friend class PullParser;
+    friend class ParallelParser;
+    friend class LinesReader;
     private:
         enum Symbol
         {
@@ -226,440 +794,4884 @@ namespace lison
         };
 
         SymbolObject actual;
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+        static Symbol classify(char c);
     public:
         Tokenizer() = default;
-        std::list<SymbolObject> tokenize(const std::string& src);
+        // the symbol lists are allocated from it
+        void set_memory_resource(std::pmr::memory_resource* _resource);
+        std::pmr::list<SymbolObject> tokenize(const std::string& src);
+    };
+
+    /**
+     * Bitmasks of the structural characters of a 64 byte block of the source,
+     * bit i of each mask belongs to the i-th byte of the block.
+     */
+    struct BlockMasks
+    {
+        std::uint64_t quote;
+        std::uint64_t leftParen;
+        std::uint64_t rightParen;
+        std::uint64_t whitespace;
+    };
+
+    /**
+     * Vectorized classification of the source, a block at a time.
+     * The implementation is chosen at runtime from what the CPU supports
+     * (AVX-512, AVX2, SSE2), with the plain scalar loop as fallback.
+     */
+    class Scanner
+    {
+    public:
+        static constexpr std::size_t BlockSize = 64;
+
+        // classifies a block, shorter blocks are padded with non-structural bytes
+        static BlockMasks classify(const char* block, std::size_t length);
+        // bits of the block that are inside a literal (opening quote included, closing excluded)
+        // inside carries the state between consecutive blocks
+        static std::uint64_t literalMask(std::uint64_t quote, bool& inside);
+
+        // name of the active implementation
+        static const char* implementation();
+        // forces an implementation by name, false if the CPU does not have it (safe while parsing)
+        static bool select(const std::string& name);
+    };
+
+    /**
+     * string -> one symbol at a time
+     * cursor over the source, the parser pulls the symbols from it
+     * without building the intermediate symbol list
+     */
+    class Lexer
+    {
+    friend class Parser;
+    friend class PushParser;
+    friend class PullParser;
+    friend class Cursor;
+    private:
+        std::string_view src;
+        std::size_t pos = 0;
+        // structural characters of the block that was scanned last
+        std::size_t block = std::string_view::npos;
+        std::uint64_t structural = 0;
+
+        Tokenizer::Symbol peek() const;
+        void advance();
+        bool done() const;
+        // consumes the characters and whitespaces until the next structural symbol
+        std::string_view literal();
+        // consumes the characters of an unquoted literal, until a structural symbol or a whitespace
+        std::string_view number();
+        // whitespaces of a literal body are folded to spaces, the buffer is only used if needed
+        static std::string_view fold(std::string_view body, std::string& buffer);
+    public:
+        Lexer() = default;
+        Lexer(std::string_view _src);
     };
 
     /**
      * set of symbols -> Object (abstract syntax tree)
-     * conversion class
      */
     class Parser
     {
     private:
-        std::list<Tokenizer::SymbolObject>::iterator iter;
-        std::list<Tokenizer::SymbolObject>::iterator endIter;
+        Lexer lexer;
+        // literal with folded whitespaces, only used if the source has to be changed
+        std::string folded;
+        std::size_t maxDepth = DefaultMaxDepth;
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+        std::shared_ptr<SymbolTable> symbols;
 
         bool accept(Tokenizer::Symbol req);
-        char character();
-        Object literal();
-        Object object();
+        bool literal(Handler& handler);
+        bool number(Handler& handler);
+        bool object(Handler& handler);
     public:
-        Object parse(std::list<Tokenizer::SymbolObject> symbolStream);
+        // the parser doesn't recurse, the depth limit is only there to stop broken input early
+        static constexpr std::size_t DefaultMaxDepth = 1 << 20;
+        void set_max_depth(std::size_t _maxDepth);
+        // the Objects are built in it, it must outlive them
+        void set_memory_resource(std::pmr::memory_resource* _resource);
+        // the Documents intern their short literals in the table, it can be shared by them
+        void set_symbols(std::shared_ptr<SymbolTable> _symbols);
+
+        // event API, the handler gets the elements in document order
+        bool parse(std::string_view src, Handler& handler);
+        // all the elements of the source one after the other, each one is closed by on_element_end
+        bool parseSequence(std::string_view src, Handler& handler);
+
+        // tree API, built on the events
+        Object parse(const std::pmr::list<Tokenizer::SymbolObject>& symbolStream);
+        Object parse(std::string_view src);
+        Document parseDocument(std::string_view src, DocumentMode mode = Document_Owned);
+        // the document keeps the source alive, if it borrows from it
+        Document parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode = Document_Borrowed);
     };
 
     /**
-     * Abstract class, that also serves as the interface for the lison objects.
-     * The serialize and deserialize methods have default implementation to work
-     * with the serializer class.
+     * Parser of one big top-level list on several threads.
+     * A pre-scan of the structural characters splits the children of the root into ranges
+     * of about the same size, the ranges are parsed at the same time and the parts are joined
+     * in order. Anything else (a literal root, a small or broken source) is left to the
+     * sequential Parser, so the result is always the same as the Parser's.
      */
-    class LiSON
+    class ParallelParser
     {
-		friend class Object;
-    protected:
-        /**
-         * Interface methods.
-         */
-        virtual void interpret(const Object& obj) = 0;
-        virtual Object revert() const = 0;
+    private:
+        unsigned threads;
+        std::size_t chunkSize = DefaultChunkSize;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+
+        // start of the children of the root, the start of every other range and the end of the root
+        bool split(std::string_view src, std::vector<std::size_t>& bounds) const;
+        // each range in its own thread
+        template <class F>
+        void run(std::size_t ranges, F&& f) const;
+        Document build(std::string_view src, DocumentMode mode, std::shared_ptr<const SourceBuffer> owner);
     public:
-        virtual ~LiSON() = default;
-        /**
-         * Default implemented methods, shouldn't be overriden
-         */
-        void deserialize(const std::string& src);
-        std::string serialize() const;
+        // below this much source per thread the threads are not worth it
+        static constexpr std::size_t DefaultChunkSize = 1 << 20;
+
+        // all the cores by default
+        ParallelParser();
+        void set_threads(unsigned _threads);
+        void set_chunk_size(std::size_t _chunkSize);
+        void set_max_depth(std::size_t _maxDepth);
+
+        Object parse(std::string_view src);
+        Document parseDocument(std::string_view src, DocumentMode mode = Document_Owned);
+        Document parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode = Document_Borrowed);
     };
 
     /**
-     * file -> object
-     */ 
-    class Serializer
+     * Writer of big objects on several threads.
+     * The big lists are split into runs of siblings, the runs are written at the same time into
+     * buffers of their own, and the buffers go to the output in order as soon as they are ready
+     * (to a file with writev, where there is one). The output is the same as Object::write's.
+     */
+    class ParallelWriter
     {
     private:
-        std::string filename = "";
+        // a part of the output: a run of siblings, a whole object, or a fixed text
+        struct Piece
+        {
+            ObjectList::const_iterator first{};
+            std::size_t count = 0;
+            const Object* single = nullptr;
+            std::string text;
+        };
+
+        unsigned threads;
+        std::size_t minElements = DefaultMinElements;
+
+        // lists are only split this deep, below that they are written as a whole
+        static constexpr std::size_t MaxSplitDepth = 8;
+        void plan(const Object& obj, std::size_t want, std::size_t depth, WriteMode mode,
+                  std::vector<Piece>& pieces, std::size_t& split) const;
+        // the pieces that are done are passed to ready in order, [from, to) at a time
+        void render(std::vector<Piece>& pieces, WriteMode mode,
+                    const std::function<void(std::size_t from, std::size_t to)>& ready) const;
     public:
-        Serializer() = default;
-        Serializer(const std::string& _filename);
-        void set_file(const std::string& _filename);
-        std::string read() const;
-        void write(const std::string& source) const;
+        // below this many elements in the split lists the threads are not worth it
+        static constexpr std::size_t DefaultMinElements = 1024;
+
+        // all the cores by default
+        ParallelWriter();
+        void set_threads(unsigned _threads);
+        void set_min_elements(std::size_t _minElements);
+
+        std::string to_string(const Object& obj, WriteMode mode = Write_Padded) const;
+        // false if the file can't be written
+        bool write(const Object& obj, const std::string& filename, WriteMode mode = Write_Padded) const;
     };
 
     /**
-     * Epic clean-code features
+     * Resumable parser, the source arrives in chunks of any size.
+     * The state is kept between the feed calls, so a chunk may end anywhere, even in
+     * the middle of a literal. The source is a sequence of top-level elements, the
+     * events are reported as soon as they are complete.
      */
-    // wtring <-> lison
-    LiSON& operator >>(const std::string& src, LiSON& lison);
-    std::string& operator <<(std::string& res, const LiSON& lison);
-
-    // serializer <-> lison
-    LiSON& operator >>(const Serializer& serializer, LiSON& lison);
-    const Serializer& operator <<(const Serializer& serializer, const LiSON& lison);
+    class PushParser
+    {
+    private:
+        enum State
+        {
+            State_Between,
+            State_Literal,
+            State_Number,
+            State_Error,
+        };
 
-    // string -> serializer
-    Serializer& operator >>(const std::string& filename, Serializer& serializer);
-}
+        Handler& handler;
+        State state = State_Between;
+        std::size_t depth = 0;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+        // the part of a literal body or a number that came in the previous chunks
+        std::string pending;
+        std::string folded;
 
-#endif // LISON_H
+        bool fail();
+        // the number in pending is complete
+        bool number();
+    public:
+        PushParser(Handler& _handler);
+        void set_max_depth(std::size_t _maxDepth);
+        // false if the source is not valid LiSON
+        bool feed(std::string_view chunk);
+        // end of the source, false if it stopped inside an element
+        bool finish();
+    };
 
-/**
- * LiSON default implementations.
- * To use this, you must #define LISON_IMPLEMENTATION
- */
-#ifdef LISON_IMPLEMENTATION
-#ifndef _LISON_IMPLEMENTATION
-namespace lison
-{
-    // object
-	Object::Object(const Token& t)
-		: token(t)
-	{}
+    enum PullEvent
+    {
+        Pull_ListBegin,
+        Pull_ListEnd,
+        Pull_Literal,
+        Pull_Integer,
+        Pull_Float,
+        // the element is complete, nothing follows it
+        Pull_End,
+        Pull_Error,
+    };
 
-	Object::Object(const Object& other)
-		: token(other.token)
-	{}
-	
-    std::string Object::to_string() const
-	{
-		// the new variant visitor magic
-		std::stringstream ss;
-		auto visitor = overload
-		{
-			[&ss](const Tkn_Literal& literal)
-			{
-                ss << "'";
-                ss << literal.value;
-                ss << "'";
-			},
-			[&ss](const Tkn_Object& object)
-			{
-                ss << "( ";
-                for (auto o : object.value)
+    /**
+     * Parser of one element, that gives the events when they are asked for (pull API).
+     * Nothing is built and nothing is called back, the caller walks the source on its own,
+     * so it can put the literals right where they belong (the bindings are built on it).
+     */
+    class PullParser
+    {
+    private:
+        Lexer lexer;
+        std::string folded;
+        std::string_view value;
+        std::int64_t integerValue = 0;
+        double floatValue = 0;
+        std::size_t depth = 0;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+        bool done = false;
+        bool failed = false;
+
+        bool accept(Tokenizer::Symbol req);
+        PullEvent fail();
+    public:
+        PullParser(std::string_view src);
+        void set_max_depth(std::size_t _maxDepth);
+        PullEvent next();
+        // the literal that was pulled last, only valid until the next pull
+        std::string_view literal() const;
+        std::int64_t integer() const;
+        // the float that was pulled last, or the integer as a float
+        double floating() const;
+        // skips the rest of the list that was just begun, false if the source is broken
+        bool skip();
+    };
+
+    /**
+     * Kind of an element in the binary encoding, the low 2 bits of its head.
+     * Every element starts with a varint head (count << 2 | tag):
+     * literal -> the length, then the bytes; list -> the number of children, then the children;
+     * number -> 0 and the zigzag varint of an integer, or 1 and the 8 bytes of a float (little endian);
+     * error -> 0, the error node of a broken tree, decoded as on_error like ERROR in the text.
+     */
+    enum BinaryTag : std::uint8_t
+    {
+        Binary_Literal,
+        Binary_List,
+        Binary_Error,
+        Binary_Number,
+    };
+
+    /**
+     * binary encoding -> events
+     * The literals are taken straight from the source by their length, there is nothing to scan.
+     */
+    class Decoder
+    {
+    private:
+        std::string_view src;
+        std::size_t pos = 0;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+
+        bool varint(std::uint64_t& value);
+        bool element(Handler& handler);
+    public:
+        // start of every encoded source: magic and version
+        static constexpr std::string_view Magic = std::string_view("\0LSB\1", 5);
+        static bool detect(std::string_view src);
+        void set_max_depth(std::size_t _maxDepth);
+
+        bool parse(std::string_view src, Handler& handler);
+        Object parse(std::string_view src);
+        // the literals are stored as they are, so a document can borrow them
+        Document parseDocument(std::string_view src, DocumentMode mode = Document_Owned);
+        Document parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode = Document_Borrowed);
+    };
+
+    /**
+     * On-demand navigation over the raw source, without parsing it.
+     * A cursor points to the start of an element. Getting a child or a sibling skips the
+     * elements before it by counting the parens (a block at a time with the Scanner),
+     * so the cost is about the bytes skipped, and nothing is allocated. The source is not
+     * validated, a malformed part of it just gives invalid cursors.
+     * Only valid as long as the source buffer is alive.
+     */
+    class Cursor
+    {
+    private:
+        std::string_view src;
+        std::size_t pos = std::string_view::npos;
+
+        Cursor(std::string_view _src, std::size_t _pos);
+        // start of the next element from a position, npos if there is none
+        std::size_t element(std::size_t from) const;
+        // position right after the element starting at a position
+        std::size_t skip(std::size_t from) const;
+        // type of an unquoted element, Number_None for a list or a quoted literal
+        NumberType number(std::int64_t& integer, double& floating) const;
+    public:
+        Cursor() = default;
+        // at the first top-level element of the source
+        Cursor(std::string_view _src);
+
+        bool valid() const;
+        bool isList() const;
+        bool isLiteral() const;
+        bool isNumber() const;
+
+        Cursor child(std::size_t i) const;
+        Cursor next_sibling() const;
+        // number of children, needs a pass over the list
+        std::size_t size() const;
+
+        // body of the literal as it is in the source (whitespaces not folded),
+        // a number out of range is a literal of its text, as in the parser
+        std::optional<std::string_view> literal() const;
+        // body of the literal with folded whitespaces, like in an Object
+        std::optional<std::string> expectLiteralData() const;
+        std::optional<std::int64_t> expectInteger() const;
+        std::optional<double> expectFloat() const;
+        // the whole source text of the element
+        std::string_view raw() const;
+    };
+
+    // steps of loading and saving, the unit of the instrumentation
+    enum Stage
+    {
+        // file I/O
+        Stage_Read,
+        // tokenizing and parsing, they are done in the same pass
+        Stage_Parse,
+        Stage_Interpret,
+        // making the Object that is written
+        Stage_Revert,
+        // writing the text (without revert)
+        Stage_Write,
+        Stage_Count,
+    };
+
+    struct StageMetrics
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t ns = 0;
+        std::uint64_t bytes = 0;
+        // only counted with LISON_COUNT_ALLOCATIONS, the inner stages are included
+        std::uint64_t allocations = 0;
+        std::uint64_t allocatedBytes = 0;
+    };
+
+    // everything that was measured, plain data to be exported
+    struct Metrics
+    {
+        StageMetrics stages[Stage_Count];
+        // parens and literals that were parsed
+        std::uint64_t symbols = 0;
+        // lists and literals
+        std::uint64_t nodes = 0;
+        std::uint64_t literalBytes = 0;
+        std::uint64_t maxDepth = 0;
+    };
+
+    /**
+     * Hook of the instrumentation, attached to a LiSON or a Serializer with set_trace.
+     * The stages add up in the metrics, and on_stage is called at the end of each one.
+     * It is only compiled in with LISON_TRACE defined, without it the hooks are never
+     * called and cost nothing.
+     */
+    class Trace
+    {
+    public:
+        Metrics metrics;
+        virtual ~Trace() = default;
+        virtual void on_stage(Stage stage, std::uint64_t ns, std::uint64_t bytes) {}
+        void reset();
+    };
+
+    struct AllocationStats
+    {
+        std::uint64_t allocations = 0;
+        std::uint64_t deallocations = 0;
+        // all the bytes that were ever allocated
+        std::uint64_t allocatedBytes = 0;
+        // allocated and not freed yet
+        std::uint64_t liveBytes = 0;
+        std::uint64_t peakBytes = 0;
+    };
+
+    /**
+     * Counters of the global operator new and delete.
+     * They are only counted with LISON_COUNT_ALLOCATIONS defined, as then the library
+     * replaces the global operators (so the program must not replace them too). Without it
+     * the counters stay at zero. The difference of two stats is what happened between them.
+     */
+    class Allocations
+    {
+    public:
+        static bool enabled();
+        static AllocationStats stats();
+        // the peak starts again from the live bytes
+        static void reset_peak();
+    };
+
+#ifdef LISON_TRACE
+    // measures a stage until it is stopped or goes out of scope, nothing without a trace
+    class StageTimer
+    {
+    private:
+        Trace* trace;
+        Stage stage;
+        std::uint64_t bytes;
+        std::uint64_t excluded = 0;
+        bool running = true;
+        std::chrono::steady_clock::time_point start;
+        AllocationStats startAllocations;
+    public:
+        StageTimer(Trace* _trace, Stage _stage, std::uint64_t _bytes = 0);
+        ~StageTimer();
+        void add_bytes(std::uint64_t n);
+        // time of an inner stage, that is not counted in this one
+        void exclude(std::uint64_t ns);
+        void stop();
+    };
+
+    // counts the elements on their way to another handler
+    class TraceHandler : public Handler
+    {
+    private:
+        Handler& handler;
+        Trace* trace;
+        std::uint64_t depth = 0;
+    public:
+        TraceHandler(Handler& _handler, Trace* _trace);
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_element_end() override;
+        void on_error() override;
+    };
+#endif
+
+    /**
+     * Abstract
+     */
+    class LiSON
+    {
+		friend class Object;
+    private:
+        Trace* trace = nullptr;
+
+        // emit, with revert measured apart
+        void write(Writer& writer) const;
+    protected:
+        /**
+         * Interface methods.
+         * A class writes itself by making an Object (revert), and it can also write
+         * its elements straight to a Writer (emit) to skip the Object when serializing.
+         * By default emit writes the Object of revert.
+         */
+        virtual void interpret(const Object& obj) = 0;
+        virtual Object revert() const = 0;
+        virtual void emit(Writer& writer) const;
+        // the Object built from emit, for a revert of a class that overrides emit
+        Object emitted() const;
+    public:
+        virtual ~LiSON() = default;
+        /**
+         * Default implemented methods, shouldn't override
+         */
+        void deserialize(const std::string& src);
+        // parses the file in place, it is mapped where possible
+        void deserialize(const Serializer& serializer);
+        std::string serialize() const;
+        void serialize(std::ostream& out, WriteMode mode = Write_Padded) const;
+        void serialize(Writer& writer) const;
+        // the stages are measured into the trace (with LISON_TRACE), nullptr to stop it
+        void set_trace(Trace* _trace);
+    };
+
+    // how a file is going to be read
+    enum SourceMode
+    {
+        // read from the start to the end
+        Source_Text,
+        // looked up anywhere, and never converted on read
+        Source_Binary,
+    };
+
+    /**
+     * Read-only contents of a file.
+     * Regular files are memory mapped (and marked for the way they are read), so the parser
+     * works right on the page cache without copying. Pipes, special files and systems
+     * without mmap (or with LISON_NO_MMAP defined) fall back to reading the file into a buffer,
+     * where a binary encoded file is never converted as text.
+     * It is shared, so the contents stay alive as long as anything borrows from them.
+     */
+    class SourceBuffer
+    {
+    private:
+        const char* data = nullptr;
+        std::size_t length = 0;
+        bool mapped = false;
+        std::string buffer;
+    public:
+        SourceBuffer() = default;
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator =(const SourceBuffer&) = delete;
+        ~SourceBuffer();
+
+        // nullptr if the file can't be opened
+        static std::shared_ptr<const SourceBuffer> open(const std::string& filename, SourceMode mode = Source_Text);
+
+        std::string_view view() const;
+        bool isMapped() const;
+    };
+
+    class Snapshot;
+
+    /**
+     * Read-only Object-like view of a node of a Snapshot, the same as the DocumentView.
+     * Only valid as long as the Snapshot is alive.
+     */
+    class SnapshotView
+    {
+    private:
+        const Snapshot* snap = nullptr;
+        std::uint32_t index = 0;
+    public:
+        SnapshotView() = default;
+        SnapshotView(const Snapshot* _snap, std::uint32_t _index);
+
+        bool valid() const;
+        NodeType type() const;
+        std::size_t size() const;
+        SnapshotView child(std::size_t i) const;
+        SnapshotView parent() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+        Object toObject() const;
+
+        void foreachObjectData(
+            std::function<void(const SnapshotView&)> f) const;
+        template <class F>
+        void visitObjectData(F&& f) const;
+        std::optional<std::string_view> expectLiteralData() const;
+        std::optional<std::int64_t> expectInteger() const;
+        std::optional<double> expectFloat() const;
+    };
+
+    /**
+     * Document stored in a file the way it is in memory: a header, the node table and the pool.
+     * Opening it maps the file and checks the header, nothing is parsed or copied,
+     * so the pages are shared by every process that opens the same file.
+     * Every lookup is checked against the table, a broken file only gives invalid views.
+     */
+    class Snapshot
+    {
+    friend class SnapshotView;
+    private:
+        std::shared_ptr<const SourceBuffer> owner;
+        const Node* nodes = nullptr;
+        std::uint32_t count = 0;
+        std::string_view pool;
+
+        std::optional<std::string_view> literal(std::uint32_t index) const;
+        // reports the nodes of a subtree in document order
+        void write(std::uint32_t index, Writer& writer) const;
+    public:
+        static constexpr std::string_view Magic = std::string_view("\0LSS", 4);
+        static constexpr std::uint16_t Version = 1;
+
+        Snapshot() = default;
+        // invalid if the file can't be opened or it is not a snapshot
+        static Snapshot open(const std::string& filename);
+        static Snapshot load(std::shared_ptr<const SourceBuffer> source);
+
+        bool valid() const;
+        SnapshotView root() const;
+        std::size_t size() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+    };
+
+    template <class F>
+    void SnapshotView::visitObjectData(F&& f) const
+    {
+        if (type() != Node_List)
+            return;
+        std::uint32_t end = snap->nodes[index].next;
+        // the next index only goes forward in a sound table
+        for (std::uint32_t c = index + 1; c < end && c < snap->count && snap->nodes[c].next > c; c = snap->nodes[c].next)
+            f(SnapshotView(snap, c));
+    }
+
+    /**
+     * file -> object
+     */ 
+    class Serializer
+    {
+    private:
+        std::string filename = "";
+        Trace* trace = nullptr;
+    public:
+        Serializer() = default;
+        Serializer(const std::string& _filename);
+        void set_file(const std::string& _filename);
+        // the reads and writes are measured into the trace (with LISON_TRACE)
+        void set_trace(Trace* _trace);
+        std::string read() const;
+        // the contents without copying, nullptr if the file can't be opened
+        std::shared_ptr<const SourceBuffer> map() const;
+        // feeds the file to a push parser in chunks, false if the file is not valid LiSON
+        // a binary file is detected and decoded instead
+        bool read(Handler& handler, std::size_t chunkSize = 64 * 1024) const;
+        void write(const std::string& source) const;
+        void write(const Object& obj, WriteMode mode = Write_Padded) const;
+        // streams the object into the file, without any tree or string of the whole output
+        void write(const LiSON& lison, WriteMode mode = Write_Padded) const;
+        // writes the binary encoding
+        void encode(const Object& obj) const;
+        // writes the document as a snapshot, to be opened with Snapshot::open
+        void snapshot(const Document& doc) const;
+    };
+
+    /**
+     * Reader of LiSON lines: one document on every line of a stream.
+     * The blank lines are skipped, a line that is not valid LiSON gives an error Object.
+     * Only a batch of lines per thread is in memory at a time, however long the stream is.
+     */
+    class LinesReader
+    {
+    private:
+        std::istream& in;
+        // number of the last line that was read
+        std::size_t number = 0;
+
+        bool line(std::string& out);
+    public:
+        // a batch of lines is parsed by one worker at a time
+        static constexpr std::size_t BatchLines = 1024;
+        static constexpr std::size_t BatchSize = 1 << 20;
+
+        LinesReader(std::istream& _in);
+        // false at the end of the stream
+        bool next(Object& obj);
+        bool next(LiSON& lison);
+        // number of the line of the last document
+        std::size_t line() const;
+
+        /**
+         * Parses the rest of the stream on a pool of threads (all the cores by default).
+         * f gets the documents with their line numbers, one call at a time. In order, they come
+         * in the order of the stream, otherwise as soon as they are parsed.
+         * Returns the number of documents.
+         */
+        std::size_t forEach(std::function<void(std::size_t line, Object&& obj)> f,
+                            unsigned threads = 0, bool ordered = true);
+    };
+
+    /**
+     * Writer of LiSON lines: every document is written in compact form on a line of its own.
+     * The newlines of the literals are written as spaces, which the parser folds them to anyway.
+     */
+    class LinesWriter : public StreamWriter
+    {
+    public:
+        LinesWriter(std::ostream& _stream);
+        void literal(std::string_view value) override;
+        void write(const Object& obj);
+        void write(const LiSON& lison);
+    };
+
+    /**
+     * Binding of a type to LiSON, read right from the source into the members and written
+     * right from them, without an Object or a LiSON class in between.
+     * Bound out of the box: std::string (a literal), the arithmetic types (a number, or a
+     * literal with its text), bool (the literal 'true' or 'false', or the number 1 or 0),
+     * std::vector and std::list (a list of the elements), and the
+     * structs described by a Schema (a list of ('name' value) pairs, in any order, the
+     * unknown names are skipped). Any other type can be bound by specializing Binding.
+     */
+    template <class T, class = void>
+    struct Binding;
+
+    template <class T, class M>
+    struct Field
+    {
+        std::string_view name;
+        M T::* member;
+    };
+
+    template <class T, class M>
+    constexpr Field<T, M> field(std::string_view name, M T::* member)
+    {
+        return Field<T, M>{name, member};
+    }
+
+    /**
+     * Field list of a struct, to be specialized with a static constexpr tuple of fields:
+     *  LISON_SCHEMA(Point, lison::field("x", &Point::x), lison::field("y", &Point::y));
+     */
+    template <class T>
+    struct Schema;
+
+// at global scope, with the type fully qualified
+#define LISON_SCHEMA(Type, ...) \
+    namespace lison { template <> struct Schema<Type> { static constexpr auto fields = std::make_tuple(__VA_ARGS__); }; }
+
+    template <>
+    struct Binding<std::string>
+    {
+        static bool read(PullParser& parser, PullEvent event, std::string& out)
+        {
+            if (event != Pull_Literal)
+                return false;
+            out.assign(parser.literal());
+            return true;
+        }
+
+        static void write(Writer& writer, const std::string& value)
+        {
+            writer.literal(value);
+        }
+    };
+
+    template <>
+    struct Binding<bool>
+    {
+        static bool read(PullParser& parser, PullEvent event, bool& out)
+        {
+            if (event == Pull_Integer && (parser.integer() == 0 || parser.integer() == 1))
+            {
+                out = parser.integer() == 1;
+                return true;
+            }
+            if (event != Pull_Literal || (parser.literal() != "true" && parser.literal() != "false"))
+                return false;
+            out = parser.literal() == "true";
+            return true;
+        }
+
+        static void write(Writer& writer, bool value)
+        {
+            writer.literal(value ? "true" : "false");
+        }
+    };
+
+    template <class T>
+    struct Binding<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+    {
+        // a number, or a literal with the text of one
+        static bool read(PullParser& parser, PullEvent event, T& out)
+        {
+            if (event == Pull_Integer && std::is_integral_v<T>)
+            {
+                std::int64_t value = parser.integer();
+                out = T(value);
+                return std::int64_t(out) == value && (value < 0) == (out < T(0));
+            }
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                if (event == Pull_Integer || event == Pull_Float)
                 {
-                    ss << o.to_string();
+                    out = T(parser.floating());
+                    return true;
                 }
-                ss << ")";
-			},
-			[&ss](const Tkn_Error& error)
-			{
-				ss << "ERROR";
-			}
-		};
-		std::visit(visitor, token);
-		ss << " ";
-		return ss.str();
-	}
+            }
+            if (event != Pull_Literal)
+                return false;
+            std::string_view value = parser.literal();
+            auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), out);
+            return error == std::errc() && end == value.data() + value.size();
+        }
 
-	Object Object::fromString(const std::string& str)
-	{
-		return Object(Token{Tkn_Literal{str}});
-	}
+        static void write(Writer& writer, T value)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+                writer.floating(double(value));
+            else if (std::is_signed_v<T> || std::uint64_t(value) <= std::uint64_t(INT64_MAX))
+                writer.integer(std::int64_t(value));
+            else
+            {
+                // an unsigned one over the range of the integers
+                char buffer[Number::MaxLength];
+                char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+                writer.literal(std::string_view(buffer, end - buffer));
+            }
+        }
+    };
 
-	Object Object::fromLiSON(const LiSON& lison)
-	{
-		return lison.revert();
-	}
+    // the sequence containers, the elements are appended
+    template <class C>
+    struct SequenceBinding
+    {
+        using Element = typename C::value_type;
 
-	template <class T>
-	Object Object::fromObject(T t,
-							  std::function<Object(const T&)> f)
-	{
-		return f(t);
-	}
+        static bool read(PullParser& parser, PullEvent event, C& out)
+        {
+            if (event != Pull_ListBegin)
+                return false;
+            while ((event = parser.next()) != Pull_ListEnd)
+            {
+                Element& element = out.emplace_back();
+                if (!Binding<Element>::read(parser, event, element))
+                    return false;
+            }
+            return true;
+        }
 
-	void Object::foreachObjectData(
-		std::function<void(const Object&)> f) const
-	{
-		if (!std::holds_alternative<Tkn_Object>(token))
-			return;
-		auto& t = std::get<Tkn_Object>(token);
-		for (auto it : t.value)
-		{
-			f(it);
-		}
-	}
+        static void write(Writer& writer, const C& values)
+        {
+            writer.begin_list();
+            for (const Element& value : values)
+                Binding<Element>::write(writer, value);
+            writer.end_list();
+        }
+    };
 
-	void Object::add(const Object& obj)
-	{
-		if (!std::holds_alternative<Tkn_Object>(token))
-			return;
-		auto& t = std::get<Tkn_Object>(token);
-		t.value.push_back(obj);
-	}
+    template <class T>
+    struct Binding<std::vector<T>> : SequenceBinding<std::vector<T>> {};
 
-	std::optional<std::string> Object::expectLiteralData() const
-	{
+    template <class T>
+    struct Binding<std::list<T>> : SequenceBinding<std::list<T>> {};
+
+    template <class T>
+    struct Binding<T, std::void_t<decltype(Schema<T>::fields)>>
+    {
+        static bool read(PullParser& parser, PullEvent event, T& out)
+        {
+            if (event != Pull_ListBegin)
+                return false;
+            while ((event = parser.next()) != Pull_ListEnd)
+            {
+                // ( 'name' value )
+                if (event != Pull_ListBegin || parser.next() != Pull_Literal)
+                    return false;
+                std::string_view name = parser.literal();
+                bool ok = true;
+                // the name is only valid until the value is pulled, so it is matched first
+                bool known = std::apply([&](const auto&... fields)
+                {
+                    return ((fields.name == name && (ok = readField(parser, out, fields), true)) || ...);
+                }, Schema<T>::fields);
+                if (!known)
+                {
+                    event = parser.next();
+                    ok = event == Pull_Literal || event == Pull_Integer || event == Pull_Float
+                        || (event == Pull_ListBegin && parser.skip());
+                }
+                if (!ok || parser.next() != Pull_ListEnd)
+                    return false;
+            }
+            return true;
+        }
+
+        static void write(Writer& writer, const T& value)
+        {
+            writer.begin_list();
+            std::apply([&](const auto&... fields)
+            {
+                (writeField(writer, value, fields), ...);
+            }, Schema<T>::fields);
+            writer.end_list();
+        }
+    private:
+        template <class M>
+        static bool readField(PullParser& parser, T& out, const Field<T, M>& field)
+        {
+            return Binding<M>::read(parser, parser.next(), out.*field.member);
+        }
+
+        template <class M>
+        static void writeField(Writer& writer, const T& value, const Field<T, M>& field)
+        {
+            writer.begin_list();
+            writer.literal(field.name);
+            Binding<M>::write(writer, value.*field.member);
+            writer.end_list();
+        }
+    };
+
+    /**
+     * Entry points of the bindings.
+     * The reads are false if the source is broken or doesn't fit the type, the object may be
+     * filled partly then.
+     */
+    class Binder
+    {
+    public:
+        template <class T>
+        static bool read(std::string_view src, T& out)
+        {
+            PullParser parser(src);
+            return Binding<T>::read(parser, parser.next(), out) && parser.next() == Pull_End;
+        }
+
+        // reads the file, it is mapped where possible
+        template <class T>
+        static bool load(const Serializer& serializer, T& out)
+        {
+            std::shared_ptr<const SourceBuffer> source = serializer.map();
+            return source != nullptr && read(source->view(), out);
+        }
+
+        template <class T>
+        static void write(Writer& writer, const T& value)
+        {
+            Binding<T>::write(writer, value);
+        }
+
+        template <class T>
+        static std::string to_string(const T& value, WriteMode mode = Write_Padded)
+        {
+            std::string out;
+            StringWriter writer(out, mode);
+            Binding<T>::write(writer, value);
+            return out;
+        }
+    };
+
+    /**
+     * Epic clean-code features
+     */
+    // wtring <-> lison
+    LiSON& operator >>(const std::string& src, LiSON& lison);
+    std::string& operator <<(std::string& res, const LiSON& lison);
+
+    // serializer <-> lison
+    LiSON& operator >>(const Serializer& serializer, LiSON& lison);
+    const Serializer& operator <<(const Serializer& serializer, const LiSON& lison);
+
+    // string -> serializer
+    Serializer& operator >>(const std::string& filename, Serializer& serializer);
+}
+
+#endif // LISON_H
+
+/**
+ * LiSON default implementations.
+ * To use this, you must #define LISON_IMPLEMENTATION
+ */
+#ifdef LISON_IMPLEMENTATION
+#ifndef _LISON_IMPLEMENTATION
+#include <cmath>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <cmath>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LISON_X86
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LISON_WRITEV
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#endif
+#include <algorithm>
+#include <algorithm>
+// LISON_NO_MMAP turns the mapping off, to read the files the way the systems without mmap do
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(LISON_NO_MMAP)
+#define LISON_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+namespace lison
+{
+    // number
+    NumberType Number::parse(std::string_view text, std::int64_t& integer, double& floating)
+    {
+        // a digit first (after the sign), so words like inf and nan are not numbers
+        std::size_t digit = !text.empty() && text[0] == '-' ? 1 : 0;
+        if (digit >= text.size() || text[digit] < '0' || text[digit] > '9')
+            return Number_None;
+        const char* begin = text.data();
+        const char* end = text.data() + text.size();
+        auto [last, error] = std::from_chars(begin, end, integer);
+        if (last == end)
+            return error == std::errc() ? Number_Integer : Number_Large;
+        auto [lastFloat, errorFloat] = std::from_chars(begin, end, floating);
+        if (lastFloat == end)
+            return errorFloat == std::errc() ? Number_Float : Number_Large;
+        return Number_None;
+    }
+
+    std::string_view Number::format(std::int64_t value, char* buffer)
+    {
+        char* end = std::to_chars(buffer, buffer + MaxLength, value).ptr;
+        return std::string_view(buffer, end - buffer);
+    }
+
+    std::string_view Number::format(double value, char* buffer)
+    {
+        char* end = std::to_chars(buffer, buffer + MaxLength - 2, value).ptr;
+        // a float that looks like an integer would be read back as one
+        if (std::isfinite(value) && std::memchr(buffer, '.', end - buffer) == nullptr && std::memchr(buffer, 'e', end - buffer) == nullptr)
+        {
+            *end++ = '.';
+            *end++ = '0';
+        }
+        return std::string_view(buffer, end - buffer);
+    }
+
+    std::uint64_t Number::toBits(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double Number::fromBits(std::uint64_t bits)
+    {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // the numbers of the receivers that don't know about them
+    void Handler::on_integer(std::int64_t value)
+    {
+        char buffer[Number::MaxLength];
+        on_literal(Number::format(value, buffer));
+    }
+
+    void Handler::on_float(double value)
+    {
+        char buffer[Number::MaxLength];
+        on_literal(Number::format(value, buffer));
+    }
+
+    void Writer::integer(std::int64_t value)
+    {
+        char buffer[Number::MaxLength];
+        literal(Number::format(value, buffer));
+    }
+
+    void Writer::floating(double value)
+    {
+        char buffer[Number::MaxLength];
+        literal(Number::format(value, buffer));
+    }
+
+    // object
+	Tkn_Literal::Tkn_Literal(std::string_view _value, std::pmr::memory_resource* resource)
+		: value(_value, resource)
+	{}
+
+	Object::Object(const Token& t)
+		: token(t)
+	{}
+
+	Object::Object(Token&& t)
+		: token(std::move(t))
+	{}
+
+	Object::Object(const Object& other)
+		: token(Tkn_Error{})
+	{
+		auto* list = std::get_if<Tkn_Object>(&other.token);
+		if (list == nullptr)
+		{
+			token = other.token;
+			return;
+		}
+		token = Token{Tkn_Object{}};
+		// the lists are copied level by level with an explicit stack, not by recursion
+		std::vector<std::pair<const ObjectList*, ObjectList*>> todo;
+		todo.emplace_back(&list->value, &std::get<Tkn_Object>(token).value);
+		while (!todo.empty())
+		{
+			auto [from, to] = todo.back();
+			todo.pop_back();
+			for (const Object& o : *from)
+			{
+				if (auto* l = std::get_if<Tkn_Object>(&o.token))
+				{
+					Object& copy = to->emplace_back(Token{Tkn_Object{}});
+					todo.emplace_back(&l->value, &std::get<Tkn_Object>(copy.token).value);
+				}
+				else
+					to->emplace_back(o.token);
+			}
+		}
+	}
+
+	Object& Object::operator =(const Object& other)
+	{
+		if (this != &other)
+			*this = Object(other);
+		return *this;
+	}
+
+	Object::~Object()
+	{
+		// the children are moved to a flat list before they die, so destroying a
+		// deep tree doesn't go as deep on the stack as the tree
+		auto* list = std::get_if<Tkn_Object>(&token);
+		if (list == nullptr || list->value.empty())
+			return;
+		ObjectList pending(list->value.get_allocator());
+		pending.splice(pending.end(), list->value);
+		while (!pending.empty())
+		{
+			// a list from another resource can't be spliced, it is flattened by its own destructor
+			auto* l = std::get_if<Tkn_Object>(&pending.front().token);
+			if (l != nullptr && l->value.get_allocator() == pending.get_allocator())
+				pending.splice(pending.end(), l->value);
+			pending.pop_front();
+		}
+	}
+	
+	void Object::write(Writer& writer) const
+	{
+		// the lists that are being written, with the next child to write
+		struct Frame
+		{
+			ObjectList::const_iterator it;
+			ObjectList::const_iterator end;
+		};
+		std::vector<Frame> open;
+		const Object* obj = this;
+		while (obj != nullptr)
+		{
+			// the new variant visitor magic
+			auto visitor = overload
+			{
+				[&writer](const Tkn_Literal& literal)
+				{
+					writer.literal(literal.value);
+				},
+				[&writer, &open](const Tkn_Object& object)
+				{
+					writer.begin_list();
+					open.push_back(Frame{object.value.begin(), object.value.end()});
+				},
+				[&writer](const Tkn_Error& error)
+				{
+					writer.error();
+				},
+				[&writer](const Tkn_Integer& number)
+				{
+					writer.integer(number.value);
+				},
+				[&writer](const Tkn_Float& number)
+				{
+					writer.floating(number.value);
+				}
+			};
+			std::visit(visitor, obj->token);
+
+			// next one is the following child of the innermost list that still has some
+			obj = nullptr;
+			while (!open.empty())
+			{
+				Frame& f = open.back();
+				if (f.it != f.end)
+				{
+					obj = &*f.it++;
+					break;
+				}
+				writer.end_list();
+				open.pop_back();
+			}
+		}
+	}
+
+    std::string Object::to_string(WriteMode mode) const
+	{
+		std::string out;
+		out.reserve(serializedSize(mode));
+		write(out, mode);
+		return out;
+	}
+
+	void Object::write(std::string& out, WriteMode mode) const
+	{
+		StringWriter writer(out, mode);
+		write(writer);
+	}
+
+	void Object::write(std::ostream& out, WriteMode mode) const
+	{
+		StreamWriter writer(out, mode);
+		write(writer);
+	}
+
+	std::size_t Object::serializedSize(WriteMode mode) const
+	{
+		bool padded = mode == Write_Padded;
+		std::size_t size = 0;
+		std::vector<const Object*> todo{this};
+		while (!todo.empty())
+		{
+			const Object* obj = todo.back();
+			todo.pop_back();
+			auto visitor = overload
+			{
+				[&size](const Tkn_Literal& literal)
+				{
+					size += literal.value.length() + 2;
+				},
+				[&size, &todo, padded](const Tkn_Object& object)
+				{
+					size += padded ? 3 : 2;
+					if (!padded && !object.value.empty())
+						size += object.value.size() - 1;
+					for (const Object& o : object.value)
+						todo.push_back(&o);
+				},
+				[&size](const Tkn_Error& error)
+				{
+					size += 5;
+				},
+				[&size](const Tkn_Integer& number)
+				{
+					char buffer[Number::MaxLength];
+					size += Number::format(number.value, buffer).length();
+				},
+				[&size](const Tkn_Float& number)
+				{
+					char buffer[Number::MaxLength];
+					// the infinite and NaN ones are quoted
+					size += Number::format(number.value, buffer).length() + (std::isfinite(number.value) ? 0 : 2);
+				}
+			};
+			std::visit(visitor, obj->token);
+			if (padded)
+				size++;
+		}
+		return size;
+	}
+
+	Object Object::fromString(const std::string& str)
+	{
+		return Object(Token{Tkn_Literal{str}});
+	}
+
+	Object Object::fromInteger(std::int64_t value)
+	{
+		return Object(Token{Tkn_Integer{value}});
+	}
+
+	Object Object::fromFloat(double value)
+	{
+		return Object(Token{Tkn_Float{value}});
+	}
+
+	Object Object::fromLiSON(const LiSON& lison)
+	{
+		return lison.revert();
+	}
+
+	template <class T>
+	Object Object::fromObject(T t,
+							  std::function<Object(const T&)> f)
+	{
+		return f(t);
+	}
+
+	void Object::foreachObjectData(
+		std::function<void(const Object&)> f) const
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return;
+		auto& t = std::get<Tkn_Object>(token);
+		for (const Object& it : t.value)
+		{
+			f(it);
+		}
+	}
+
+	void Object::add(const Object& obj)
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return;
+		auto& t = std::get<Tkn_Object>(token);
+		t.value.push_back(obj);
+	}
+
+	void Object::add(Object&& obj)
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return;
+		auto& t = std::get<Tkn_Object>(token);
+		t.value.push_back(std::move(obj));
+	}
+
+	std::optional<std::string> Object::expectLiteralData() const
+	{
+		if (!std::holds_alternative<Tkn_Literal>(token))
+			return {};
+		auto& t = std::get<Tkn_Literal>(token);
+		return {std::string(t.value)};
+	}
+
+	std::optional<std::int64_t> Object::expectInteger() const
+	{
+		if (!std::holds_alternative<Tkn_Integer>(token))
+			return {};
+		return {std::get<Tkn_Integer>(token).value};
+	}
+
+	std::optional<double> Object::expectFloat() const
+	{
+		if (auto* number = std::get_if<Tkn_Float>(&token))
+			return {number->value};
+		if (auto* number = std::get_if<Tkn_Integer>(&token))
+			return {double(number->value)};
+		return {};
+	}
+
+	std::optional<std::list<Object>> Object::expectObjectData() const
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return {};
+		auto& t = std::get<Tkn_Object>(token);
+		return {std::list<Object>(t.value.begin(), t.value.end())};
+	}
+
+	std::optional<std::string_view> Object::expectLiteralView() const
+	{
 		if (!std::holds_alternative<Tkn_Literal>(token))
 			return {};
 		auto& t = std::get<Tkn_Literal>(token);
 		return {t.value};
 	}
 
-	std::optional<std::list<Object>> Object::expectObjectData() const
-	{
-		if (!std::holds_alternative<Tkn_Object>(token))
-			return {};
-		auto& t = std::get<Tkn_Object>(token);
-		return {t.value};
-	}
+	const ObjectList* Object::expectObjectList() const
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return nullptr;
+		auto& t = std::get<Tkn_Object>(token);
+		return &t.value;
+	}
+
+	// builder
+	ObjectBuilder::ObjectBuilder(std::pmr::memory_resource* _resource)
+		: result(Token{Tkn_Error{}}), resource(_resource)
+	{}
+
+	Object& ObjectBuilder::add(Token&& token)
+	{
+		if (open.empty())
+		{
+			result = Object(std::move(token));
+			return result;
+		}
+		auto& list = std::get<Tkn_Object>(open.back()->token).value;
+		return list.emplace_back(std::move(token));
+	}
+
+	void ObjectBuilder::on_list_begin()
+	{
+		open.push_back(&add(Token{Tkn_Object{ObjectList(resource)}}));
+	}
+
+	void ObjectBuilder::on_list_end()
+	{
+		open.pop_back();
+	}
+
+	void ObjectBuilder::on_literal(std::string_view value)
+	{
+		add(Token{Tkn_Literal{value, resource}});
+	}
+
+	void ObjectBuilder::on_integer(std::int64_t value)
+	{
+		add(Token{Tkn_Integer{value}});
+	}
+
+	void ObjectBuilder::on_float(double value)
+	{
+		add(Token{Tkn_Float{value}});
+	}
+
+	void ObjectBuilder::on_error()
+	{
+		open.clear();
+		result = Object(Token{Tkn_Error{}});
+	}
+
+	void ObjectBuilder::begin_list()
+	{
+		on_list_begin();
+	}
+
+	void ObjectBuilder::end_list()
+	{
+		on_list_end();
+	}
+
+	void ObjectBuilder::literal(std::string_view value)
+	{
+		on_literal(value);
+	}
+
+	void ObjectBuilder::integer(std::int64_t value)
+	{
+		on_integer(value);
+	}
+
+	void ObjectBuilder::floating(double value)
+	{
+		on_float(value);
+	}
+
+	void ObjectBuilder::error()
+	{
+		add(Token{Tkn_Error{}});
+	}
+
+	Object ObjectBuilder::take()
+	{
+		return std::move(result);
+	}
+
+	// stream
+	ObjectStream::ObjectStream(std::function<void(Object&&)> _f, std::pmr::memory_resource* _resource)
+		: ObjectBuilder(_resource), f(_f)
+	{}
+
+	void ObjectStream::on_element_end()
+	{
+		f(take());
+	}
+
+    // memory
+    // memory report
+    std::size_t MemoryReport::totalBytes() const
+    {
+        return literalBytes + containerBytes;
+    }
+
+    double MemoryReport::bytesPerNode() const
+    {
+        return nodes == 0 ? 0 : double(totalBytes()) / nodes;
+    }
+
+    // heap bytes of a string, nothing if it fits in the string itself
+    static std::size_t stringHeap(std::size_t capacity)
+    {
+        static const std::size_t inplace = std::string().capacity();
+        return capacity > inplace ? capacity + 1 : 0;
+    }
+
+    MemoryReport Object::memoryUsage() const
+    {
+        // a child is a node of the std::list: two links and the object
+        constexpr std::size_t listNode = sizeof(Object) + 2 * sizeof(void*);
+        MemoryReport report;
+        report.containerBytes = sizeof(Object);
+        std::vector<const Object*> stack{this};
+        while (!stack.empty())
+        {
+            const Object* current = stack.back();
+            stack.pop_back();
+            report.nodes++;
+            std::visit(overload{
+                [&](const Tkn_Literal& lit) {
+                    std::size_t heap = stringHeap(lit.value.capacity());
+                    report.literals++;
+                    report.literalBytes += lit.value.size();
+                    report.heapBytes += heap;
+                    // the unused capacity, or nothing if the characters are in the object
+                    report.containerBytes += heap > 0 ? heap - lit.value.size() : 0;
+                },
+                [&](const Tkn_Object& obj) {
+                    report.lists++;
+                    report.heapBytes += obj.value.size() * listNode;
+                    report.containerBytes += obj.value.size() * listNode;
+                    for (const Object& child : obj.value)
+                        stack.push_back(&child);
+                },
+                // numbers are held in the object itself
+                [](const Tkn_Integer&) {},
+                [](const Tkn_Float&) {},
+                [](const Tkn_Error&) {},
+            }, current->token);
+        }
+        return report;
+    }
+
+    MemoryReport Document::memoryUsage() const
+    {
+        MemoryReport report;
+        report.nodes = nodes.size();
+        for (const Node& n : nodes)
+        {
+            if (n.type == Node_List)
+                report.lists++;
+            else if (n.type == Node_Literal)
+                report.literals++;
+        }
+        std::size_t table = nodes.capacity() * sizeof(Node);
+        std::size_t pooled = stringHeap(pool.capacity());
+        report.literalBytes = pool.size();
+        report.heapBytes = table + pooled;
+        report.containerBytes = sizeof(Document) + table + (pooled > 0 ? pooled - pool.size() : 0);
+        return report;
+    }
+
+    // allocation counters
+    static std::atomic<std::uint64_t> allocationCount{0};
+    static std::atomic<std::uint64_t> deallocationCount{0};
+    static std::atomic<std::uint64_t> allocatedTotal{0};
+    static std::atomic<std::uint64_t> liveTotal{0};
+    static std::atomic<std::uint64_t> peakTotal{0};
+
+    bool Allocations::enabled()
+    {
+#ifdef LISON_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    AllocationStats Allocations::stats()
+    {
+        AllocationStats stats;
+        stats.allocations = allocationCount.load(std::memory_order_relaxed);
+        stats.deallocations = deallocationCount.load(std::memory_order_relaxed);
+        stats.allocatedBytes = allocatedTotal.load(std::memory_order_relaxed);
+        stats.liveBytes = liveTotal.load(std::memory_order_relaxed);
+        stats.peakBytes = peakTotal.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void Allocations::reset_peak()
+    {
+        peakTotal.store(liveTotal.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+#ifdef LISON_COUNT_ALLOCATIONS
+    // the size and the start of the block are kept in front of the memory, for the deletes
+    static constexpr std::size_t AllocationHeader = alignof(std::max_align_t);
+
+    static void* countedAlloc(std::size_t size, std::size_t align = AllocationHeader)
+    {
+        align = std::max(align, AllocationHeader);
+        void* block = std::malloc(size + AllocationHeader + align);
+        if (block == nullptr)
+            throw std::bad_alloc();
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(block) + AllocationHeader;
+        void** p = reinterpret_cast<void**>((start + align - 1) / align * align);
+        p[-1] = reinterpret_cast<void*>(size);
+        p[-2] = block;
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocatedTotal.fetch_add(size, std::memory_order_relaxed);
+        std::uint64_t live = liveTotal.fetch_add(size, std::memory_order_relaxed) + size;
+        std::uint64_t peak = peakTotal.load(std::memory_order_relaxed);
+        while (live > peak && !peakTotal.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            ;
+        return p;
+    }
+
+    static void countedFree(void* p)
+    {
+        if (p == nullptr)
+            return;
+        void** header = static_cast<void**>(p);
+        deallocationCount.fetch_add(1, std::memory_order_relaxed);
+        liveTotal.fetch_sub(reinterpret_cast<std::size_t>(header[-1]), std::memory_order_relaxed);
+        std::free(header[-2]);
+    }
+#endif
+
+    // writer
+    // text writer
+    TextWriter::TextWriter(std::string* _out, std::size_t _limit, WriteMode _mode)
+        : mode(_mode), out(_out), limit(_limit)
+    {}
+
+    void TextWriter::put(char c)
+    {
+        *out += c;
+        if (out->size() >= limit)
+            drain();
+    }
+
+    void TextWriter::put(std::string_view s)
+    {
+        out->append(s.data(), s.size());
+        if (out->size() >= limit)
+            drain();
+    }
+
+    void TextWriter::newline()
+    {
+        put('\n');
+        separate = false;
+    }
+
+    // in compact mode only the siblings are separated
+    void TextWriter::element()
+    {
+        if (mode == Write_Compact && separate)
+            put(' ');
+    }
+
+    void TextWriter::begin_list()
+    {
+        element();
+        put(mode == Write_Padded ? "( " : "(");
+        separate = false;
+    }
+
+    void TextWriter::end_list()
+    {
+        put(mode == Write_Padded ? ") " : ")");
+        separate = true;
+    }
+
+    void TextWriter::literal(std::string_view value)
+    {
+        element();
+        put('\'');
+        put(value);
+        put(mode == Write_Padded ? "' " : "'");
+        separate = true;
+    }
+
+    // a number is written without the quotes, if it has a number form
+    void TextWriter::integer(std::int64_t value)
+    {
+        char buffer[Number::MaxLength];
+        element();
+        put(Number::format(value, buffer));
+        if (mode == Write_Padded)
+            put(' ');
+        separate = true;
+    }
+
+    void TextWriter::floating(double value)
+    {
+        if (!std::isfinite(value))
+        {
+            Writer::floating(value);
+            return;
+        }
+        char buffer[Number::MaxLength];
+        element();
+        put(Number::format(value, buffer));
+        if (mode == Write_Padded)
+            put(' ');
+        separate = true;
+    }
+
+    void TextWriter::error()
+    {
+        element();
+        put(mode == Write_Padded ? "ERROR " : "ERROR");
+        separate = true;
+    }
+
+    // string writer, the string is the output, there is nothing to drain
+    StringWriter::StringWriter(std::string& _out, WriteMode _mode)
+        : TextWriter(&_out, std::string::npos, _mode)
+    {}
+
+    // stream writer
+    StreamWriter::StreamWriter(std::ostream& _stream, WriteMode _mode)
+        : TextWriter(&buffer, BufferSize, _mode), stream(_stream)
+    {
+        buffer.reserve(BufferSize);
+    }
+
+    StreamWriter::~StreamWriter()
+    {
+        flush();
+    }
+
+    void StreamWriter::drain()
+    {
+        stream.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void StreamWriter::flush()
+    {
+        drain();
+        stream.flush();
+    }
+
+    // file writer
+    FileWriter::FileWriter(const std::string& filename, WriteMode _mode)
+        : TextWriter(&buffer, StreamWriter::BufferSize, _mode)
+    {
+        if (!filename.empty())
+            file.open(filename, std::ios_base::out);
+        buffer.reserve(StreamWriter::BufferSize);
+    }
+
+    FileWriter::~FileWriter()
+    {
+        flush();
+    }
+
+    bool FileWriter::is_open() const
+    {
+        return file.is_open();
+    }
+
+    void FileWriter::drain()
+    {
+        // nowhere to write, the output is dropped
+        if (file.is_open())
+            file.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void FileWriter::flush()
+    {
+        drain();
+        if (file.is_open())
+            file.flush();
+    }
+
+    // handler -> writer
+    WriteHandler::WriteHandler(Writer& _writer)
+        : writer(_writer)
+    {}
+
+    void WriteHandler::on_list_begin()
+    {
+        writer.begin_list();
+    }
+
+    void WriteHandler::on_list_end()
+    {
+        writer.end_list();
+    }
+
+    void WriteHandler::on_literal(std::string_view value)
+    {
+        writer.literal(value);
+    }
+
+    void WriteHandler::on_integer(std::int64_t value)
+    {
+        writer.integer(value);
+    }
+
+    void WriteHandler::on_float(double value)
+    {
+        writer.floating(value);
+    }
+
+    void WriteHandler::on_error()
+    {
+        writer.error();
+    }
+
+    // document
+    // view
+    DocumentView::DocumentView(const Document* _doc, std::uint32_t _index)
+        : doc(_doc), index(_index)
+    {}
+
+    bool DocumentView::valid() const
+    {
+        return doc != nullptr && index < doc->nodes.size();
+    }
+
+    NodeType DocumentView::type() const
+    {
+        if (!valid())
+            return Node_Error;
+        return doc->nodes[index].type;
+    }
+
+    std::size_t DocumentView::size() const
+    {
+        if (type() != Node_List)
+            return 0;
+        return doc->nodes[index].length;
+    }
+
+    DocumentView DocumentView::child(std::size_t i) const
+    {
+        if (i >= size())
+            return DocumentView();
+        // the first child is right after the list, the others are after the previous subtree
+        std::uint32_t c = index + 1;
+        for (; i > 0; i--)
+            c = doc->nodes[c].next;
+        return DocumentView(doc, c);
+    }
+
+    DocumentView DocumentView::parent() const
+    {
+        if (!valid())
+            return DocumentView();
+        return DocumentView(doc, doc->nodes[index].parent);
+    }
+
+    std::string DocumentView::to_string(WriteMode mode) const
+    {
+        std::string out;
+        if (valid())
+            doc->write(index, doc->nodes[index].next, out, mode);
+        return out;
+    }
+
+    Object DocumentView::toObject() const
+    {
+        if (!valid())
+            return Object(Token{Tkn_Error{}});
+        ObjectBuilder builder;
+        doc->write(index, doc->nodes[index].next, builder);
+        return builder.take();
+    }
+
+    void DocumentView::foreachObjectData(
+        std::function<void(const DocumentView&)> f) const
+    {
+        visitObjectData(f);
+    }
+
+    std::optional<std::string_view> DocumentView::expectLiteralData() const
+    {
+        if (type() != Node_Literal)
+            return {};
+        const Node& n = doc->nodes[index];
+        return {doc->literal(n)};
+    }
+
+    std::optional<std::int64_t> DocumentView::expectInteger() const
+    {
+        if (type() != Node_Integer)
+            return {};
+        return {std::int64_t(doc->nodes[index].offset)};
+    }
+
+    std::optional<double> DocumentView::expectFloat() const
+    {
+        if (type() == Node_Float)
+            return {Number::fromBits(doc->nodes[index].offset)};
+        if (type() == Node_Integer)
+            return {double(std::int64_t(doc->nodes[index].offset))};
+        return {};
+    }
+
+    std::optional<std::uint32_t> DocumentView::symbol() const
+    {
+        if (type() != Node_Literal)
+            return {};
+        const Node& n = doc->nodes[index];
+        if (!(n.flags & Node_Interned))
+            return {};
+        return {std::uint32_t(n.offset)};
+    }
+
+    // document
+    Document Document::fromObject(const Object& obj)
+    {
+        Document doc;
+        // the lists being filled, with the next child to add
+        struct Frame
+        {
+            std::uint32_t index;
+            ObjectList::const_iterator it;
+            ObjectList::const_iterator end;
+        };
+        std::vector<Frame> open;
+        const Object* o = &obj;
+        std::uint32_t parent = 0;
+        while (o != nullptr)
+        {
+            std::uint32_t idx = doc.nodes.size();
+            doc.nodes.push_back(Node{Node_Error, 0, parent, idx + 1, 0, 0});
+            if (parent != idx)
+                doc.nodes[parent].length++;
+            auto visitor = overload
+            {
+                [&doc, idx](const Tkn_Literal& literal)
+                {
+                    Node& n = doc.nodes[idx];
+                    n.type = Node_Literal;
+                    n.offset = doc.pool.size();
+                    n.length = literal.value.length();
+                    doc.pool += literal.value;
+                },
+                [&doc, &open, idx](const Tkn_Object& object)
+                {
+                    doc.nodes[idx].type = Node_List;
+                    open.push_back(Frame{idx, object.value.begin(), object.value.end()});
+                },
+                [](const Tkn_Error& error)
+                {},
+                [&doc, idx](const Tkn_Integer& number)
+                {
+                    doc.nodes[idx].type = Node_Integer;
+                    doc.nodes[idx].offset = number.value;
+                },
+                [&doc, idx](const Tkn_Float& number)
+                {
+                    doc.nodes[idx].type = Node_Float;
+                    doc.nodes[idx].offset = Number::toBits(number.value);
+                }
+            };
+            std::visit(visitor, o->token);
+
+            o = nullptr;
+            while (!open.empty())
+            {
+                Frame& f = open.back();
+                if (f.it != f.end)
+                {
+                    o = &*f.it++;
+                    parent = f.index;
+                    break;
+                }
+                doc.nodes[f.index].next = doc.nodes.size();
+                open.pop_back();
+            }
+        }
+        return doc;
+    }
+
+    DocumentView Document::root() const
+    {
+        return DocumentView(this, 0);
+    }
+
+    std::size_t Document::size() const
+    {
+        return nodes.size();
+    }
+
+    std::string_view Document::literal(const Node& n) const
+    {
+        if (n.flags & Node_Interned)
+            return symbolTable->name(n.offset);
+        if (n.flags & Node_Borrowed)
+            return source.substr(n.offset, n.length);
+        return std::string_view(pool).substr(n.offset, n.length);
+    }
+
+    bool Document::borrowed() const
+    {
+        return !source.empty();
+    }
+
+    const SymbolTable* Document::symbols() const
+    {
+        return symbolTable.get();
+    }
+
+    void Document::materialize()
+    {
+        // an interned literal is copied only once, the nodes of the same id share it
+        std::vector<std::uint64_t> interned(symbolTable ? symbolTable->size() : 0, pool.npos);
+        for (Node& n : nodes)
+        {
+            if (n.flags & Node_Interned)
+            {
+                std::uint64_t& offset = interned[n.offset];
+                if (offset == pool.npos)
+                {
+                    offset = pool.size();
+                    pool += literal(n);
+                }
+                n.offset = offset;
+                n.flags &= ~Node_Interned;
+            }
+            else if (n.flags & Node_Borrowed)
+            {
+                std::string_view value = literal(n);
+                n.offset = pool.size();
+                n.flags &= ~Node_Borrowed;
+                pool += value;
+            }
+        }
+        source = {};
+        owner.reset();
+        symbolTable.reset();
+    }
+
+    std::string Document::to_string(WriteMode mode) const
+    {
+        std::string out;
+        write(0, nodes.size(), out, mode);
+        return out;
+    }
+
+    void Document::write(std::uint32_t from, std::uint32_t to, std::string& out, WriteMode mode) const
+    {
+        bool padded = mode == Write_Padded;
+        const char* close = padded ? ") " : ")";
+        // ends of the lists that are still open, only as deep as the document
+        std::vector<std::uint32_t> open;
+        char buffer[Number::MaxLength];
+        for (std::uint32_t i = from; i < to; i++)
+        {
+            while (!open.empty() && open.back() == i)
+            {
+                out += close;
+                open.pop_back();
+            }
+            const Node& n = nodes[i];
+            // in compact mode only the siblings are separated
+            if (!padded && i != from && n.parent + 1 != i)
+                out += ' ';
+            switch (n.type)
+            {
+            case Node_Literal:
+                out += '\'';
+                out += literal(n);
+                out += '\'';
+                break;
+            case Node_List:
+                out += padded ? "( " : "(";
+                open.push_back(n.next);
+                break;
+            case Node_Integer:
+                out += Number::format(std::int64_t(n.offset), buffer);
+                break;
+            case Node_Float:
+            {
+                double value = Number::fromBits(n.offset);
+                // the infinite and NaN ones are quoted
+                if (!std::isfinite(value))
+                    out += '\'';
+                out += Number::format(value, buffer);
+                if (!std::isfinite(value))
+                    out += '\'';
+                break;
+            }
+            default:
+                out += "ERROR";
+            }
+            if (padded && n.type != Node_List)
+                out += ' ';
+        }
+        for (; !open.empty(); open.pop_back())
+            out += close;
+    }
+
+    void Document::write(std::uint32_t from, std::uint32_t to, Writer& writer) const
+    {
+        std::vector<std::uint32_t> open;
+        for (std::uint32_t i = from; i < to; i++)
+        {
+            for (; !open.empty() && open.back() == i; open.pop_back())
+                writer.end_list();
+            const Node& n = nodes[i];
+            switch (n.type)
+            {
+            case Node_Literal:
+                writer.literal(literal(n));
+                break;
+            case Node_List:
+                writer.begin_list();
+                open.push_back(n.next);
+                break;
+            case Node_Integer:
+                writer.integer(std::int64_t(n.offset));
+                break;
+            case Node_Float:
+                writer.floating(Number::fromBits(n.offset));
+                break;
+            default:
+                writer.error();
+            }
+        }
+        for (; !open.empty(); open.pop_back())
+            writer.end_list();
+    }
+
+    // builder
+    DocumentBuilder::DocumentBuilder(std::string_view source, std::shared_ptr<const SourceBuffer> owner)
+    {
+        doc.source = source;
+        doc.owner = owner;
+    }
+
+    void DocumentBuilder::set_symbols(std::shared_ptr<SymbolTable> _symbols)
+    {
+        symbols = _symbols;
+        doc.symbolTable = _symbols;
+    }
+
+    bool DocumentBuilder::add(NodeType type)
+    {
+        // the indices of the nodes are 32 bit, a bigger document can't be built
+        if (doc.nodes.size() >= std::numeric_limits<std::uint32_t>::max())
+        {
+            on_error();
+            return false;
+        }
+        std::uint32_t idx = doc.nodes.size();
+        std::uint32_t parent = open.empty() ? idx : open.back();
+        doc.nodes.push_back(Node{type, 0, parent, idx + 1, 0, 0});
+        if (parent != idx)
+            doc.nodes[parent].length++;
+        return true;
+    }
+
+    void DocumentBuilder::on_list_begin()
+    {
+        if (!failed && add(Node_List))
+            open.push_back(doc.nodes.size() - 1);
+    }
+
+    void DocumentBuilder::on_list_end()
+    {
+        if (failed)
+            return;
+        doc.nodes[open.back()].next = doc.nodes.size();
+        open.pop_back();
+    }
+
+    void DocumentBuilder::on_literal(std::string_view value)
+    {
+        if (failed)
+            return;
+        if (value.length() > std::numeric_limits<std::uint32_t>::max())
+        {
+            on_error();
+            return;
+        }
+        if (!add(Node_Literal))
+            return;
+        Node& n = doc.nodes.back();
+        n.length = value.length();
+        if (symbols && value.length() <= SymbolTable::MaxLength)
+        {
+            n.flags |= Node_Interned;
+            n.offset = symbols->intern(value);
+            return;
+        }
+        // a view into the source is kept as it is, anything else is copied to the pool
+        std::less_equal<const char*> le;
+        const char* begin = doc.source.data();
+        if (!doc.source.empty() && le(begin, value.data())
+            && le(value.data() + value.length(), begin + doc.source.length()))
+        {
+            n.flags |= Node_Borrowed;
+            n.offset = value.data() - begin;
+            return;
+        }
+        n.offset = doc.pool.size();
+        doc.pool += value;
+    }
+
+    void DocumentBuilder::on_integer(std::int64_t value)
+    {
+        if (!failed && add(Node_Integer))
+            doc.nodes.back().offset = value;
+    }
+
+    void DocumentBuilder::on_float(double value)
+    {
+        if (!failed && add(Node_Float))
+            doc.nodes.back().offset = Number::toBits(value);
+    }
+
+    void DocumentBuilder::on_error()
+    {
+        // a broken document is a single error node, the events after it are ignored
+        failed = true;
+        open.clear();
+        doc.nodes.assign(1, Node{Node_Error, 0, 0, 1, 0, 0});
+        doc.pool.clear();
+        doc.source = {};
+        doc.owner.reset();
+    }
+
+    Document DocumentBuilder::take()
+    {
+        return std::move(doc);
+    }
+
+    // symbols
+    std::uint32_t SymbolTable::intern(std::string_view name)
+    {
+        auto it = ids.find(name);
+        if (it != ids.end())
+            return it->second;
+        std::uint32_t id = names.size();
+        const std::string& stored = names.emplace_back(name);
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    std::optional<std::uint32_t> SymbolTable::find(std::string_view name) const
+    {
+        auto it = ids.find(name);
+        if (it == ids.end())
+            return {};
+        return {it->second};
+    }
+
+    std::string_view SymbolTable::name(std::uint32_t id) const
+    {
+        if (id >= names.size())
+            return {};
+        return names[id];
+    }
+
+    std::size_t SymbolTable::size() const
+    {
+        return names.size();
+    }
+
+    // scanner
+    using ClassifyFn = BlockMasks (*)(const char*);
+
+    static BlockMasks classifyScalar(const char* block)
+    {
+        BlockMasks m{0, 0, 0, 0};
+        for (std::size_t i = 0; i < Scanner::BlockSize; i++)
+        {
+            std::uint64_t bit = std::uint64_t(1) << i;
+            switch (block[i])
+            {
+            case '\'': m.quote |= bit; break;
+            case '(': m.leftParen |= bit; break;
+            case ')': m.rightParen |= bit; break;
+            case ' ': case '\t': case '\n': m.whitespace |= bit; break;
+            default: break;
+            }
+        }
+        return m;
+    }
+
+#ifdef LISON_X86
+    __attribute__((target("sse2")))
+    static inline std::uint64_t equal128(__m128i v, char c)
+    {
+        return static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))));
+    }
+
+    __attribute__((target("sse2")))
+    static BlockMasks classifySSE2(const char* block)
+    {
+        BlockMasks m{0, 0, 0, 0};
+        for (std::size_t i = 0; i < Scanner::BlockSize; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+            m.quote |= equal128(v, '\'') << i;
+            m.leftParen |= equal128(v, '(') << i;
+            m.rightParen |= equal128(v, ')') << i;
+            m.whitespace |= (equal128(v, ' ') | equal128(v, '\t') | equal128(v, '\n')) << i;
+        }
+        return m;
+    }
+
+    __attribute__((target("avx2")))
+    static inline std::uint64_t equal256(__m256i v, char c)
+    {
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+    }
+
+    __attribute__((target("avx2")))
+    static BlockMasks classifyAVX2(const char* block)
+    {
+        BlockMasks m{0, 0, 0, 0};
+        for (std::size_t i = 0; i < Scanner::BlockSize; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+            m.quote |= equal256(v, '\'') << i;
+            m.leftParen |= equal256(v, '(') << i;
+            m.rightParen |= equal256(v, ')') << i;
+            m.whitespace |= (equal256(v, ' ') | equal256(v, '\t') | equal256(v, '\n')) << i;
+        }
+        return m;
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    static BlockMasks classifyAVX512(const char* block)
+    {
+        __m512i v = _mm512_loadu_si512(block);
+        BlockMasks m;
+        m.quote = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\''));
+        m.leftParen = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('('));
+        m.rightParen = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(')'));
+        m.whitespace = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '))
+            | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\t'))
+            | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+        return m;
+    }
+#endif
+
+    struct ScannerImplementation
+    {
+        const char* name;
+        ClassifyFn fn;
+        bool supported;
+    };
+
+    // the best one first
+    static const std::vector<ScannerImplementation>& scannerImplementations()
+    {
+        static const std::vector<ScannerImplementation> impls = []
+        {
+            std::vector<ScannerImplementation> list;
+#ifdef LISON_X86
+            __builtin_cpu_init();
+            list.push_back({"avx512", classifyAVX512,
+                            __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")});
+            list.push_back({"avx2", classifyAVX2, (bool)__builtin_cpu_supports("avx2")});
+            list.push_back({"sse2", classifySSE2, (bool)__builtin_cpu_supports("sse2")});
+#endif
+            list.push_back({"scalar", classifyScalar, true});
+            return list;
+        }();
+        return impls;
+    }
+
+    // atomic, select can be called while the workers of a parser classify
+    static std::atomic<const ScannerImplementation*>& activeScanner()
+    {
+        static std::atomic<const ScannerImplementation*> active = []
+        {
+            // the scalar one is always supported
+            for (auto& impl : scannerImplementations())
+                if (impl.supported)
+                    return &impl;
+            return &scannerImplementations().back();
+        }();
+        return active;
+    }
+
+    BlockMasks Scanner::classify(const char* block, std::size_t length)
+    {
+        ClassifyFn fn = activeScanner().load(std::memory_order_relaxed)->fn;
+        if (length >= BlockSize)
+            return fn(block);
+        // the tail of the source, zeros are not structural
+        char padded[BlockSize] = {0};
+        std::memcpy(padded, block, length);
+        return fn(padded);
+    }
+
+    std::uint64_t Scanner::literalMask(std::uint64_t quote, bool& inside)
+    {
+        // prefix xor: every bit is the parity of the quotes up to and including it
+        std::uint64_t mask = quote;
+        mask ^= mask << 1;
+        mask ^= mask << 2;
+        mask ^= mask << 4;
+        mask ^= mask << 8;
+        mask ^= mask << 16;
+        mask ^= mask << 32;
+        if (inside)
+            mask = ~mask;
+        inside = (mask >> (BlockSize - 1)) & 1;
+        return mask;
+    }
+
+    const char* Scanner::implementation()
+    {
+        return activeScanner().load(std::memory_order_relaxed)->name;
+    }
+
+    bool Scanner::select(const std::string& name)
+    {
+        for (auto& impl : scannerImplementations())
+        {
+            if (name == impl.name && impl.supported)
+            {
+                activeScanner().store(&impl, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // tokenizer
+    Tokenizer::Symbol Tokenizer::classify(char c)
+    {
+        if (c == '\'')
+            return Sym_Quote;
+        else if (c == '(')
+            return Sym_LeftParen;
+        else if (c == ')')
+            return Sym_RightParen;
+        else if (c == '\t' || c == '\n' || c == ' ')
+            return Sym_Whitespace;
+        else
+            return Sym_Character;
+    }
+
+    void Tokenizer::set_memory_resource(std::pmr::memory_resource* _resource)
+    {
+        resource = _resource;
+    }
+
+    std::pmr::list<Tokenizer::SymbolObject> Tokenizer::tokenize(const std::string& src)
+    {
+        std::pmr::list<SymbolObject> symbolStream(resource);
+        for (unsigned i=0;i<src.length();i++)
+        {
+            char c = src[i];
+            SymbolObject sym;
+            sym.sym = classify(c);
+            if (sym.sym == Sym_Character)
+                sym.character = c;
+            symbolStream.push_back(sym);
+        }
+        return symbolStream;
+    }
+
+    // lexer
+    Lexer::Lexer(std::string_view _src)
+        : src(_src)
+    {}
+
+    Tokenizer::Symbol Lexer::peek() const
+    {
+        if (pos >= src.length())
+            return Tokenizer::Sym_NIL;
+        return Tokenizer::classify(src[pos]);
+    }
+
+    void Lexer::advance()
+    {
+        if (pos < src.length())
+            ++pos;
+    }
+
+    bool Lexer::done() const
+    {
+        return pos >= src.length();
+    }
+
+    std::string_view Lexer::literal()
+    {
+        // jumps to the next structural character a block at a time
+        std::size_t start = pos;
+        while (pos < src.length())
+        {
+            std::size_t current = pos - pos % Scanner::BlockSize;
+            if (current != block)
+            {
+                BlockMasks m = Scanner::classify(src.data() + current,
+                                                 std::min(Scanner::BlockSize, src.length() - current));
+                structural = m.quote | m.leftParen | m.rightParen;
+                block = current;
+            }
+            std::uint64_t ahead = structural >> (pos - current);
+            if (ahead != 0)
+            {
+                pos += __builtin_ctzll(ahead);
+                break;
+            }
+            pos = current + Scanner::BlockSize;
+        }
+        if (pos > src.length())
+            pos = src.length();
+        return src.substr(start, pos - start);
+    }
+
+    std::string_view Lexer::number()
+    {
+        std::size_t start = pos;
+        while (peek() == Tokenizer::Sym_Character)
+            ++pos;
+        return src.substr(start, pos - start);
+    }
+
+    std::string_view Lexer::fold(std::string_view body, std::string& buffer)
+    {
+        if (body.find_first_of("\t\n") == std::string_view::npos)
+            return body;
+        buffer.assign(body);
+        for (char& c : buffer)
+            if (c == '\t' || c == '\n')
+                c = ' ';
+        return buffer;
+    }
+
+    // parser
+	// consume symbol, but don't use it
+	// can be used to check if a special symbol is present
+    bool Parser::accept(Tokenizer::Symbol req)
+    {
+        if (lexer.peek() == req)
+        {
+            lexer.advance();
+            return true;
+        }
+        return false;
+    }
+
+    bool Parser::literal(Handler& handler)
+    {
+        if (!accept(Tokenizer::Sym_Quote))
+            return false;
+        // the whole body comes in one span, only the whitespaces get folded
+        std::string_view body = lexer.literal();
+        if (!accept(Tokenizer::Sym_Quote))
+            return false;
+        handler.on_literal(Lexer::fold(body, folded));
+        return true;
+    }
+
+    // unquoted, so it can only be a number
+    bool Parser::number(Handler& handler)
+    {
+        if (lexer.peek() != Tokenizer::Sym_Character)
+            return false;
+        std::int64_t integer;
+        double floating;
+        std::string_view text = lexer.number();
+        switch (Number::parse(text, integer, floating))
+        {
+        case Number_Integer:
+            handler.on_integer(integer);
+            return true;
+        case Number_Float:
+            handler.on_float(floating);
+            return true;
+        case Number_Large:
+            handler.on_literal(text);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+	/*
+	  Object => [LeftParen] -> [String | [Whitespace -> Object] -> [RightParen]
+	            |------------------------|
+	 */
+
+    bool Parser::object(Handler& handler)
+    {
+        // no recursion: the events need nothing from the enclosing lists but their number
+        // (the builders keep their own stack), so any depth costs the same
+        std::size_t depth = 0;
+        while (true)
+        {
+            // yank the whitespaces
+            while (accept(Tokenizer::Sym_Whitespace));
+
+            // end of the actual list
+            if (depth > 0 && accept(Tokenizer::Sym_RightParen))
+            {
+                handler.on_list_end();
+                if (--depth == 0)
+                    return true;
+            }
+            // left paren, that means a new list
+            else if (accept(Tokenizer::Sym_LeftParen))
+            {
+                if (++depth > maxDepth)
+                    return false;
+                handler.on_list_begin();
+            }
+            // doesn't start with a left paren -> it's a literal or a number
+            else if (literal(handler) || number(handler))
+            {
+                if (depth == 0)
+                    return true;
+            }
+            else
+                return false;
+        }
+    }
+
+    void Parser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    void Parser::set_memory_resource(std::pmr::memory_resource* _resource)
+    {
+        resource = _resource;
+    }
+
+    void Parser::set_symbols(std::shared_ptr<SymbolTable> _symbols)
+    {
+        symbols = _symbols;
+    }
+
+    bool Parser::parse(std::string_view src, Handler& handler)
+    {
+        lexer = Lexer(src);
+        if (!object(handler))
+        {
+            handler.on_error();
+            return false;
+        }
+        handler.on_element_end();
+        return true;
+    }
+
+    bool Parser::parseSequence(std::string_view src, Handler& handler)
+    {
+        lexer = Lexer(src);
+        while (true)
+        {
+            while (accept(Tokenizer::Sym_Whitespace));
+            if (lexer.done())
+                return true;
+            if (!object(handler))
+            {
+                handler.on_error();
+                return false;
+            }
+            handler.on_element_end();
+        }
+    }
+
+    Object Parser::parse(const std::pmr::list<Tokenizer::SymbolObject>& symbolStream)
+    {
+        // the symbols are turned back into source, so there is only one grammar
+        std::string src;
+        for (auto& sym : symbolStream)
+        {
+            switch (sym.sym)
+            {
+            case Tokenizer::Sym_Quote: src += '\''; break;
+            case Tokenizer::Sym_LeftParen: src += '('; break;
+            case Tokenizer::Sym_RightParen: src += ')'; break;
+            case Tokenizer::Sym_Whitespace: src += ' '; break;
+            case Tokenizer::Sym_Character: src += sym.character; break;
+            default: break;
+            }
+        }
+        return parse(std::string_view(src));
+    }
+
+    // the trees are built from the same events
+    Object Parser::parse(std::string_view src)
+    {
+        ObjectBuilder builder(resource);
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Parser::parseDocument(std::string_view src, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(src);
+        builder.set_symbols(symbols);
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Parser::parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        // a file that could not be opened is a broken document
+        if (!source)
+        {
+            builder.on_error();
+            return builder.take();
+        }
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(source->view(), source);
+        builder.set_symbols(symbols);
+        parse(source->view(), builder);
+        return builder.take();
+    }
+
+    // push parser
+    PushParser::PushParser(Handler& _handler)
+        : handler(_handler)
+    {}
+
+    void PushParser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool PushParser::fail()
+    {
+        if (state != State_Error)
+        {
+            state = State_Error;
+            handler.on_error();
+        }
+        return false;
+    }
+
+    bool PushParser::number()
+    {
+        std::int64_t integer;
+        double floating;
+        switch (Number::parse(pending, integer, floating))
+        {
+        case Number_Integer:
+            handler.on_integer(integer);
+            break;
+        case Number_Float:
+            handler.on_float(floating);
+            break;
+        case Number_Large:
+            handler.on_literal(pending);
+            break;
+        default:
+            return fail();
+        }
+        pending.clear();
+        state = State_Between;
+        if (depth == 0)
+            handler.on_element_end();
+        return true;
+    }
+
+    bool PushParser::feed(std::string_view chunk)
+    {
+        Lexer lexer(chunk);
+        while (state != State_Error && !lexer.done())
+        {
+            if (state == State_Number)
+            {
+                // the number goes until anything but a character, that may be in a later chunk
+                pending += lexer.number();
+                if (lexer.done() || !number())
+                    break;
+                continue;
+            }
+            if (state == State_Literal)
+            {
+                // the body goes until the next structural symbol, that may be in a later chunk
+                std::string_view body = lexer.literal();
+                if (lexer.done())
+                {
+                    pending += body;
+                    break;
+                }
+                if (lexer.peek() != Tokenizer::Sym_Quote)
+                    return fail();
+                lexer.advance();
+                if (!pending.empty())
+                {
+                    pending += body;
+                    body = pending;
+                }
+                handler.on_literal(Lexer::fold(body, folded));
+                pending.clear();
+                state = State_Between;
+                if (depth == 0)
+                    handler.on_element_end();
+                continue;
+            }
+            switch (lexer.peek())
+            {
+            case Tokenizer::Sym_Whitespace:
+                break;
+            case Tokenizer::Sym_Quote:
+                state = State_Literal;
+                break;
+            case Tokenizer::Sym_Character:
+                state = State_Number;
+                continue;
+            case Tokenizer::Sym_LeftParen:
+                if (++depth > maxDepth)
+                    return fail();
+                handler.on_list_begin();
+                break;
+            case Tokenizer::Sym_RightParen:
+                if (depth == 0)
+                    return fail();
+                depth--;
+                handler.on_list_end();
+                if (depth == 0)
+                    handler.on_element_end();
+                break;
+            default:
+                return fail();
+            }
+            lexer.advance();
+        }
+        return state != State_Error;
+    }
+
+    bool PushParser::finish()
+    {
+        // a number at the very end has nothing after it to close it
+        if (state == State_Number && !number())
+            return false;
+        if (state != State_Between || depth != 0)
+            return fail();
+        return true;
+    }
+
+    // pull parser
+    PullParser::PullParser(std::string_view src)
+        : lexer(src)
+    {}
+
+    void PullParser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool PullParser::accept(Tokenizer::Symbol req)
+    {
+        if (lexer.peek() == req)
+        {
+            lexer.advance();
+            return true;
+        }
+        return false;
+    }
+
+    PullEvent PullParser::fail()
+    {
+        failed = true;
+        return Pull_Error;
+    }
+
+    // the same grammar as Parser::object, one event at a time
+    PullEvent PullParser::next()
+    {
+        if (failed)
+            return Pull_Error;
+        if (done)
+            return Pull_End;
+        while (accept(Tokenizer::Sym_Whitespace));
+        if (depth > 0 && accept(Tokenizer::Sym_RightParen))
+        {
+            done = --depth == 0;
+            return Pull_ListEnd;
+        }
+        if (accept(Tokenizer::Sym_LeftParen))
+        {
+            if (++depth > maxDepth)
+                return fail();
+            return Pull_ListBegin;
+        }
+        if (lexer.peek() == Tokenizer::Sym_Character)
+        {
+            std::string_view text = lexer.number();
+            NumberType type = Number::parse(text, integerValue, floatValue);
+            if (type == Number_None)
+                return fail();
+            if (type == Number_Large)
+            {
+                value = text;
+                done = depth == 0;
+                return Pull_Literal;
+            }
+            if (type == Number_Integer)
+                floatValue = double(integerValue);
+            done = depth == 0;
+            return type == Number_Integer ? Pull_Integer : Pull_Float;
+        }
+        if (!accept(Tokenizer::Sym_Quote))
+            return fail();
+        std::string_view body = lexer.literal();
+        if (!accept(Tokenizer::Sym_Quote))
+            return fail();
+        value = Lexer::fold(body, folded);
+        done = depth == 0;
+        return Pull_Literal;
+    }
+
+    std::string_view PullParser::literal() const
+    {
+        return value;
+    }
+
+    std::int64_t PullParser::integer() const
+    {
+        return integerValue;
+    }
+
+    double PullParser::floating() const
+    {
+        return floatValue;
+    }
+
+    bool PullParser::skip()
+    {
+        std::size_t until = depth - 1;
+        while (depth > until)
+        {
+            PullEvent event = next();
+            if (event == Pull_Error || event == Pull_End)
+                return false;
+        }
+        return true;
+    }
+
+    // parallel
+    // parallel parser
+    ParallelParser::ParallelParser()
+        : threads(std::max(1u, std::thread::hardware_concurrency()))
+    {}
+
+    void ParallelParser::set_threads(unsigned _threads)
+    {
+        threads = std::max(1u, _threads);
+    }
+
+    void ParallelParser::set_chunk_size(std::size_t _chunkSize)
+    {
+        chunkSize = std::max<std::size_t>(1, _chunkSize);
+    }
+
+    void ParallelParser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool ParallelParser::split(std::string_view src, std::vector<std::size_t>& bounds) const
+    {
+        std::size_t start = 0;
+        while (start < src.length() && Tokenizer::classify(src[start]) == Tokenizer::Sym_Whitespace)
+            start++;
+        if (start == src.length() || src[start] != '(')
+            return false;
+        std::size_t ranges = std::min<std::size_t>(threads, (src.length() - start) / chunkSize);
+        if (ranges < 2)
+            return false;
+        std::size_t step = (src.length() - start) / ranges;
+
+        bounds.assign(1, start + 1);
+        std::size_t target = start + step;
+        std::size_t depth = 0;
+        bool inside = false;
+        for (std::size_t block = start - start % Scanner::BlockSize; block < src.length(); block += Scanner::BlockSize)
+        {
+            BlockMasks m = Scanner::classify(src.data() + block,
+                                             std::min(Scanner::BlockSize, src.length() - block));
+            if (block < start)
+            {
+                std::uint64_t after = ~std::uint64_t(0) << (start - block);
+                m.quote &= after;
+                m.leftParen &= after;
+                m.rightParen &= after;
+            }
+            std::uint64_t literal = Scanner::literalMask(m.quote, inside);
+            std::uint64_t left = m.leftParen & ~literal;
+            std::uint64_t right = m.rightParen & ~literal;
+            bool hunting = bounds.size() < ranges && block + Scanner::BlockSize > target;
+            // nothing to look for in this block, only the depth matters
+            std::size_t closing = __builtin_popcountll(right);
+            if (!hunting && depth > closing)
+            {
+                depth += __builtin_popcountll(left);
+                depth -= closing;
+                continue;
+            }
+            // a range starts where a child of the root does, after the target
+            std::uint64_t events = left | right | (m.quote & literal);
+            while (events != 0)
+            {
+                int bit = __builtin_ctzll(events);
+                std::size_t pos = block + bit;
+                if ((right >> bit) & 1)
+                {
+                    if (--depth == 0)
+                    {
+                        bounds.push_back(pos);
+                        return true;
+                    }
+                }
+                else
+                {
+                    if (depth == 1 && pos >= target && bounds.size() < ranges)
+                    {
+                        bounds.push_back(pos);
+                        target = pos + step;
+                    }
+                    if ((left >> bit) & 1)
+                        depth++;
+                }
+                events &= events - 1;
+            }
+        }
+        // the root is never closed
+        return false;
+    }
+
+    template <class F>
+    void ParallelParser::run(std::size_t ranges, F&& f) const
+    {
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < ranges; i++)
+            workers.emplace_back([&f, i]() { f(i); });
+        f(0);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    Object ParallelParser::parse(std::string_view src)
+    {
+        Parser sequential;
+        sequential.set_max_depth(maxDepth);
+        std::vector<std::size_t> bounds;
+        if (maxDepth == 0 || !split(src, bounds))
+            return sequential.parse(src);
+
+        // the children of every range, one list per range
+        std::size_t ranges = bounds.size() - 1;
+        std::vector<ObjectList> parts(ranges);
+        std::vector<char> ok(ranges, false);
+        run(ranges, [&](std::size_t i)
+        {
+            Parser parser;
+            // the root is one level already
+            parser.set_max_depth(maxDepth - 1);
+            ObjectList& part = parts[i];
+            ObjectStream stream([&part](Object&& obj) { part.push_back(std::move(obj)); });
+            ok[i] = parser.parseSequence(src.substr(bounds[i], bounds[i + 1] - bounds[i]), stream);
+        });
+        // a broken source is reported exactly the way the sequential parser does it
+        if (std::find(ok.begin(), ok.end(), false) != ok.end())
+            return sequential.parse(src);
+
+        Object root(Token{Tkn_Object{}});
+        ObjectList& children = std::get<Tkn_Object>(root.token).value;
+        for (ObjectList& part : parts)
+            children.splice(children.end(), part);
+        return root;
+    }
+
+    Document ParallelParser::parseDocument(std::string_view src, DocumentMode mode)
+    {
+        return build(src, mode, nullptr);
+    }
+
+    Document ParallelParser::parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode)
+    {
+        // a file that could not be opened is a broken document
+        if (!source)
+        {
+            DocumentBuilder builder;
+            builder.on_error();
+            return builder.take();
+        }
+        return build(source->view(), mode, source);
+    }
+
+    Document ParallelParser::build(std::string_view src, DocumentMode mode, std::shared_ptr<const SourceBuffer> owner)
+    {
+        bool borrowed = mode == Document_Borrowed;
+        auto sequential = [&]()
+        {
+            Parser parser;
+            parser.set_max_depth(maxDepth);
+            DocumentBuilder builder;
+            if (borrowed)
+                builder = DocumentBuilder(src, owner);
+            parser.parse(src, builder);
+            return builder.take();
+        };
+        std::vector<std::size_t> bounds;
+        if (maxDepth == 0 || !split(src, bounds))
+            return sequential();
+
+        // every range is a document of its own, with the children of the root as top-level nodes
+        std::size_t ranges = bounds.size() - 1;
+        std::vector<Document> parts(ranges);
+        std::vector<char> ok(ranges, false);
+        run(ranges, [&](std::size_t i)
+        {
+            Parser parser;
+            parser.set_max_depth(maxDepth - 1);
+            DocumentBuilder builder;
+            // the literals are borrowed from the whole source, so their offsets are already right
+            if (borrowed)
+                builder = DocumentBuilder(src, owner);
+            ok[i] = parser.parseSequence(src.substr(bounds[i], bounds[i + 1] - bounds[i]), builder);
+            parts[i] = builder.take();
+        });
+        if (std::find(ok.begin(), ok.end(), false) != ok.end())
+            return sequential();
+
+        // where the nodes and the literals of each part go in the joined document
+        std::vector<std::uint32_t> nodeBase(ranges);
+        std::vector<std::size_t> poolBase(ranges);
+        std::size_t nodes = 1;
+        std::size_t pool = 0;
+        for (std::size_t i = 0; i < ranges; i++)
+        {
+            nodeBase[i] = nodes;
+            poolBase[i] = pool;
+            nodes += parts[i].nodes.size();
+            pool += parts[i].pool.size();
+            // the node indices are 32 bit: a part that didn't fit in them is an error node,
+            // and so is the whole if the parts don't fit together
+            bool overflow = parts[i].nodes.size() == 1 && parts[i].nodes[0].type == Node_Error;
+            if (overflow || nodes > std::numeric_limits<std::uint32_t>::max())
+            {
+                DocumentBuilder builder;
+                builder.on_error();
+                return builder.take();
+            }
+        }
+        Document doc;
+        if (borrowed)
+        {
+            doc.source = src;
+            doc.owner = owner;
+        }
+        doc.nodes.resize(nodes);
+        doc.pool.resize(pool);
+        std::vector<std::uint32_t> children(ranges, 0);
+        run(ranges, [&](std::size_t i)
+        {
+            const Document& part = parts[i];
+            std::uint32_t base = nodeBase[i];
+            for (std::uint32_t j = 0; j < part.nodes.size(); j++)
+            {
+                Node n = part.nodes[j];
+                // the top-level nodes of the part are the children of the root
+                if (n.parent == j)
+                {
+                    n.parent = 0;
+                    children[i]++;
+                }
+                else
+                    n.parent += base;
+                n.next += base;
+                if (n.type == Node_Literal && !(n.flags & Node_Borrowed))
+                    n.offset += poolBase[i];
+                doc.nodes[base + j] = n;
+            }
+            std::memcpy(&doc.pool[poolBase[i]], part.pool.data(), part.pool.size());
+        });
+        std::uint32_t length = 0;
+        for (std::uint32_t c : children)
+            length += c;
+        doc.nodes[0] = Node{Node_List, 0, 0, std::uint32_t(nodes), length, 0};
+        return doc;
+    }
+
+    // parallel writer
+    ParallelWriter::ParallelWriter()
+        : threads(std::max(1u, std::thread::hardware_concurrency()))
+    {}
+
+    void ParallelWriter::set_threads(unsigned _threads)
+    {
+        threads = std::max(1u, _threads);
+    }
+
+    void ParallelWriter::set_min_elements(std::size_t _minElements)
+    {
+        minElements = _minElements;
+    }
+
+    void ParallelWriter::plan(const Object& obj, std::size_t want, std::size_t depth, WriteMode mode,
+                              std::vector<Piece>& pieces, std::size_t& split) const
+    {
+        bool padded = mode == Write_Padded;
+        const ObjectList* list = obj.expectObjectList();
+        if (list == nullptr || list->empty() || want < 2 || depth >= MaxSplitDepth)
+        {
+            Piece whole;
+            whole.single = &obj;
+            pieces.push_back(std::move(whole));
+            return;
+        }
+        Piece text;
+        text.text = padded ? "( " : "(";
+        pieces.push_back(text);
+        // in compact mode the pieces are siblings, so there is a space between them
+        text.text = " ";
+        if (list->size() >= want)
+        {
+            // long enough to be split into runs of about the same length
+            auto it = list->begin();
+            for (std::size_t r = 0; r < want; r++)
+            {
+                if (r > 0 && !padded)
+                    pieces.push_back(text);
+                Piece run;
+                run.first = it;
+                run.count = list->size() / want + (r < list->size() % want ? 1 : 0);
+                std::advance(it, run.count);
+                pieces.push_back(std::move(run));
+            }
+            split += list->size();
+        }
+        else
+        {
+            // too short, its children are split instead
+            std::size_t each = (want + list->size() - 1) / list->size();
+            for (auto it = list->begin(); it != list->end(); ++it)
+            {
+                if (it != list->begin() && !padded)
+                    pieces.push_back(text);
+                plan(*it, each, depth + 1, mode, pieces, split);
+            }
+        }
+        text.text = padded ? ") " : ")";
+        pieces.push_back(text);
+    }
+
+    void ParallelWriter::render(std::vector<Piece>& pieces, WriteMode mode,
+                                const std::function<void(std::size_t from, std::size_t to)>& ready) const
+    {
+        // the texts are done from the start, the rest is taken by the workers front to back
+        std::vector<std::size_t> tasks;
+        std::vector<char> done(pieces.size(), true);
+        for (std::size_t i = 0; i < pieces.size(); i++)
+        {
+            if (pieces[i].single != nullptr || pieces[i].count > 0)
+            {
+                tasks.push_back(i);
+                done[i] = false;
+            }
+        }
+        std::atomic<std::size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        auto work = [&]()
+        {
+            for (std::size_t t = next++; t < tasks.size(); t = next++)
+            {
+                Piece& piece = pieces[tasks[t]];
+                StringWriter writer(piece.text, mode);
+                if (piece.single != nullptr)
+                    piece.single->write(writer);
+                else
+                {
+                    auto it = piece.first;
+                    for (std::size_t i = 0; i < piece.count; i++, ++it)
+                        it->write(writer);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done[tasks[t]] = true;
+                }
+                finished.notify_one();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < std::min<std::size_t>(threads, tasks.size()); i++)
+            workers.emplace_back(work);
+
+        // this thread passes the output on while the rest is being written
+        for (std::size_t from = 0; from < pieces.size();)
+        {
+            std::size_t to = from;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [&]() { return done[from]; });
+                while (to < pieces.size() && done[to])
+                    to++;
+            }
+            ready(from, to);
+            from = to;
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    std::string ParallelWriter::to_string(const Object& obj, WriteMode mode) const
+    {
+        std::vector<Piece> pieces;
+        std::size_t split = 0;
+        plan(obj, threads * 4, 0, mode, pieces, split);
+        if (threads < 2 || split < minElements)
+            return obj.to_string(mode);
+
+        std::string out;
+        render(pieces, mode, [&](std::size_t from, std::size_t to)
+        {
+            for (; from < to; from++)
+            {
+                out += pieces[from].text;
+                std::string().swap(pieces[from].text);
+            }
+        });
+        return out;
+    }
+
+    bool ParallelWriter::write(const Object& obj, const std::string& filename, WriteMode mode) const
+    {
+        std::vector<Piece> pieces;
+        std::size_t split = 0;
+        plan(obj, threads * 4, 0, mode, pieces, split);
+        if (threads < 2 || split < minElements)
+        {
+            // small enough to be streamed on this thread
+            FileWriter writer(filename, mode);
+            if (!writer.is_open())
+                return false;
+            obj.write(writer);
+            return true;
+        }
+
+#ifdef LISON_WRITEV
+        int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = true;
+        render(pieces, mode, [&](std::size_t from, std::size_t to)
+        {
+            // the buffers go out as they are, without putting them together
+            std::vector<iovec> io;
+            for (std::size_t i = from; i < to; i++)
+                if (!pieces[i].text.empty())
+                    io.push_back(iovec{pieces[i].text.data(), pieces[i].text.size()});
+            std::size_t first = 0;
+            while (ok && first < io.size())
+            {
+                int count = std::min<std::size_t>(io.size() - first, IOV_MAX);
+                ssize_t written = ::writev(fd, &io[first], count);
+                if (written < 0)
+                {
+                    ok = errno == EINTR;
+                    continue;
+                }
+                // a short write leaves the rest of the buffers for the next round
+                for (; first < io.size() && std::size_t(written) >= io[first].iov_len; first++)
+                    written -= io[first].iov_len;
+                if (first < io.size())
+                {
+                    io[first].iov_base = static_cast<char*>(io[first].iov_base) + written;
+                    io[first].iov_len -= written;
+                }
+            }
+            for (std::size_t i = from; i < to; i++)
+                std::string().swap(pieces[i].text);
+        });
+        return ::close(fd) == 0 && ok;
+#else
+        std::ofstream file;
+        file.open(filename,std::ios_base::out);
+        if (!file.is_open())
+            return false;
+        render(pieces, mode, [&](std::size_t from, std::size_t to)
+        {
+            for (; from < to; from++)
+            {
+                file.write(pieces[from].text.data(), pieces[from].text.size());
+                std::string().swap(pieces[from].text);
+            }
+        });
+        file.close();
+        return bool(file);
+#endif
+    }
+
+    // binary
+    static void putVarint(std::string& out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += char((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += char(value);
+    }
+
+    static void putHead(std::string& out, std::uint64_t count, BinaryTag tag)
+    {
+        putVarint(out, count << 2 | tag);
+    }
+
+    // zigzag, so the small negative ones are short too
+    static void putInteger(std::string& out, std::int64_t value)
+    {
+        putHead(out, 0, Binary_Number);
+        putVarint(out, std::uint64_t(value) << 1 ^ std::uint64_t(value >> 63));
+    }
+
+    static void putFloat(std::string& out, double value)
+    {
+        putHead(out, 1, Binary_Number);
+        std::uint64_t bits = Number::toBits(value);
+        for (int i = 0; i < 8; i++, bits >>= 8)
+            out += char(bits & 0xff);
+    }
+
+    // object -> binary
+	std::string Object::to_binary() const
+	{
+		std::string out;
+		encode(out);
+		return out;
+	}
+
+	void Object::encode(std::string& out) const
+	{
+		out += Decoder::Magic;
+		// the children that are left to encode, the lists know their size up front
+		struct Frame
+		{
+			ObjectList::const_iterator it;
+			ObjectList::const_iterator end;
+		};
+		std::vector<Frame> open;
+		const Object* obj = this;
+		while (obj != nullptr)
+		{
+			auto visitor = overload
+			{
+				[&out](const Tkn_Literal& literal)
+				{
+					putHead(out, literal.value.size(), Binary_Literal);
+					out += literal.value;
+				},
+				[&out, &open](const Tkn_Object& object)
+				{
+					putHead(out, object.value.size(), Binary_List);
+					open.push_back(Frame{object.value.begin(), object.value.end()});
+				},
+				[&out](const Tkn_Error& error)
+				{
+					putHead(out, 0, Binary_Error);
+				},
+				[&out](const Tkn_Integer& number)
+				{
+					putInteger(out, number.value);
+				},
+				[&out](const Tkn_Float& number)
+				{
+					putFloat(out, number.value);
+				}
+			};
+			std::visit(visitor, obj->token);
+
+			obj = nullptr;
+			for (; !open.empty(); open.pop_back())
+			{
+				Frame& f = open.back();
+				if (f.it != f.end)
+				{
+					obj = &*f.it++;
+					break;
+				}
+			}
+		}
+	}
+
+    // document -> binary, the nodes are already in the order of the encoding
+    std::string Document::to_binary() const
+    {
+        std::string out;
+        encode(out);
+        return out;
+    }
+
+    void Document::encode(std::string& out) const
+    {
+        out += Decoder::Magic;
+        for (const Node& n : nodes)
+        {
+            switch (n.type)
+            {
+            case Node_Literal:
+                putHead(out, n.length, Binary_Literal);
+                out += literal(n);
+                break;
+            case Node_List:
+                putHead(out, n.length, Binary_List);
+                break;
+            case Node_Integer:
+                putInteger(out, std::int64_t(n.offset));
+                break;
+            case Node_Float:
+                putFloat(out, Number::fromBits(n.offset));
+                break;
+            default:
+                putHead(out, 0, Binary_Error);
+            }
+        }
+    }
+
+    // binary -> events
+    bool Decoder::detect(std::string_view src)
+    {
+        return src.substr(0, Magic.size()) == Magic;
+    }
+
+    void Decoder::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool Decoder::varint(std::uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= src.size())
+                return false;
+            std::uint8_t byte = src[pos++];
+            // only the lowest bit of the 10th byte is left of the 64, and it must be the last one
+            if (shift == 63 && byte > 1)
+                return false;
+            value |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool Decoder::element(Handler& handler)
+    {
+        // children left of the open lists
+        std::vector<std::uint64_t> open;
+        while (true)
+        {
+            std::uint64_t head;
+            if (!varint(head))
+                return false;
+            std::uint64_t count = head >> 2;
+            if (!open.empty())
+                open.back()--;
+            switch (head & 3)
+            {
+            case Binary_Literal:
+                if (count > src.size() - pos)
+                    return false;
+                handler.on_literal(src.substr(pos, count));
+                pos += count;
+                break;
+            case Binary_List:
+                // every child is one byte at least, so a bigger count is broken for sure
+                if (count > src.size() - pos || open.size() >= maxDepth)
+                    return false;
+                handler.on_list_begin();
+                open.push_back(count);
+                break;
+            case Binary_Number:
+                if (count == 0)
+                {
+                    std::uint64_t zigzag;
+                    if (!varint(zigzag))
+                        return false;
+                    handler.on_integer(std::int64_t(zigzag >> 1 ^ -(zigzag & 1)));
+                }
+                else if (count == 1 && src.size() - pos >= 8)
+                {
+                    std::uint64_t bits = 0;
+                    for (int i = 7; i >= 0; i--)
+                        bits = bits << 8 | std::uint8_t(src[pos + i]);
+                    pos += 8;
+                    handler.on_float(Number::fromBits(bits));
+                }
+                else
+                    return false;
+                break;
+            case Binary_Error:
+            default:
+                // an error node: the tree was broken when it was encoded, parse reports it with on_error
+                return false;
+            }
+            for (; !open.empty() && open.back() == 0; open.pop_back())
+                handler.on_list_end();
+            if (open.empty())
+                return true;
+        }
+    }
+
+    bool Decoder::parse(std::string_view _src, Handler& handler)
+    {
+        src = _src;
+        pos = Magic.size();
+        if (!detect(src) || !element(handler))
+        {
+            handler.on_error();
+            return false;
+        }
+        handler.on_element_end();
+        return true;
+    }
+
+    Object Decoder::parse(std::string_view src)
+    {
+        ObjectBuilder builder;
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Decoder::parseDocument(std::string_view src, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(src);
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Decoder::parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        // a file that could not be opened is a broken document
+        if (!source)
+        {
+            builder.on_error();
+            return builder.take();
+        }
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(source->view(), source);
+        parse(source->view(), builder);
+        return builder.take();
+    }
+
+    // cursor
+    Cursor::Cursor(std::string_view _src)
+        : src(_src)
+    {
+        pos = element(0);
+    }
+
+    Cursor::Cursor(std::string_view _src, std::size_t _pos)
+        : src(_src), pos(_pos)
+    {}
+
+    std::size_t Cursor::element(std::size_t from) const
+    {
+        while (from < src.length())
+        {
+            char c = src[from];
+            if (c == '(' || c == '\'' || c == '-' || (c >= '0' && c <= '9'))
+                return from;
+            if (c != ' ' && c != '\t' && c != '\n')
+                return std::string_view::npos;
+            ++from;
+        }
+        return std::string_view::npos;
+    }
+
+    std::size_t Cursor::skip(std::size_t from) const
+    {
+        if (src[from] == '\'')
+        {
+            std::size_t end = src.find('\'', from + 1);
+            return end == std::string_view::npos ? src.length() : end + 1;
+        }
+        if (src[from] != '(')
+        {
+            // a number runs until a structural symbol or a whitespace
+            std::size_t end = src.find_first_of("()' \t\n", from);
+            return end == std::string_view::npos ? src.length() : end;
+        }
+        // a list: the parens are counted a block at a time, the ones in literals don't count
+        std::size_t depth = 0;
+        bool inside = false;
+        for (std::size_t block = from - from % Scanner::BlockSize; block < src.length(); block += Scanner::BlockSize)
+        {
+            BlockMasks m = Scanner::classify(src.data() + block,
+                                             std::min(Scanner::BlockSize, src.length() - block));
+            if (block < from)
+            {
+                std::uint64_t after = ~std::uint64_t(0) << (from - block);
+                m.quote &= after;
+                m.leftParen &= after;
+                m.rightParen &= after;
+            }
+            std::uint64_t outside = ~Scanner::literalMask(m.quote, inside);
+            std::uint64_t left = m.leftParen & outside;
+            std::uint64_t parens = left | (m.rightParen & outside);
+            while (parens != 0)
+            {
+                int bit = __builtin_ctzll(parens);
+                if ((left >> bit) & 1)
+                    depth++;
+                else if (--depth == 0)
+                    return block + bit + 1;
+                parens &= parens - 1;
+            }
+        }
+        return src.length();
+    }
+
+    bool Cursor::valid() const
+    {
+        return pos < src.length();
+    }
+
+    bool Cursor::isList() const
+    {
+        return valid() && src[pos] == '(';
+    }
+
+    NumberType Cursor::number(std::int64_t& integer, double& floating) const
+    {
+        if (!valid() || src[pos] == '(' || src[pos] == '\'')
+            return Number_None;
+        return Number::parse(raw(), integer, floating);
+    }
+
+    bool Cursor::isLiteral() const
+    {
+        std::int64_t integer;
+        double floating;
+        return valid() && (src[pos] == '\'' || number(integer, floating) == Number_Large);
+    }
+
+    bool Cursor::isNumber() const
+    {
+        std::int64_t integer;
+        double floating;
+        NumberType type = number(integer, floating);
+        return type == Number_Integer || type == Number_Float;
+    }
+
+    Cursor Cursor::child(std::size_t i) const
+    {
+        if (!isList())
+            return Cursor();
+        Cursor c(src, element(pos + 1));
+        for (; c.valid() && i > 0; i--)
+            c = c.next_sibling();
+        return c;
+    }
+
+    Cursor Cursor::next_sibling() const
+    {
+        if (!valid())
+            return Cursor();
+        // a closing paren (or anything else) after the element means there is no sibling
+        return Cursor(src, element(skip(pos)));
+    }
+
+    std::size_t Cursor::size() const
+    {
+        std::size_t n = 0;
+        for (Cursor c = child(0); c.valid(); c = c.next_sibling())
+            n++;
+        return n;
+    }
+
+    std::optional<std::string_view> Cursor::literal() const
+    {
+        // a number out of range is a literal of its text, as the parser reads it
+        if (valid() && src[pos] != '\'')
+        {
+            std::int64_t integer;
+            double floating;
+            if (number(integer, floating) == Number_Large)
+                return {raw()};
+            return {};
+        }
+        std::size_t end = src.find('\'', pos + 1);
+        if (end == std::string_view::npos)
+            return {};
+        return {src.substr(pos + 1, end - pos - 1)};
+    }
+
+    std::optional<std::string> Cursor::expectLiteralData() const
+    {
+        std::optional<std::string_view> body = literal();
+        if (!body)
+            return {};
+        std::string buffer;
+        return {std::string(Lexer::fold(*body, buffer))};
+    }
+
+    std::optional<std::int64_t> Cursor::expectInteger() const
+    {
+        std::int64_t integer;
+        double floating;
+        if (number(integer, floating) != Number_Integer)
+            return {};
+        return {integer};
+    }
+
+    std::optional<double> Cursor::expectFloat() const
+    {
+        std::int64_t integer;
+        double floating;
+        switch (number(integer, floating))
+        {
+        case Number_Integer:
+            return {double(integer)};
+        case Number_Float:
+            return {floating};
+        default:
+            return {};
+        }
+    }
+
+    std::string_view Cursor::raw() const
+    {
+        if (!valid())
+            return {};
+        return src.substr(pos, skip(pos) - pos);
+    }
+
+    // trace
+    void Trace::reset()
+    {
+        metrics = Metrics();
+    }
+
+#ifdef LISON_TRACE
+    // stage timer
+    StageTimer::StageTimer(Trace* _trace, Stage _stage, std::uint64_t _bytes)
+        : trace(_trace), stage(_stage), bytes(_bytes)
+    {
+        if (trace == nullptr)
+            return;
+        startAllocations = Allocations::stats();
+        start = std::chrono::steady_clock::now();
+    }
+
+    StageTimer::~StageTimer()
+    {
+        stop();
+    }
+
+    void StageTimer::add_bytes(std::uint64_t n)
+    {
+        bytes += n;
+    }
+
+    void StageTimer::exclude(std::uint64_t ns)
+    {
+        excluded += ns;
+    }
+
+    void StageTimer::stop()
+    {
+        if (trace == nullptr || !running)
+            return;
+        running = false;
+        std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        ns -= std::min(ns, excluded);
+        StageMetrics& m = trace->metrics.stages[stage];
+        m.calls++;
+        m.ns += ns;
+        m.bytes += bytes;
+        AllocationStats now = Allocations::stats();
+        m.allocations += now.allocations - startAllocations.allocations;
+        m.allocatedBytes += now.allocatedBytes - startAllocations.allocatedBytes;
+        trace->on_stage(stage, ns, bytes);
+    }
+
+    // counting handler
+    TraceHandler::TraceHandler(Handler& _handler, Trace* _trace)
+        : handler(_handler), trace(_trace)
+    {}
+
+    void TraceHandler::on_list_begin()
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        m.maxDepth = std::max(m.maxDepth, ++depth);
+        handler.on_list_begin();
+    }
+
+    void TraceHandler::on_list_end()
+    {
+        trace->metrics.symbols++;
+        depth--;
+        handler.on_list_end();
+    }
+
+    void TraceHandler::on_literal(std::string_view value)
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        m.literalBytes += value.size();
+        handler.on_literal(value);
+    }
+
+    void TraceHandler::on_integer(std::int64_t value)
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        handler.on_integer(value);
+    }
+
+    void TraceHandler::on_float(double value)
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        handler.on_float(value);
+    }
+
+    void TraceHandler::on_element_end()
+    {
+        handler.on_element_end();
+    }
+
+    void TraceHandler::on_error()
+    {
+        depth = 0;
+        handler.on_error();
+    }
+#endif
+
+    // lison
+    void LiSON::set_trace(Trace* _trace)
+    {
+        trace = _trace;
+    }
+
+    void LiSON::deserialize(const std::string& src)
+    {
+        ObjectBuilder builder;
+        Handler* handler = &builder;
+#ifdef LISON_TRACE
+        TraceHandler counter(builder, trace);
+        if (trace != nullptr)
+            handler = &counter;
+        StageTimer parsing(trace, Stage_Parse, src.size());
+#endif
+        Parser parser;
+        parser.parse(std::string_view(src), *handler);
+#ifdef LISON_TRACE
+        parsing.stop();
+        StageTimer interpreting(trace, Stage_Interpret);
+#endif
+        interpret(builder.take());
+    }
+
+    void LiSON::deserialize(const Serializer& serializer)
+    {
+        ObjectBuilder builder;
+        Handler* handler = &builder;
+#ifdef LISON_TRACE
+        TraceHandler counter(builder, trace);
+        if (trace != nullptr)
+            handler = &counter;
+        StageTimer reading(trace, Stage_Read);
+#endif
+        // the file is parsed in place, whether it is mapped or read into a buffer
+        std::shared_ptr<const SourceBuffer> source = serializer.map();
+#ifdef LISON_TRACE
+        std::uint64_t size = source ? source->view().size() : 0;
+        reading.add_bytes(size);
+        reading.stop();
+        StageTimer parsing(trace, Stage_Parse, size);
+#endif
+        if (source && Decoder::detect(source->view()))
+        {
+            Decoder decoder;
+            decoder.parse(source->view(), *handler);
+        }
+        else if (source)
+        {
+            Parser parser;
+            parser.parse(source->view(), *handler);
+        }
+        else
+            handler->on_error();
+#ifdef LISON_TRACE
+        parsing.stop();
+        StageTimer interpreting(trace, Stage_Interpret);
+#endif
+        interpret(builder.take());
+    }
+
+    Object LiSON::emitted() const
+    {
+        ObjectBuilder builder;
+        emit(builder);
+        return builder.take();
+    }
+
+    void LiSON::emit(Writer& writer) const
+    {
+#ifdef LISON_TRACE
+        StageTimer reverting(trace, Stage_Revert);
+        Object obj = revert();
+        reverting.stop();
+        obj.write(writer);
+#else
+        revert().write(writer);
+#endif
+    }
+
+    void LiSON::write(Writer& writer) const
+    {
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+        std::uint64_t reverted = trace != nullptr ? trace->metrics.stages[Stage_Revert].ns : 0;
+        emit(writer);
+        if (trace != nullptr)
+            writing.exclude(trace->metrics.stages[Stage_Revert].ns - reverted);
+#else
+        emit(writer);
+#endif
+    }
+
+    std::string LiSON::serialize() const
+    {
+        std::string out;
+        StringWriter writer(out);
+        write(writer);
+        return out;
+    }
+
+    void LiSON::serialize(std::ostream& out, WriteMode mode) const
+    {
+        StreamWriter writer(out, mode);
+        write(writer);
+    }
+
+    void LiSON::serialize(Writer& writer) const
+    {
+        write(writer);
+    }
+
+    // wstring <-> lison
+    LiSON& operator >>(const std::string& src, LiSON& lison)
+    {
+        lison.deserialize(src);
+        return lison;
+    }
+
+    std::string& operator <<(std::string& res, const LiSON& lison)
+    {
+        res =  lison.serialize();
+        return res;
+    }
+
+    // serializer <-> lison
+    LiSON& operator >>(const Serializer& serializer, LiSON& lison)
+    {
+        lison.deserialize(serializer);
+        return lison;
+    }
+
+    const Serializer& operator <<(const Serializer& serializer, const LiSON& lison)
+    {
+        serializer.write(lison);
+        return serializer;
+    }
+
+    // wstring -> serializer
+    Serializer& operator >>(const std::string& filename, Serializer& serializer)
+    {
+        serializer.set_file(filename);
+        return serializer;
+    }
+
+    // serializer
+    // source buffer
+    SourceBuffer::~SourceBuffer()
+    {
+#ifdef LISON_MMAP
+        if (mapped)
+            munmap(const_cast<char*>(data), length);
+#endif
+    }
+
+    std::shared_ptr<const SourceBuffer> SourceBuffer::open(const std::string& filename, SourceMode mode)
+    {
+        auto source = std::make_shared<SourceBuffer>();
+#ifdef LISON_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                madvise(addr, st.st_size, mode == Source_Text ? MADV_SEQUENTIAL : MADV_RANDOM);
+                source->data = static_cast<const char*>(addr);
+                source->length = st.st_size;
+                source->mapped = true;
+                close(fd);
+                return source;
+            }
+        }
+        // not a regular file (a pipe, a device): read it from the same descriptor, it can't be opened twice
+        std::vector<char> chunk(64 * 1024);
+        for (;;)
+        {
+            ssize_t n = ::read(fd, chunk.data(), chunk.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                close(fd);
+                return nullptr;
+            }
+            if (n == 0)
+                break;
+            source->buffer.append(chunk.data(), n);
+        }
+        close(fd);
+#else
+        // no mmap: read it in one pass (it may be a pipe), in binary, so the bytes of a binary
+        // encoded file are never converted
+        std::ifstream file;
+        file.open(filename,std::ios_base::in | std::ios_base::binary);
+        if (!file.is_open())
+            return nullptr;
+        std::vector<char> chunk(64 * 1024);
+        while (file)
+        {
+            file.read(chunk.data(), chunk.size());
+            source->buffer.append(chunk.data(), file.gcount());
+        }
+#ifdef _WIN32
+        // the line ends of a text file as the text mode would read them
+        if (mode == Source_Text && !Decoder::detect(source->buffer))
+        {
+            std::string& text = source->buffer;
+            std::size_t out = 0;
+            for (std::size_t i = 0; i < text.size(); i++)
+                if (text[i] != '\r' || i + 1 == text.size() || text[i + 1] != '\n')
+                    text[out++] = text[i];
+            text.resize(out);
+        }
+#endif
+#endif
+        source->data = source->buffer.data();
+        source->length = source->buffer.length();
+        return source;
+    }
+
+    std::string_view SourceBuffer::view() const
+    {
+        return std::string_view(data, length);
+    }
+
+    bool SourceBuffer::isMapped() const
+    {
+        return mapped;
+    }
+
+    // serializer
+    Serializer::Serializer(const std::string& _filename)
+        :filename(_filename)
+    {}
+
+    void Serializer::set_file(const std::string& _filename)
+    {
+        this->filename = _filename;
+    }
+
+    void Serializer::set_trace(Trace* _trace)
+    {
+        trace = _trace;
+    }
+
+    std::string Serializer::read() const
+    {
+        if (filename.empty())
+            return "";
+        std::shared_ptr<const SourceBuffer> source = map();
+        if (!source)
+            return "";
+        return std::string(source->view());
+    }
+
+    std::shared_ptr<const SourceBuffer> Serializer::map() const
+    {
+        if (filename.empty())
+            return nullptr;
+#ifdef LISON_TRACE
+        StageTimer reading(trace, Stage_Read);
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::open(filename);
+        reading.add_bytes(source ? source->view().size() : 0);
+        return source;
+#else
+        return SourceBuffer::open(filename);
+#endif
+    }
+
+    void Serializer::write(const std::string& source) const
+    {
+        if (filename.empty())
+            return;
+        std::ofstream file;
+        file.open(filename,std::ios_base::out);
+        if (!file.is_open())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write, source.size());
+#endif
+        file << source;
+        file.close();
+    }
+
+    void Serializer::write(const Object& obj, WriteMode mode) const
+    {
+        if (filename.empty())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        // big lists are written on all the cores, anything else straight into the file
+        ParallelWriter writer;
+        writer.write(obj, filename, mode);
+    }
+
+    void Serializer::write(const LiSON& lison, WriteMode mode) const
+    {
+        FileWriter writer(filename, mode);
+        if (!writer.is_open())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        lison.serialize(writer);
+    }
+
+    void Serializer::encode(const Object& obj) const
+    {
+        if (filename.empty())
+            return;
+        std::ofstream file;
+        file.open(filename,std::ios_base::out | std::ios_base::binary);
+        if (!file.is_open())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        file << obj.to_binary();
+        file.close();
+    }
 
-    // tokenizer
-    std::list<Tokenizer::SymbolObject> Tokenizer::tokenize(const std::string& src)
+    void Serializer::snapshot(const Document& doc) const
     {
-        std::list<SymbolObject> symbolStream;
-        for (unsigned i=0;i<src.length();i++)
+        if (filename.empty())
+            return;
+        std::ofstream file;
+        file.open(filename,std::ios_base::out | std::ios_base::binary);
+        if (!file.is_open())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        file << doc.to_snapshot();
+        file.close();
+    }
+
+    bool Serializer::read(Handler& handler, std::size_t chunkSize) const
+    {
+        Handler* target = &handler;
+#ifdef LISON_TRACE
+        // reading and parsing are done together here
+        TraceHandler counter(handler, trace);
+        if (trace != nullptr)
+            target = &counter;
+        StageTimer parsing(trace, Stage_Parse);
+#endif
+        PushParser parser(*target);
+        std::ifstream file;
+        if (!filename.empty())
+            file.open(filename,std::ios_base::in);
+        if (!file.is_open())
         {
-            char c = src[i];
-            SymbolObject sym;
-            if (c == '\'')
-                sym.sym = Sym_Quote;
-            else if (c == '(')
-                sym.sym = Sym_LeftParen;
-            else if (c == ')')
-                sym.sym = Sym_RightParen;
-            else if (c == '\t' || c == '\n' || c == ' ')
-            {
-                sym.sym = Sym_Whitespace;
-            }
-            else
+            target->on_error();
+            return false;
+        }
+        // the parsing goes on while the file is read, only one chunk is in memory
+        std::vector<char> chunk(chunkSize > Decoder::Magic.size() ? chunkSize : Decoder::Magic.size());
+        bool first = true;
+        while (file)
+        {
+            file.read(chunk.data(), chunk.size());
+            std::string_view part(chunk.data(), file.gcount());
+#ifdef LISON_TRACE
+            parsing.add_bytes(part.size());
+#endif
+            // the binary encoding is decoded in one piece
+            if (first && Decoder::detect(part))
             {
-                sym.sym = Sym_Character;
-                sym.character = c;
+                file.close();
+                Decoder decoder;
+#ifdef LISON_TRACE
+                // map times the reading itself, it is not a part of the parsing
+                std::uint64_t read = trace != nullptr ? trace->metrics.stages[Stage_Read].ns : 0;
+#endif
+                std::shared_ptr<const SourceBuffer> source = map();
+#ifdef LISON_TRACE
+                if (trace != nullptr)
+                    parsing.exclude(trace->metrics.stages[Stage_Read].ns - read);
+                if (source)
+                    parsing.add_bytes(source->view().size() - part.size());
+#endif
+                // the source buffer reads an encoded file without any newline conversion
+                if (!source)
+                {
+                    target->on_error();
+                    return false;
+                }
+                return decoder.parse(source->view(), *target);
             }
-            symbolStream.push_back(sym);
+            first = false;
+            if (!parser.feed(part))
+                return false;
         }
-        return symbolStream;
+        return parser.finish();
     }
 
-    // parser
-    bool Parser::accept(Tokenizer::Symbol req)
+    // snapshot
+    // start of the file, the node table follows right after it
+    struct SnapshotHeader
+    {
+        char magic[4];
+        std::uint16_t version;
+        // the table is only usable with the same layout and byte order
+        std::uint16_t nodeSize;
+        std::uint32_t order;
+        std::uint32_t reserved;
+        std::uint64_t count;
+        std::uint64_t poolSize;
+    };
+
+    static_assert(sizeof(SnapshotHeader) % alignof(Node) == 0, "the node table must stay aligned");
+
+    // document -> snapshot
+    std::string Document::to_snapshot() const
     {
-        if (iter->sym == req)
+        // the file has to stand on its own, so the borrowed and interned literals go to the pool
+        if (borrowed() || symbolTable)
         {
-            ++iter;
-            return true;
+            Document copy = *this;
+            copy.materialize();
+            return copy.to_snapshot();
         }
-        return false;
+        SnapshotHeader header{};
+        std::memcpy(header.magic, Snapshot::Magic.data(), Snapshot::Magic.size());
+        header.version = Snapshot::Version;
+        header.nodeSize = sizeof(Node);
+        header.order = 1;
+        header.count = nodes.size();
+        header.poolSize = pool.size();
+
+        std::string out;
+        out.reserve(sizeof(header) + nodes.size() * sizeof(Node) + pool.size());
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(Node));
+        out += pool;
+        return out;
     }
 
-    char Parser::character()
+    // snapshot
+    Snapshot Snapshot::open(const std::string& filename)
     {
-        if (iter->sym == Tokenizer::Sym_Character)
-        {
-            char c =  iter->character;
-            ++iter;
-            return c;
-        }
-        else
-            return 0;
+        return load(SourceBuffer::open(filename, Source_Binary));
+    }
+
+    Snapshot Snapshot::load(std::shared_ptr<const SourceBuffer> source)
+    {
+        Snapshot snap;
+        if (!source)
+            return snap;
+        std::string_view data = source->view();
+        SnapshotHeader header;
+        if (data.size() < sizeof(header))
+            return snap;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::string_view(header.magic, sizeof(header.magic)) != Magic || header.version != Version
+            || header.nodeSize != sizeof(Node) || header.order != 1)
+            return snap;
+        // only the sizes are checked, the nodes are checked when they are looked up
+        std::size_t rest = data.size() - sizeof(header);
+        if (header.count > std::numeric_limits<std::uint32_t>::max() || header.count > rest / sizeof(Node)
+            || header.poolSize != rest - header.count * sizeof(Node))
+            return snap;
+        // the table is used in place, so it has to be aligned like in memory
+        const char* table = data.data() + sizeof(header);
+        if (reinterpret_cast<std::uintptr_t>(table) % alignof(Node) != 0)
+            return snap;
+        snap.owner = source;
+        snap.nodes = reinterpret_cast<const Node*>(table);
+        snap.count = header.count;
+        snap.pool = data.substr(sizeof(header) + header.count * sizeof(Node));
+        return snap;
+    }
+
+    bool Snapshot::valid() const
+    {
+        return owner != nullptr;
+    }
+
+    SnapshotView Snapshot::root() const
+    {
+        return SnapshotView(this, 0);
+    }
+
+    std::size_t Snapshot::size() const
+    {
+        return count;
+    }
+
+    std::string Snapshot::to_string(WriteMode mode) const
+    {
+        return root().to_string(mode);
+    }
+
+    std::optional<std::string_view> Snapshot::literal(std::uint32_t index) const
+    {
+        const Node& n = nodes[index];
+        if (n.offset > pool.size() || n.length > pool.size() - n.offset)
+            return {};
+        return {pool.substr(n.offset, n.length)};
     }
 
-    Object Parser::literal()
+    void Snapshot::write(std::uint32_t index, Writer& writer) const
     {
-        if (accept(Tokenizer::Sym_Quote))
+        // ends of the lists that are still open
+        std::vector<std::uint32_t> open;
+        std::uint32_t to = std::min(nodes[index].next, count);
+        for (std::uint32_t i = index; i < to; i++)
         {
-            std::stringstream ss;
-            char c;
-            bool whitespace;
-            bool loop = true;
-            while (loop)
+            for (; !open.empty() && open.back() <= i; open.pop_back())
+                writer.end_list();
+            std::optional<std::string_view> value;
+            switch (nodes[i].type)
             {
-                whitespace = accept(Tokenizer::Sym_Whitespace);
-                if (whitespace)
-                {
-                    ss << ' ';
-                    continue;
-                }
-                c = character();
-                if (c != 0)
-                    ss << c;
-                loop = c != 0 || whitespace;
-            }
-            if (accept(Tokenizer::Sym_Quote))
-            {
-				Object o(Token{Tkn_Literal{ss.str()}});
-                return o;
+            case Node_Literal:
+                value = literal(i);
+                if (value)
+                    writer.literal(*value);
+                else
+                    writer.error();
+                break;
+            case Node_List:
+                writer.begin_list();
+                open.push_back(nodes[i].next);
+                break;
+            case Node_Integer:
+                writer.integer(std::int64_t(nodes[i].offset));
+                break;
+            case Node_Float:
+                writer.floating(Number::fromBits(nodes[i].offset));
+                break;
+            default:
+                writer.error();
             }
         }
-        Object o(Token{Tkn_Error{}});
-        return o;
+        for (; !open.empty(); open.pop_back())
+            writer.end_list();
     }
 
-	/*
-	  Object => [LeftParen] -> [String | [Whitespace -> Object] -> [RightParen]
-	            |------------------------|
-	 */
+    // view
+    SnapshotView::SnapshotView(const Snapshot* _snap, std::uint32_t _index)
+        : snap(_snap), index(_index)
+    {}
 
-    Object Parser::object()
+    bool SnapshotView::valid() const
     {
-		Object o(Token{Tkn_Object{}});
-		auto& token = std::get<Tkn_Object>(o.token);
-		// yank the whitespaces
-        while (accept(Tokenizer::Sym_Whitespace));
+        return snap != nullptr && index < snap->count;
+    }
 
-		// outer if: looks for left paren, that means a new Object object
-        if (accept(Tokenizer::Sym_LeftParen))
-        {
-            // yank the whitespaces
-            while (accept(Tokenizer::Sym_Whitespace));
+    NodeType SnapshotView::type() const
+    {
+        if (!valid())
+            return Node_Error;
+        return snap->nodes[index].type;
+    }
 
-			// if it's an empty object, we return
-            if (accept(Tokenizer::Sym_RightParen))
-                return o;
-			// the object has some contents
-            else 
-            {
-				// get the first object in the object
-				// at this point there must be at least one
-                Object first_obj = object();
+    std::size_t SnapshotView::size() const
+    {
+        if (type() != Node_List)
+            return 0;
+        return snap->nodes[index].length;
+    }
 
-				// put them object in with a visitor
-				if (std::holds_alternative<Tkn_Error>(first_obj.token))
-				{
-					o = Object(Token{Tkn_Error{}});
-					return o;
-				}
+    SnapshotView SnapshotView::child(std::size_t i) const
+    {
+        if (i >= size())
+            return SnapshotView();
+        std::uint32_t end = snap->nodes[index].next;
+        std::uint32_t c = index + 1;
+        for (; i > 0 && c < end && c < snap->count && snap->nodes[c].next > c; i--)
+            c = snap->nodes[c].next;
+        if (i > 0 || c >= end)
+            return SnapshotView();
+        return SnapshotView(snap, c);
+    }
 
-				token.value.push_back(first_obj);
+    SnapshotView SnapshotView::parent() const
+    {
+        if (!valid())
+            return SnapshotView();
+        return SnapshotView(snap, snap->nodes[index].parent);
+    }
 
-                // optional objects
-                bool list = true;
-                while (list)
-                {
-                    if (!accept(Tokenizer::Sym_Whitespace))
-                    {
-                        if (accept(Tokenizer::Sym_RightParen))
-						{
-							list = false;
-							break;
-						}
-                    }
-                    if (accept(Tokenizer::Sym_RightParen))
-                    {
-                        list = false;
-                        break;
-                    }
+    std::string SnapshotView::to_string(WriteMode mode) const
+    {
+        std::string out;
+        StringWriter writer(out, mode);
+        if (valid())
+            snap->write(index, writer);
+        return out;
+    }
 
-					if (iter == endIter)
-					{
-						o = Object(Token{Tkn_Error{}});
-						list = false;
-						break;
-					}
-                    Object list_obj = object();
-					token.value.push_back(list_obj);
-                }
-            }
-        }
-		// outer else:
-		// happens if the object doesn't start with a left paren -> it's a literal (or later something else)
-        else
-        {
-			// we try with the literal
-            Object tmp = literal();
-			if (!std::holds_alternative<Tkn_Error>(tmp.token))
-			{
-				auto v = std::get<Tkn_Literal>(tmp.token);
-				o = tmp;
-			}
-			// else try with integer, float and other types
-        }
-		return o;
+    Object SnapshotView::toObject() const
+    {
+        if (!valid())
+            return Object(Token{Tkn_Error{}});
+        ObjectBuilder builder;
+        snap->write(index, builder);
+        return builder.take();
     }
 
-    Object Parser::parse(std::list<Tokenizer::SymbolObject> symbolStream)
+    void SnapshotView::foreachObjectData(
+        std::function<void(const SnapshotView&)> f) const
     {
-        iter = symbolStream.begin();
-		endIter = symbolStream.end();
-        return object();
+        visitObjectData(f);
     }
 
-    // lison
-    void LiSON::deserialize(const std::string& src)
+    std::optional<std::string_view> SnapshotView::expectLiteralData() const
     {
-        Tokenizer tokenizer;
-        Parser parser;
-        std::list<Tokenizer::SymbolObject> symbolStream = tokenizer.tokenize(src);
-        Object o = parser.parse(symbolStream);
-        interpret(o);
+        if (type() != Node_Literal)
+            return {};
+        return snap->literal(index);
     }
 
-    std::string LiSON::serialize() const
+    std::optional<std::int64_t> SnapshotView::expectInteger() const
     {
-        return revert().to_string();
+        if (type() != Node_Integer)
+            return {};
+        return {std::int64_t(snap->nodes[index].offset)};
     }
 
-    // wstring <-> lison
-    LiSON& operator >>(const std::string& src, LiSON& lison)
+    std::optional<double> SnapshotView::expectFloat() const
     {
-        lison.deserialize(src);
-        return lison;
+        if (type() == Node_Float)
+            return {Number::fromBits(snap->nodes[index].offset)};
+        if (type() == Node_Integer)
+            return {double(std::int64_t(snap->nodes[index].offset))};
+        return {};
     }
 
-    std::string& operator <<(std::string& res, const LiSON& lison)
+    // lines
+    // reader
+    LinesReader::LinesReader(std::istream& _in)
+        : in(_in)
+    {}
+
+    bool LinesReader::line(std::string& out)
     {
-        res =  lison.serialize();
-        return res;
+        while (std::getline(in, out))
+        {
+            number++;
+            // the line ends of a file from windows
+            if (!out.empty() && out.back() == '\r')
+                out.pop_back();
+            for (char c : out)
+                if (Tokenizer::classify(c) != Tokenizer::Sym_Whitespace)
+                    return true;
+        }
+        return false;
     }
 
-    // serializer <-> lison
-    LiSON& operator >>(const Serializer& serializer, LiSON& lison)
+    std::size_t LinesReader::line() const
     {
-        lison.deserialize(serializer.read());
-        return lison;
+        return number;
     }
 
-    const Serializer& operator <<(const Serializer& serializer, const LiSON& lison)
+    bool LinesReader::next(Object& obj)
     {
-        serializer.write(lison.serialize());
-        return serializer;
+        std::string text;
+        if (!line(text))
+            return false;
+        Parser parser;
+        obj = parser.parse(std::string_view(text));
+        return true;
     }
 
-    // wstring -> serializer
-    Serializer& operator >>(const std::string& filename, Serializer& serializer)
+    bool LinesReader::next(LiSON& lison)
     {
-        serializer.set_file(filename);
-        return serializer;
+        std::string text;
+        if (!line(text))
+            return false;
+        lison.deserialize(text);
+        return true;
     }
 
-    // serializer
-    Serializer::Serializer(const std::string& _filename)
-        :filename(_filename)
+    std::size_t LinesReader::forEach(std::function<void(std::size_t line, Object&& obj)> f,
+                                     unsigned threads, bool ordered)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        // lines that are parsed together, and their documents
+        struct Batch
+        {
+            std::vector<std::string> lines;
+            std::vector<std::size_t> numbers;
+            std::vector<Object> docs;
+            bool done = false;
+        };
+        auto parse = [](Batch& batch)
+        {
+            Parser parser;
+            batch.docs.reserve(batch.lines.size());
+            for (std::string& text : batch.lines)
+            {
+                batch.docs.push_back(parser.parse(std::string_view(text)));
+                std::string().swap(text);
+            }
+        };
+        std::mutex deliver;
+        auto pass = [&f, &deliver](Batch& batch)
+        {
+            std::lock_guard<std::mutex> lock(deliver);
+            for (std::size_t i = 0; i < batch.docs.size(); i++)
+                f(batch.numbers[i], std::move(batch.docs[i]));
+        };
+        auto read = [this](Batch& batch)
+        {
+            std::size_t size = 0;
+            std::string text;
+            while (batch.lines.size() < BatchLines && size < BatchSize && line(text))
+            {
+                size += text.size();
+                batch.numbers.push_back(number);
+                batch.lines.push_back(std::move(text));
+            }
+            return !batch.lines.empty();
+        };
+
+        std::size_t count = 0;
+        if (threads == 1)
+        {
+            for (Batch batch; read(batch); batch = Batch())
+            {
+                count += batch.lines.size();
+                parse(batch);
+                pass(batch);
+            }
+            return count;
+        }
+
+        // the batches that were read and are not passed on yet, at most two per thread
+        std::deque<std::unique_ptr<Batch>> flight;
+        std::deque<Batch*> pending;
+        std::mutex mutex;
+        std::condition_variable work;
+        std::condition_variable finished;
+        bool stop = false;
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; i++)
+        {
+            workers.emplace_back([&]()
+            {
+                while (true)
+                {
+                    Batch* batch;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        work.wait(lock, [&]() { return stop || !pending.empty(); });
+                        if (pending.empty())
+                            return;
+                        batch = pending.front();
+                        pending.pop_front();
+                    }
+                    parse(*batch);
+                    if (!ordered)
+                        pass(*batch);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        batch->done = true;
+                    }
+                    finished.notify_all();
+                }
+            });
+        }
+
+        // passes on the batches that are done (in order: only from the front), the unordered ones
+        // were passed on by the workers already, so they are only dropped
+        auto drain = [&](bool wait)
+        {
+            auto ready = [&]()
+            {
+                if (ordered)
+                    return flight.front()->done ? flight.begin() : flight.end();
+                return std::find_if(flight.begin(), flight.end(),
+                                    [](const std::unique_ptr<Batch>& b) { return b->done; });
+            };
+            while (!flight.empty())
+            {
+                std::unique_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    auto it = ready();
+                    if (it == flight.end() && wait)
+                        finished.wait(lock, [&]() { return (it = ready()) != flight.end(); });
+                    if (it == flight.end())
+                        return;
+                    batch = std::move(*it);
+                    flight.erase(it);
+                }
+                if (ordered)
+                    pass(*batch);
+                wait = false;
+            }
+        };
+        while (true)
+        {
+            auto batch = std::make_unique<Batch>();
+            if (!read(*batch))
+                break;
+            count += batch->lines.size();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back(batch.get());
+                flight.push_back(std::move(batch));
+            }
+            work.notify_one();
+            drain(false);
+            // bounded memory: the reading waits for the oldest batch
+            if (flight.size() >= 2 * threads)
+                drain(true);
+        }
+        while (!flight.empty())
+            drain(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        work.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        return count;
+    }
+
+    // writer
+    LinesWriter::LinesWriter(std::ostream& _stream)
+        : StreamWriter(_stream, Write_Compact)
     {}
 
-    void Serializer::set_file(const std::string& _filename)
+    void LinesWriter::literal(std::string_view value)
     {
-        this->filename = _filename;
+        if (value.find('\n') == std::string_view::npos)
+        {
+            StreamWriter::literal(value);
+            return;
+        }
+        std::string folded(value);
+        std::replace(folded.begin(), folded.end(), '\n', ' ');
+        StreamWriter::literal(folded);
     }
 
-    std::string Serializer::read() const
+    void LinesWriter::write(const Object& obj)
     {
-        if (filename.empty())
-            return "";
-        std::ifstream file;
-        file.open(filename,std::ios_base::in);
-        if (!file.is_open())
-            return "";
-        std::stringstream ss;
-        ss << file.rdbuf();
-        file.close();
-        return ss.str();
+        obj.write(*this);
+        newline();
     }
 
-    void Serializer::write(const std::string& source) const
+    void LinesWriter::write(const LiSON& lison)
     {
-        if (filename.empty())
-            return;
-        std::ofstream file;
-        file.open(filename,std::ios_base::out);
-        if (!file.is_open())
-            return;
-        file << source;
-        file.close();
+        lison.serialize(*this);
+        newline();
     }
 }
+
+#ifdef LISON_COUNT_ALLOCATIONS
+// the nothrow and the array forms of the standard library end up in these
+void* operator new(std::size_t size)
+{
+    return lison::countedAlloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return lison::countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+// the over-aligned forms, e.g. the new_delete_resource of std::pmr uses them
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    return lison::countedAlloc(size, std::size_t(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align)
+{
+    return lison::countedAlloc(size, std::size_t(align));
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+#endif
 #define _LISON_IMPLEMENTATION
 #endif // _LISON_IMPLEMENTATION
 #endif
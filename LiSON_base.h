@@ -24,6 +24,19 @@
 #include <variant>
 #include <functional>
 #include <optional>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <tuple>
+#include <type_traits>
+#include <charconv>
+#ifdef LISON_TRACE
+#include <chrono>
+#endif
 
 /**
  * LiSON - LiSp Object Notation
@@ -33,21 +46,109 @@
  */
 namespace lison
 {
+	/**
+	 * The lists and the literals take their memory from a std::pmr::memory_resource,
+	 * so a whole tree can be parsed into e.g. a monotonic_buffer_resource and released at
+	 * once. The default resource is used if none is given, and by the copies.
+	 */
+	struct Object;
+	using ObjectList = std::pmr::list<Object>;
+
 	struct Tkn_Literal
 	{
-		std::string value;
+		std::pmr::string value;
+		Tkn_Literal() = default;
+		Tkn_Literal(std::string_view _value, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 	};
 
-	struct Object;
 	struct Tkn_Object
 	{
-		std::list<Object> value;
+		ObjectList value;
 	};
 
 	struct Tkn_Error
 	{};
 
-	using Token = std::variant<Tkn_Literal,Tkn_Object,Tkn_Error>;
+	// unquoted number literals
+	struct Tkn_Integer
+	{
+		std::int64_t value;
+	};
+
+	struct Tkn_Float
+	{
+		double value;
+	};
+
+	using Token = std::variant<Tkn_Literal,Tkn_Object,Tkn_Error,Tkn_Integer,Tkn_Float>;
+
+	enum NumberType
+	{
+		Number_None,
+		Number_Integer,
+		Number_Float,
+		// a number out of the range of both, kept as a literal of its text
+		Number_Large,
+	};
+
+	/**
+	 * Text of the unquoted number literals.
+	 * A number starts with a digit or a minus sign. It is an integer if it fits in an
+	 * std::int64_t, a float if it has a '.' or an exponent and fits in a double, and a
+	 * literal of its text otherwise, so no digit is lost (it is written back quoted, as
+	 * any literal). They are read with std::from_chars and written with
+	 * std::to_chars in the shortest form that reads back the same (a float always gets a
+	 * '.' or an exponent), so they round-trip exactly and don't depend on the locale.
+	 * The infinite and NaN floats have no number form ("inf", "nan" would not read back as
+	 * numbers), the writers write them as literals.
+	 */
+	class Number
+	{
+	public:
+		// room for the longest number, to format into
+		static constexpr std::size_t MaxLength = 32;
+
+		static NumberType parse(std::string_view text, std::int64_t& integer, double& floating);
+		// the buffer has to be MaxLength long
+		static std::string_view format(std::int64_t value, char* buffer);
+		static std::string_view format(double value, char* buffer);
+		// a float as it is stored in a Node
+		static std::uint64_t toBits(double value);
+		static double fromBits(std::uint64_t bits);
+	};
+
+	/**
+	 * Output formats of the writers.
+	 * Padded is the original one with a space after every element: ( 'a' 'b' ) 
+	 * Compact leaves only the spaces between the elements: ('a' 'b')
+	 */
+	enum WriteMode
+	{
+		Write_Padded,
+		Write_Compact,
+	};
+
+	/**
+	 * Memory taken by an Object tree or a Document, estimated from the sizes of the
+	 * containers (the bookkeeping of the allocator itself is not counted).
+	 * Every byte is either literal data or overhead of the representation, so the two
+	 * representations can be compared by bytes per node.
+	 */
+	struct MemoryReport
+	{
+		std::size_t nodes = 0;
+		std::size_t lists = 0;
+		std::size_t literals = 0;
+		// the characters of the literals
+		std::size_t literalBytes = 0;
+		// everything else: list links, variants, nodes, unused capacity
+		std::size_t containerBytes = 0;
+		// allocated on the heap, the root itself may not be
+		std::size_t heapBytes = 0;
+
+		std::size_t totalBytes() const;
+		double bytesPerNode() const;
+	};
 
 	template <class... Ts>
 	struct overload : Ts...
@@ -59,16 +160,36 @@ namespace lison
 	overload(Ts...) -> overload<Ts...>;
 
 	class LiSON;
+	class Serializer;
+	class Writer;
 	struct Object
 	{
 		Token token;
 		Object(const Token& t); 
+		Object(Token&& t);
+		// copying and destroying don't recurse, so any depth is fine
 		Object(const Object& other);
-		~Object() = default;
-		std::string to_string() const;
+		Object(Object&& other) = default;
+		Object& operator =(const Object& other);
+		Object& operator =(Object&& other) = default;
+		~Object();
+		std::string to_string(WriteMode mode = Write_Padded) const;
+
+		// the writer API, appends to a buffer or a stream in one pass
+		void write(std::string& out, WriteMode mode = Write_Padded) const;
+		void write(std::ostream& out, WriteMode mode = Write_Padded) const;
+		void write(Writer& writer) const;
+		// binary encoding, read back by the Decoder
+		std::string to_binary() const;
+		void encode(std::string& out) const;
+		// exact length of the written object, to reserve the buffer in advance
+		std::size_t serializedSize(WriteMode mode = Write_Padded) const;
+		MemoryReport memoryUsage() const;
 
 		// the factory API
 		static Object fromString(const std::string& str);
+		static Object fromInteger(std::int64_t value);
+		static Object fromFloat(double value);
 		static Object fromLiSON(const LiSON& lison);
 
 		template <class T>
@@ -79,15 +200,386 @@ namespace lison
 		// injection
 		void foreachObjectData(
 			std::function<void(const Object&)> f) const;
+		// same as foreach, but the function is inlined instead of wrapped
+		template <class F>
+		void visitObjectData(F&& f) const;
 
 		// adding
 		void add(const Object& obj);
+		void add(Object&& obj);
 
 		// maybe getting
 		std::optional<std::string> expectLiteralData() const;
+		std::optional<std::int64_t> expectInteger() const;
+		// an integer is taken as a float too
+		std::optional<double> expectFloat() const;
+		// a copy of the children, in the default resource
 		std::optional<std::list<Object>> expectObjectData() const;
+
+		// getting without copying, only valid as long as the object is alive
+		std::optional<std::string_view> expectLiteralView() const;
+		const ObjectList* expectObjectList() const;
 	};
 
+	template <class F>
+	void Object::visitObjectData(F&& f) const
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return;
+		for (const Object& it : std::get<Tkn_Object>(token).value)
+			f(it);
+	}
+
+    /**
+     * Receiver of the parser events (SAX-style API).
+     * The parser calls them in document order, without building any tree. The view of a
+     * literal's body (with the whitespaces already folded) is only valid during the call.
+     */
+    class Handler
+    {
+    public:
+        virtual ~Handler() = default;
+        virtual void on_list_begin() = 0;
+        virtual void on_list_end() = 0;
+        virtual void on_literal(std::string_view value) = 0;
+        // the numbers are reported as their text by default
+        virtual void on_integer(std::int64_t value);
+        virtual void on_float(double value);
+        // a top-level element is complete
+        virtual void on_element_end() {}
+        // the source is not valid LiSON, no more events follow
+        virtual void on_error() {}
+    };
+
+    /**
+     * Receiver of the elements to write, the mirror of the Handler.
+     * Anything can be written to it element by element, without building an Object first.
+     */
+    class Writer
+    {
+    public:
+        virtual ~Writer() = default;
+        virtual void begin_list() = 0;
+        virtual void end_list() = 0;
+        virtual void literal(std::string_view value) = 0;
+        // the numbers are written as their text by default
+        virtual void integer(std::int64_t value);
+        virtual void floating(double value);
+        // an element that could not be made (Tkn_Error)
+        virtual void error() {}
+    };
+
+    /**
+     * Writer of the LiSON text.
+     * The text goes to a buffer, that is drained to the actual output by the subclasses
+     * whenever it is over the limit.
+     */
+    class TextWriter : public Writer
+    {
+    private:
+        WriteMode mode;
+        // the last thing written was an element, so the next one needs a separator
+        bool separate = false;
+
+        void element();
+    protected:
+        std::string* out;
+        std::size_t limit;
+
+        virtual void drain() {}
+        void put(char c);
+        void put(std::string_view s);
+        // ends the line, the next element is the first one of a new document
+        void newline();
+    public:
+        TextWriter(std::string* _out, std::size_t _limit, WriteMode _mode);
+        void begin_list() override;
+        void end_list() override;
+        void literal(std::string_view value) override;
+        void integer(std::int64_t value) override;
+        void floating(double value) override;
+        void error() override;
+    };
+
+    // appends to a string
+    class StringWriter : public TextWriter
+    {
+    public:
+        StringWriter(std::string& _out, WriteMode _mode = Write_Padded);
+    };
+
+    // buffered writer of a stream
+    class StreamWriter : public TextWriter
+    {
+    private:
+        std::ostream& stream;
+        std::string buffer;
+    protected:
+        void drain() override;
+    public:
+        static constexpr std::size_t BufferSize = 64 * 1024;
+        StreamWriter(std::ostream& _stream, WriteMode _mode = Write_Padded);
+        ~StreamWriter();
+        void flush();
+    };
+
+    // buffered writer of a file
+    class FileWriter : public TextWriter
+    {
+    private:
+        std::ofstream file;
+        std::string buffer;
+    protected:
+        void drain() override;
+    public:
+        FileWriter(const std::string& filename, WriteMode _mode = Write_Padded);
+        ~FileWriter();
+        bool is_open() const;
+        void flush();
+    };
+
+    /**
+     * events -> writer, e.g. to reformat a source without a tree
+     */
+    class WriteHandler : public Handler
+    {
+    private:
+        Writer& writer;
+    public:
+        WriteHandler(Writer& _writer);
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_error() override;
+    };
+
+    /**
+     * events -> Object
+     * It takes the elements both from a parser (Handler) and from a Writer.
+     */
+    class ObjectBuilder : public Handler, public Writer
+    {
+    private:
+        Object result;
+        // the lists that are still open, the pointers stay valid in the std::list
+        std::vector<Object*> open;
+        std::pmr::memory_resource* resource;
+
+        Object& add(Token&& token);
+    public:
+        // the objects are built in the resource, it must outlive them
+        ObjectBuilder(std::pmr::memory_resource* _resource = std::pmr::get_default_resource());
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_error() override;
+        void begin_list() override;
+        void end_list() override;
+        void literal(std::string_view value) override;
+        void integer(std::int64_t value) override;
+        void floating(double value) override;
+        void error() override;
+        Object take();
+    };
+
+    /**
+     * events -> one Object for every top-level element, as soon as it is closed
+     */
+    class ObjectStream : public ObjectBuilder
+    {
+    private:
+        std::function<void(Object&&)> f;
+    public:
+        ObjectStream(std::function<void(Object&&)> _f, std::pmr::memory_resource* _resource = std::pmr::get_default_resource());
+        void on_element_end() override;
+    };
+
+    /**
+     * Flat representation of a document.
+     * The nodes are stored in one contiguous array in document order, a list is followed
+     * by its children, and every node knows its parent and the index right after its own
+     * subtree (that is where the next sibling starts, if there is one). The literals are
+     * stored back to back in one pool, the nodes only hold spans into it.
+     * Walking the array from the front to the back visits the whole document in order.
+     *
+     * In borrowed mode the literals are not copied: a node points right into the source
+     * buffer, only the literals with folded whitespaces get into the pool. Such a document
+     * needs the source to be alive (that is taken care of, if it is a SourceBuffer), or it
+     * can be materialized to own every literal.
+     */
+    enum NodeType : std::uint16_t
+    {
+        Node_Literal,
+        Node_List,
+        Node_Error,
+        // the value is in the offset, a float by its bits
+        Node_Integer,
+        Node_Float,
+    };
+
+    enum NodeFlag : std::uint16_t
+    {
+        Node_Borrowed = 1,      // the literal is in the source, not in the pool
+        Node_Interned = 2,      // the offset is the id of the literal in the symbol table
+    };
+
+    enum DocumentMode
+    {
+        Document_Owned,
+        Document_Borrowed,
+    };
+
+    struct Node
+    {
+        NodeType type;
+        std::uint16_t flags;
+        std::uint32_t parent;   // index of the parent, the root points to itself
+        std::uint32_t next;     // index after the subtree
+        std::uint32_t length;   // literal: size in the pool, list: number of children
+        std::uint64_t offset;   // literal: start in the pool (or the source), number: the value
+    };
+
+    class Document;
+    class SourceBuffer;
+
+    /**
+     * Table of interned literals: every distinct literal is stored once, and gets a small
+     * id in the order they were first seen. The names stay where they are as long as the
+     * table is alive, so two interned literals are equal if their ids are.
+     * It is not synchronized, a table shared by several documents must be filled by one
+     * parser at a time.
+     */
+    class SymbolTable
+    {
+    private:
+        // a deque, so the names don't move when it grows
+        std::deque<std::string> names;
+        std::unordered_map<std::string_view, std::uint32_t> ids;
+    public:
+        // longer literals are rarely repeated, they are not interned
+        static constexpr std::size_t MaxLength = 64;
+
+        std::uint32_t intern(std::string_view name);
+        std::optional<std::uint32_t> find(std::string_view name) const;
+        std::string_view name(std::uint32_t id) const;
+        std::size_t size() const;
+    };
+
+    /**
+     * Read-only Object-like view of a node of a Document.
+     * Only valid as long as the Document is alive.
+     */
+    class DocumentView
+    {
+    private:
+        const Document* doc = nullptr;
+        std::uint32_t index = 0;
+    public:
+        DocumentView() = default;
+        DocumentView(const Document* _doc, std::uint32_t _index);
+
+        bool valid() const;
+        NodeType type() const;
+        // number of children of a list
+        std::size_t size() const;
+        DocumentView child(std::size_t i) const;
+        DocumentView parent() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+        Object toObject() const;
+
+        void foreachObjectData(
+            std::function<void(const DocumentView&)> f) const;
+        template <class F>
+        void visitObjectData(F&& f) const;
+        std::optional<std::string_view> expectLiteralData() const;
+        std::optional<std::int64_t> expectInteger() const;
+        std::optional<double> expectFloat() const;
+        // id of an interned literal in the symbol table of the document
+        std::optional<std::uint32_t> symbol() const;
+    };
+
+    class Document
+    {
+    friend class DocumentView;
+    friend class DocumentBuilder;
+    friend class ParallelParser;
+    private:
+        std::vector<Node> nodes;
+        std::string pool;
+        // the source of the borrowed literals, the owner keeps it alive
+        std::string_view source;
+        std::shared_ptr<const SourceBuffer> owner;
+        // the table of the interned literals, if they are interned
+        std::shared_ptr<const SymbolTable> symbolTable;
+
+        std::string_view literal(const Node& n) const;
+        // appends the nodes of a subtree in document order
+        void write(std::uint32_t from, std::uint32_t to, std::string& out, WriteMode mode) const;
+        // the nodes of a subtree to a writer, an error node is an error element like in the Object
+        void write(std::uint32_t from, std::uint32_t to, Writer& writer) const;
+    public:
+        Document() = default;
+        static Document fromObject(const Object& obj);
+
+        DocumentView root() const;
+        std::size_t size() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+        std::string to_binary() const;
+        void encode(std::string& out) const;
+        // the node table and the pool as they are, to be mapped by a Snapshot
+        std::string to_snapshot() const;
+        // the borrowed and the interned literals are not counted, they belong to the source and the table
+        MemoryReport memoryUsage() const;
+
+        bool borrowed() const;
+        const SymbolTable* symbols() const;
+        // copies the borrowed and the interned literals into the pool, the source and the
+        // symbol table are not needed after it
+        void materialize();
+    };
+
+    /**
+     * events -> Document
+     */
+    class DocumentBuilder : public Handler
+    {
+    private:
+        Document doc;
+        std::vector<std::uint32_t> open;
+        std::shared_ptr<SymbolTable> symbols;
+        bool failed = false;
+
+        // false if the document has no room for one more node
+        bool add(NodeType type);
+    public:
+        DocumentBuilder() = default;
+        // borrowed mode: the literals that are in the source are not copied
+        DocumentBuilder(std::string_view source, std::shared_ptr<const SourceBuffer> owner = nullptr);
+        // the short literals are interned in the table instead of being copied
+        void set_symbols(std::shared_ptr<SymbolTable> _symbols);
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_error() override;
+        Document take();
+    };
+
+    template <class F>
+    void DocumentView::visitObjectData(F&& f) const
+    {
+        if (type() != Node_List)
+            return;
+        const std::vector<Node>& nodes = doc->nodes;
+        for (std::uint32_t c = index + 1; c < nodes[index].next; c = nodes[c].next)
+            f(DocumentView(doc, c));
+    }
+
     /**
      * string -> set of symbols
      */
@@ -95,6 +587,11 @@ namespace lison
     {
     friend class Parser;
     friend class LiSON;
+    friend class Lexer;
+    friend class PushParser;
+    friend class PullParser;
+    friend class ParallelParser;
+    friend class LinesReader;
     private:
         enum Symbol
         {
@@ -113,9 +610,80 @@ namespace lison
         };
 
         SymbolObject actual;
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+        static Symbol classify(char c);
     public:
         Tokenizer() = default;
-        std::list<SymbolObject> tokenize(const std::string& src);
+        // the symbol lists are allocated from it
+        void set_memory_resource(std::pmr::memory_resource* _resource);
+        std::pmr::list<SymbolObject> tokenize(const std::string& src);
+    };
+
+    /**
+     * Bitmasks of the structural characters of a 64 byte block of the source,
+     * bit i of each mask belongs to the i-th byte of the block.
+     */
+    struct BlockMasks
+    {
+        std::uint64_t quote;
+        std::uint64_t leftParen;
+        std::uint64_t rightParen;
+        std::uint64_t whitespace;
+    };
+
+    /**
+     * Vectorized classification of the source, a block at a time.
+     * The implementation is chosen at runtime from what the CPU supports
+     * (AVX-512, AVX2, SSE2), with the plain scalar loop as fallback.
+     */
+    class Scanner
+    {
+    public:
+        static constexpr std::size_t BlockSize = 64;
+
+        // classifies a block, shorter blocks are padded with non-structural bytes
+        static BlockMasks classify(const char* block, std::size_t length);
+        // bits of the block that are inside a literal (opening quote included, closing excluded)
+        // inside carries the state between consecutive blocks
+        static std::uint64_t literalMask(std::uint64_t quote, bool& inside);
+
+        // name of the active implementation
+        static const char* implementation();
+        // forces an implementation by name, false if the CPU does not have it (safe while parsing)
+        static bool select(const std::string& name);
+    };
+
+    /**
+     * string -> one symbol at a time
+     * cursor over the source, the parser pulls the symbols from it
+     * without building the intermediate symbol list
+     */
+    class Lexer
+    {
+    friend class Parser;
+    friend class PushParser;
+    friend class PullParser;
+    friend class Cursor;
+    private:
+        std::string_view src;
+        std::size_t pos = 0;
+        // structural characters of the block that was scanned last
+        std::size_t block = std::string_view::npos;
+        std::uint64_t structural = 0;
+
+        Tokenizer::Symbol peek() const;
+        void advance();
+        bool done() const;
+        // consumes the characters and whitespaces until the next structural symbol
+        std::string_view literal();
+        // consumes the characters of an unquoted literal, until a structural symbol or a whitespace
+        std::string_view number();
+        // whitespaces of a literal body are folded to spaces, the buffer is only used if needed
+        static std::string_view fold(std::string_view body, std::string& buffer);
+    public:
+        Lexer() = default;
+        Lexer(std::string_view _src);
     };
 
     /**
@@ -124,38 +692,555 @@ namespace lison
     class Parser
     {
     private:
-        std::list<Tokenizer::SymbolObject>::iterator iter;
-        std::list<Tokenizer::SymbolObject>::iterator endIter;
+        Lexer lexer;
+        // literal with folded whitespaces, only used if the source has to be changed
+        std::string folded;
+        std::size_t maxDepth = DefaultMaxDepth;
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+        std::shared_ptr<SymbolTable> symbols;
 
         bool accept(Tokenizer::Symbol req);
-        char character();
-        Object literal();
-        Object object();
+        bool literal(Handler& handler);
+        bool number(Handler& handler);
+        bool object(Handler& handler);
+    public:
+        // the parser doesn't recurse, the depth limit is only there to stop broken input early
+        static constexpr std::size_t DefaultMaxDepth = 1 << 20;
+        void set_max_depth(std::size_t _maxDepth);
+        // the Objects are built in it, it must outlive them
+        void set_memory_resource(std::pmr::memory_resource* _resource);
+        // the Documents intern their short literals in the table, it can be shared by them
+        void set_symbols(std::shared_ptr<SymbolTable> _symbols);
+
+        // event API, the handler gets the elements in document order
+        bool parse(std::string_view src, Handler& handler);
+        // all the elements of the source one after the other, each one is closed by on_element_end
+        bool parseSequence(std::string_view src, Handler& handler);
+
+        // tree API, built on the events
+        Object parse(const std::pmr::list<Tokenizer::SymbolObject>& symbolStream);
+        Object parse(std::string_view src);
+        Document parseDocument(std::string_view src, DocumentMode mode = Document_Owned);
+        // the document keeps the source alive, if it borrows from it
+        Document parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode = Document_Borrowed);
+    };
+
+    /**
+     * Parser of one big top-level list on several threads.
+     * A pre-scan of the structural characters splits the children of the root into ranges
+     * of about the same size, the ranges are parsed at the same time and the parts are joined
+     * in order. Anything else (a literal root, a small or broken source) is left to the
+     * sequential Parser, so the result is always the same as the Parser's.
+     */
+    class ParallelParser
+    {
+    private:
+        unsigned threads;
+        std::size_t chunkSize = DefaultChunkSize;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+
+        // start of the children of the root, the start of every other range and the end of the root
+        bool split(std::string_view src, std::vector<std::size_t>& bounds) const;
+        // each range in its own thread
+        template <class F>
+        void run(std::size_t ranges, F&& f) const;
+        Document build(std::string_view src, DocumentMode mode, std::shared_ptr<const SourceBuffer> owner);
+    public:
+        // below this much source per thread the threads are not worth it
+        static constexpr std::size_t DefaultChunkSize = 1 << 20;
+
+        // all the cores by default
+        ParallelParser();
+        void set_threads(unsigned _threads);
+        void set_chunk_size(std::size_t _chunkSize);
+        void set_max_depth(std::size_t _maxDepth);
+
+        Object parse(std::string_view src);
+        Document parseDocument(std::string_view src, DocumentMode mode = Document_Owned);
+        Document parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode = Document_Borrowed);
+    };
+
+    /**
+     * Writer of big objects on several threads.
+     * The big lists are split into runs of siblings, the runs are written at the same time into
+     * buffers of their own, and the buffers go to the output in order as soon as they are ready
+     * (to a file with writev, where there is one). The output is the same as Object::write's.
+     */
+    class ParallelWriter
+    {
+    private:
+        // a part of the output: a run of siblings, a whole object, or a fixed text
+        struct Piece
+        {
+            ObjectList::const_iterator first{};
+            std::size_t count = 0;
+            const Object* single = nullptr;
+            std::string text;
+        };
+
+        unsigned threads;
+        std::size_t minElements = DefaultMinElements;
+
+        // lists are only split this deep, below that they are written as a whole
+        static constexpr std::size_t MaxSplitDepth = 8;
+        void plan(const Object& obj, std::size_t want, std::size_t depth, WriteMode mode,
+                  std::vector<Piece>& pieces, std::size_t& split) const;
+        // the pieces that are done are passed to ready in order, [from, to) at a time
+        void render(std::vector<Piece>& pieces, WriteMode mode,
+                    const std::function<void(std::size_t from, std::size_t to)>& ready) const;
     public:
-        Object parse(std::list<Tokenizer::SymbolObject> symbolStream);
+        // below this many elements in the split lists the threads are not worth it
+        static constexpr std::size_t DefaultMinElements = 1024;
+
+        // all the cores by default
+        ParallelWriter();
+        void set_threads(unsigned _threads);
+        void set_min_elements(std::size_t _minElements);
+
+        std::string to_string(const Object& obj, WriteMode mode = Write_Padded) const;
+        // false if the file can't be written
+        bool write(const Object& obj, const std::string& filename, WriteMode mode = Write_Padded) const;
     };
 
+    /**
+     * Resumable parser, the source arrives in chunks of any size.
+     * The state is kept between the feed calls, so a chunk may end anywhere, even in
+     * the middle of a literal. The source is a sequence of top-level elements, the
+     * events are reported as soon as they are complete.
+     */
+    class PushParser
+    {
+    private:
+        enum State
+        {
+            State_Between,
+            State_Literal,
+            State_Number,
+            State_Error,
+        };
+
+        Handler& handler;
+        State state = State_Between;
+        std::size_t depth = 0;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+        // the part of a literal body or a number that came in the previous chunks
+        std::string pending;
+        std::string folded;
+
+        bool fail();
+        // the number in pending is complete
+        bool number();
+    public:
+        PushParser(Handler& _handler);
+        void set_max_depth(std::size_t _maxDepth);
+        // false if the source is not valid LiSON
+        bool feed(std::string_view chunk);
+        // end of the source, false if it stopped inside an element
+        bool finish();
+    };
+
+    enum PullEvent
+    {
+        Pull_ListBegin,
+        Pull_ListEnd,
+        Pull_Literal,
+        Pull_Integer,
+        Pull_Float,
+        // the element is complete, nothing follows it
+        Pull_End,
+        Pull_Error,
+    };
+
+    /**
+     * Parser of one element, that gives the events when they are asked for (pull API).
+     * Nothing is built and nothing is called back, the caller walks the source on its own,
+     * so it can put the literals right where they belong (the bindings are built on it).
+     */
+    class PullParser
+    {
+    private:
+        Lexer lexer;
+        std::string folded;
+        std::string_view value;
+        std::int64_t integerValue = 0;
+        double floatValue = 0;
+        std::size_t depth = 0;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+        bool done = false;
+        bool failed = false;
+
+        bool accept(Tokenizer::Symbol req);
+        PullEvent fail();
+    public:
+        PullParser(std::string_view src);
+        void set_max_depth(std::size_t _maxDepth);
+        PullEvent next();
+        // the literal that was pulled last, only valid until the next pull
+        std::string_view literal() const;
+        std::int64_t integer() const;
+        // the float that was pulled last, or the integer as a float
+        double floating() const;
+        // skips the rest of the list that was just begun, false if the source is broken
+        bool skip();
+    };
+
+    /**
+     * Kind of an element in the binary encoding, the low 2 bits of its head.
+     * Every element starts with a varint head (count << 2 | tag):
+     * literal -> the length, then the bytes; list -> the number of children, then the children;
+     * number -> 0 and the zigzag varint of an integer, or 1 and the 8 bytes of a float (little endian);
+     * error -> 0, the error node of a broken tree, decoded as on_error like ERROR in the text.
+     */
+    enum BinaryTag : std::uint8_t
+    {
+        Binary_Literal,
+        Binary_List,
+        Binary_Error,
+        Binary_Number,
+    };
+
+    /**
+     * binary encoding -> events
+     * The literals are taken straight from the source by their length, there is nothing to scan.
+     */
+    class Decoder
+    {
+    private:
+        std::string_view src;
+        std::size_t pos = 0;
+        std::size_t maxDepth = Parser::DefaultMaxDepth;
+
+        bool varint(std::uint64_t& value);
+        bool element(Handler& handler);
+    public:
+        // start of every encoded source: magic and version
+        static constexpr std::string_view Magic = std::string_view("\0LSB\1", 5);
+        static bool detect(std::string_view src);
+        void set_max_depth(std::size_t _maxDepth);
+
+        bool parse(std::string_view src, Handler& handler);
+        Object parse(std::string_view src);
+        // the literals are stored as they are, so a document can borrow them
+        Document parseDocument(std::string_view src, DocumentMode mode = Document_Owned);
+        Document parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode = Document_Borrowed);
+    };
+
+    /**
+     * On-demand navigation over the raw source, without parsing it.
+     * A cursor points to the start of an element. Getting a child or a sibling skips the
+     * elements before it by counting the parens (a block at a time with the Scanner),
+     * so the cost is about the bytes skipped, and nothing is allocated. The source is not
+     * validated, a malformed part of it just gives invalid cursors.
+     * Only valid as long as the source buffer is alive.
+     */
+    class Cursor
+    {
+    private:
+        std::string_view src;
+        std::size_t pos = std::string_view::npos;
+
+        Cursor(std::string_view _src, std::size_t _pos);
+        // start of the next element from a position, npos if there is none
+        std::size_t element(std::size_t from) const;
+        // position right after the element starting at a position
+        std::size_t skip(std::size_t from) const;
+        // type of an unquoted element, Number_None for a list or a quoted literal
+        NumberType number(std::int64_t& integer, double& floating) const;
+    public:
+        Cursor() = default;
+        // at the first top-level element of the source
+        Cursor(std::string_view _src);
+
+        bool valid() const;
+        bool isList() const;
+        bool isLiteral() const;
+        bool isNumber() const;
+
+        Cursor child(std::size_t i) const;
+        Cursor next_sibling() const;
+        // number of children, needs a pass over the list
+        std::size_t size() const;
+
+        // body of the literal as it is in the source (whitespaces not folded),
+        // a number out of range is a literal of its text, as in the parser
+        std::optional<std::string_view> literal() const;
+        // body of the literal with folded whitespaces, like in an Object
+        std::optional<std::string> expectLiteralData() const;
+        std::optional<std::int64_t> expectInteger() const;
+        std::optional<double> expectFloat() const;
+        // the whole source text of the element
+        std::string_view raw() const;
+    };
+
+    // steps of loading and saving, the unit of the instrumentation
+    enum Stage
+    {
+        // file I/O
+        Stage_Read,
+        // tokenizing and parsing, they are done in the same pass
+        Stage_Parse,
+        Stage_Interpret,
+        // making the Object that is written
+        Stage_Revert,
+        // writing the text (without revert)
+        Stage_Write,
+        Stage_Count,
+    };
+
+    struct StageMetrics
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t ns = 0;
+        std::uint64_t bytes = 0;
+        // only counted with LISON_COUNT_ALLOCATIONS, the inner stages are included
+        std::uint64_t allocations = 0;
+        std::uint64_t allocatedBytes = 0;
+    };
+
+    // everything that was measured, plain data to be exported
+    struct Metrics
+    {
+        StageMetrics stages[Stage_Count];
+        // parens and literals that were parsed
+        std::uint64_t symbols = 0;
+        // lists and literals
+        std::uint64_t nodes = 0;
+        std::uint64_t literalBytes = 0;
+        std::uint64_t maxDepth = 0;
+    };
+
+    /**
+     * Hook of the instrumentation, attached to a LiSON or a Serializer with set_trace.
+     * The stages add up in the metrics, and on_stage is called at the end of each one.
+     * It is only compiled in with LISON_TRACE defined, without it the hooks are never
+     * called and cost nothing.
+     */
+    class Trace
+    {
+    public:
+        Metrics metrics;
+        virtual ~Trace() = default;
+        virtual void on_stage(Stage stage, std::uint64_t ns, std::uint64_t bytes) {}
+        void reset();
+    };
+
+    struct AllocationStats
+    {
+        std::uint64_t allocations = 0;
+        std::uint64_t deallocations = 0;
+        // all the bytes that were ever allocated
+        std::uint64_t allocatedBytes = 0;
+        // allocated and not freed yet
+        std::uint64_t liveBytes = 0;
+        std::uint64_t peakBytes = 0;
+    };
+
+    /**
+     * Counters of the global operator new and delete.
+     * They are only counted with LISON_COUNT_ALLOCATIONS defined, as then the library
+     * replaces the global operators (so the program must not replace them too). Without it
+     * the counters stay at zero. The difference of two stats is what happened between them.
+     */
+    class Allocations
+    {
+    public:
+        static bool enabled();
+        static AllocationStats stats();
+        // the peak starts again from the live bytes
+        static void reset_peak();
+    };
+
+#ifdef LISON_TRACE
+    // measures a stage until it is stopped or goes out of scope, nothing without a trace
+    class StageTimer
+    {
+    private:
+        Trace* trace;
+        Stage stage;
+        std::uint64_t bytes;
+        std::uint64_t excluded = 0;
+        bool running = true;
+        std::chrono::steady_clock::time_point start;
+        AllocationStats startAllocations;
+    public:
+        StageTimer(Trace* _trace, Stage _stage, std::uint64_t _bytes = 0);
+        ~StageTimer();
+        void add_bytes(std::uint64_t n);
+        // time of an inner stage, that is not counted in this one
+        void exclude(std::uint64_t ns);
+        void stop();
+    };
+
+    // counts the elements on their way to another handler
+    class TraceHandler : public Handler
+    {
+    private:
+        Handler& handler;
+        Trace* trace;
+        std::uint64_t depth = 0;
+    public:
+        TraceHandler(Handler& _handler, Trace* _trace);
+        void on_list_begin() override;
+        void on_list_end() override;
+        void on_literal(std::string_view value) override;
+        void on_integer(std::int64_t value) override;
+        void on_float(double value) override;
+        void on_element_end() override;
+        void on_error() override;
+    };
+#endif
+
     /**
      * Abstract
      */
     class LiSON
     {
 		friend class Object;
+    private:
+        Trace* trace = nullptr;
+
+        // emit, with revert measured apart
+        void write(Writer& writer) const;
     protected:
         /**
-         * Interface methods
+         * Interface methods.
+         * A class writes itself by making an Object (revert), and it can also write
+         * its elements straight to a Writer (emit) to skip the Object when serializing.
+         * By default emit writes the Object of revert.
          */
         virtual void interpret(const Object& obj) = 0;
         virtual Object revert() const = 0;
+        virtual void emit(Writer& writer) const;
+        // the Object built from emit, for a revert of a class that overrides emit
+        Object emitted() const;
     public:
         virtual ~LiSON() = default;
         /**
          * Default implemented methods, shouldn't override
          */
         void deserialize(const std::string& src);
+        // parses the file in place, it is mapped where possible
+        void deserialize(const Serializer& serializer);
         std::string serialize() const;
+        void serialize(std::ostream& out, WriteMode mode = Write_Padded) const;
+        void serialize(Writer& writer) const;
+        // the stages are measured into the trace (with LISON_TRACE), nullptr to stop it
+        void set_trace(Trace* _trace);
+    };
+
+    // how a file is going to be read
+    enum SourceMode
+    {
+        // read from the start to the end
+        Source_Text,
+        // looked up anywhere, and never converted on read
+        Source_Binary,
+    };
+
+    /**
+     * Read-only contents of a file.
+     * Regular files are memory mapped (and marked for the way they are read), so the parser
+     * works right on the page cache without copying. Pipes, special files and systems
+     * without mmap (or with LISON_NO_MMAP defined) fall back to reading the file into a buffer,
+     * where a binary encoded file is never converted as text.
+     * It is shared, so the contents stay alive as long as anything borrows from them.
+     */
+    class SourceBuffer
+    {
+    private:
+        const char* data = nullptr;
+        std::size_t length = 0;
+        bool mapped = false;
+        std::string buffer;
+    public:
+        SourceBuffer() = default;
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator =(const SourceBuffer&) = delete;
+        ~SourceBuffer();
+
+        // nullptr if the file can't be opened
+        static std::shared_ptr<const SourceBuffer> open(const std::string& filename, SourceMode mode = Source_Text);
+
+        std::string_view view() const;
+        bool isMapped() const;
     };
 
+    class Snapshot;
+
+    /**
+     * Read-only Object-like view of a node of a Snapshot, the same as the DocumentView.
+     * Only valid as long as the Snapshot is alive.
+     */
+    class SnapshotView
+    {
+    private:
+        const Snapshot* snap = nullptr;
+        std::uint32_t index = 0;
+    public:
+        SnapshotView() = default;
+        SnapshotView(const Snapshot* _snap, std::uint32_t _index);
+
+        bool valid() const;
+        NodeType type() const;
+        std::size_t size() const;
+        SnapshotView child(std::size_t i) const;
+        SnapshotView parent() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+        Object toObject() const;
+
+        void foreachObjectData(
+            std::function<void(const SnapshotView&)> f) const;
+        template <class F>
+        void visitObjectData(F&& f) const;
+        std::optional<std::string_view> expectLiteralData() const;
+        std::optional<std::int64_t> expectInteger() const;
+        std::optional<double> expectFloat() const;
+    };
+
+    /**
+     * Document stored in a file the way it is in memory: a header, the node table and the pool.
+     * Opening it maps the file and checks the header, nothing is parsed or copied,
+     * so the pages are shared by every process that opens the same file.
+     * Every lookup is checked against the table, a broken file only gives invalid views.
+     */
+    class Snapshot
+    {
+    friend class SnapshotView;
+    private:
+        std::shared_ptr<const SourceBuffer> owner;
+        const Node* nodes = nullptr;
+        std::uint32_t count = 0;
+        std::string_view pool;
+
+        std::optional<std::string_view> literal(std::uint32_t index) const;
+        // reports the nodes of a subtree in document order
+        void write(std::uint32_t index, Writer& writer) const;
+    public:
+        static constexpr std::string_view Magic = std::string_view("\0LSS", 4);
+        static constexpr std::uint16_t Version = 1;
+
+        Snapshot() = default;
+        // invalid if the file can't be opened or it is not a snapshot
+        static Snapshot open(const std::string& filename);
+        static Snapshot load(std::shared_ptr<const SourceBuffer> source);
+
+        bool valid() const;
+        SnapshotView root() const;
+        std::size_t size() const;
+        std::string to_string(WriteMode mode = Write_Padded) const;
+    };
+
+    template <class F>
+    void SnapshotView::visitObjectData(F&& f) const
+    {
+        if (type() != Node_List)
+            return;
+        std::uint32_t end = snap->nodes[index].next;
+        // the next index only goes forward in a sound table
+        for (std::uint32_t c = index + 1; c < end && c < snap->count && snap->nodes[c].next > c; c = snap->nodes[c].next)
+            f(SnapshotView(snap, c));
+    }
+
     /**
      * file -> object
      */ 
@@ -163,12 +1248,323 @@ namespace lison
     {
     private:
         std::string filename = "";
+        Trace* trace = nullptr;
     public:
         Serializer() = default;
         Serializer(const std::string& _filename);
         void set_file(const std::string& _filename);
+        // the reads and writes are measured into the trace (with LISON_TRACE)
+        void set_trace(Trace* _trace);
         std::string read() const;
+        // the contents without copying, nullptr if the file can't be opened
+        std::shared_ptr<const SourceBuffer> map() const;
+        // feeds the file to a push parser in chunks, false if the file is not valid LiSON
+        // a binary file is detected and decoded instead
+        bool read(Handler& handler, std::size_t chunkSize = 64 * 1024) const;
         void write(const std::string& source) const;
+        void write(const Object& obj, WriteMode mode = Write_Padded) const;
+        // streams the object into the file, without any tree or string of the whole output
+        void write(const LiSON& lison, WriteMode mode = Write_Padded) const;
+        // writes the binary encoding
+        void encode(const Object& obj) const;
+        // writes the document as a snapshot, to be opened with Snapshot::open
+        void snapshot(const Document& doc) const;
+    };
+
+    /**
+     * Reader of LiSON lines: one document on every line of a stream.
+     * The blank lines are skipped, a line that is not valid LiSON gives an error Object.
+     * Only a batch of lines per thread is in memory at a time, however long the stream is.
+     */
+    class LinesReader
+    {
+    private:
+        std::istream& in;
+        // number of the last line that was read
+        std::size_t number = 0;
+
+        bool line(std::string& out);
+    public:
+        // a batch of lines is parsed by one worker at a time
+        static constexpr std::size_t BatchLines = 1024;
+        static constexpr std::size_t BatchSize = 1 << 20;
+
+        LinesReader(std::istream& _in);
+        // false at the end of the stream
+        bool next(Object& obj);
+        bool next(LiSON& lison);
+        // number of the line of the last document
+        std::size_t line() const;
+
+        /**
+         * Parses the rest of the stream on a pool of threads (all the cores by default).
+         * f gets the documents with their line numbers, one call at a time. In order, they come
+         * in the order of the stream, otherwise as soon as they are parsed.
+         * Returns the number of documents.
+         */
+        std::size_t forEach(std::function<void(std::size_t line, Object&& obj)> f,
+                            unsigned threads = 0, bool ordered = true);
+    };
+
+    /**
+     * Writer of LiSON lines: every document is written in compact form on a line of its own.
+     * The newlines of the literals are written as spaces, which the parser folds them to anyway.
+     */
+    class LinesWriter : public StreamWriter
+    {
+    public:
+        LinesWriter(std::ostream& _stream);
+        void literal(std::string_view value) override;
+        void write(const Object& obj);
+        void write(const LiSON& lison);
+    };
+
+    /**
+     * Binding of a type to LiSON, read right from the source into the members and written
+     * right from them, without an Object or a LiSON class in between.
+     * Bound out of the box: std::string (a literal), the arithmetic types (a number, or a
+     * literal with its text), bool (the literal 'true' or 'false', or the number 1 or 0),
+     * std::vector and std::list (a list of the elements), and the
+     * structs described by a Schema (a list of ('name' value) pairs, in any order, the
+     * unknown names are skipped). Any other type can be bound by specializing Binding.
+     */
+    template <class T, class = void>
+    struct Binding;
+
+    template <class T, class M>
+    struct Field
+    {
+        std::string_view name;
+        M T::* member;
+    };
+
+    template <class T, class M>
+    constexpr Field<T, M> field(std::string_view name, M T::* member)
+    {
+        return Field<T, M>{name, member};
+    }
+
+    /**
+     * Field list of a struct, to be specialized with a static constexpr tuple of fields:
+     *  LISON_SCHEMA(Point, lison::field("x", &Point::x), lison::field("y", &Point::y));
+     */
+    template <class T>
+    struct Schema;
+
+// at global scope, with the type fully qualified
+#define LISON_SCHEMA(Type, ...) \
+    namespace lison { template <> struct Schema<Type> { static constexpr auto fields = std::make_tuple(__VA_ARGS__); }; }
+
+    template <>
+    struct Binding<std::string>
+    {
+        static bool read(PullParser& parser, PullEvent event, std::string& out)
+        {
+            if (event != Pull_Literal)
+                return false;
+            out.assign(parser.literal());
+            return true;
+        }
+
+        static void write(Writer& writer, const std::string& value)
+        {
+            writer.literal(value);
+        }
+    };
+
+    template <>
+    struct Binding<bool>
+    {
+        static bool read(PullParser& parser, PullEvent event, bool& out)
+        {
+            if (event == Pull_Integer && (parser.integer() == 0 || parser.integer() == 1))
+            {
+                out = parser.integer() == 1;
+                return true;
+            }
+            if (event != Pull_Literal || (parser.literal() != "true" && parser.literal() != "false"))
+                return false;
+            out = parser.literal() == "true";
+            return true;
+        }
+
+        static void write(Writer& writer, bool value)
+        {
+            writer.literal(value ? "true" : "false");
+        }
+    };
+
+    template <class T>
+    struct Binding<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+    {
+        // a number, or a literal with the text of one
+        static bool read(PullParser& parser, PullEvent event, T& out)
+        {
+            if (event == Pull_Integer && std::is_integral_v<T>)
+            {
+                std::int64_t value = parser.integer();
+                out = T(value);
+                return std::int64_t(out) == value && (value < 0) == (out < T(0));
+            }
+            if constexpr (std::is_floating_point_v<T>)
+            {
+                if (event == Pull_Integer || event == Pull_Float)
+                {
+                    out = T(parser.floating());
+                    return true;
+                }
+            }
+            if (event != Pull_Literal)
+                return false;
+            std::string_view value = parser.literal();
+            auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), out);
+            return error == std::errc() && end == value.data() + value.size();
+        }
+
+        static void write(Writer& writer, T value)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+                writer.floating(double(value));
+            else if (std::is_signed_v<T> || std::uint64_t(value) <= std::uint64_t(INT64_MAX))
+                writer.integer(std::int64_t(value));
+            else
+            {
+                // an unsigned one over the range of the integers
+                char buffer[Number::MaxLength];
+                char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+                writer.literal(std::string_view(buffer, end - buffer));
+            }
+        }
+    };
+
+    // the sequence containers, the elements are appended
+    template <class C>
+    struct SequenceBinding
+    {
+        using Element = typename C::value_type;
+
+        static bool read(PullParser& parser, PullEvent event, C& out)
+        {
+            if (event != Pull_ListBegin)
+                return false;
+            while ((event = parser.next()) != Pull_ListEnd)
+            {
+                Element& element = out.emplace_back();
+                if (!Binding<Element>::read(parser, event, element))
+                    return false;
+            }
+            return true;
+        }
+
+        static void write(Writer& writer, const C& values)
+        {
+            writer.begin_list();
+            for (const Element& value : values)
+                Binding<Element>::write(writer, value);
+            writer.end_list();
+        }
+    };
+
+    template <class T>
+    struct Binding<std::vector<T>> : SequenceBinding<std::vector<T>> {};
+
+    template <class T>
+    struct Binding<std::list<T>> : SequenceBinding<std::list<T>> {};
+
+    template <class T>
+    struct Binding<T, std::void_t<decltype(Schema<T>::fields)>>
+    {
+        static bool read(PullParser& parser, PullEvent event, T& out)
+        {
+            if (event != Pull_ListBegin)
+                return false;
+            while ((event = parser.next()) != Pull_ListEnd)
+            {
+                // ( 'name' value )
+                if (event != Pull_ListBegin || parser.next() != Pull_Literal)
+                    return false;
+                std::string_view name = parser.literal();
+                bool ok = true;
+                // the name is only valid until the value is pulled, so it is matched first
+                bool known = std::apply([&](const auto&... fields)
+                {
+                    return ((fields.name == name && (ok = readField(parser, out, fields), true)) || ...);
+                }, Schema<T>::fields);
+                if (!known)
+                {
+                    event = parser.next();
+                    ok = event == Pull_Literal || event == Pull_Integer || event == Pull_Float
+                        || (event == Pull_ListBegin && parser.skip());
+                }
+                if (!ok || parser.next() != Pull_ListEnd)
+                    return false;
+            }
+            return true;
+        }
+
+        static void write(Writer& writer, const T& value)
+        {
+            writer.begin_list();
+            std::apply([&](const auto&... fields)
+            {
+                (writeField(writer, value, fields), ...);
+            }, Schema<T>::fields);
+            writer.end_list();
+        }
+    private:
+        template <class M>
+        static bool readField(PullParser& parser, T& out, const Field<T, M>& field)
+        {
+            return Binding<M>::read(parser, parser.next(), out.*field.member);
+        }
+
+        template <class M>
+        static void writeField(Writer& writer, const T& value, const Field<T, M>& field)
+        {
+            writer.begin_list();
+            writer.literal(field.name);
+            Binding<M>::write(writer, value.*field.member);
+            writer.end_list();
+        }
+    };
+
+    /**
+     * Entry points of the bindings.
+     * The reads are false if the source is broken or doesn't fit the type, the object may be
+     * filled partly then.
+     */
+    class Binder
+    {
+    public:
+        template <class T>
+        static bool read(std::string_view src, T& out)
+        {
+            PullParser parser(src);
+            return Binding<T>::read(parser, parser.next(), out) && parser.next() == Pull_End;
+        }
+
+        // reads the file, it is mapped where possible
+        template <class T>
+        static bool load(const Serializer& serializer, T& out)
+        {
+            std::shared_ptr<const SourceBuffer> source = serializer.map();
+            return source != nullptr && read(source->view(), out);
+        }
+
+        template <class T>
+        static void write(Writer& writer, const T& value)
+        {
+            Binding<T>::write(writer, value);
+        }
+
+        template <class T>
+        static std::string to_string(const T& value, WriteMode mode = Write_Padded)
+        {
+            std::string out;
+            StringWriter writer(out, mode);
+            Binding<T>::write(writer, value);
+            return out;
+        }
     };
 
     /**
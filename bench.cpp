@@ -0,0 +1,644 @@
+/**
+ * Benchmarks for LiSON.
+ * Generates the corpora from a seed (so every run measures the same input), runs the
+ * stages on them and prints the results as JSON.
+ *
+ * usage: bench [--size 1M] [--shape wide,deep,long,tiny,records,numbers] [--reps 3] [--seed 1]
+ *              [--dir .] [--out results.json] [--generate DIR]
+ */
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include "LiSON_base.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace lison;
+
+/**
+ * Peak resident set size, in kB.
+ * On linux the peak can be reset, so each benchmark gets its own, elsewhere it is the peak
+ * of the whole process so far.
+ */
+static void resetPeak()
+{
+#ifdef __linux__
+    if (FILE* f = std::fopen("/proc/self/clear_refs", "w"))
+    {
+        std::fputs("5", f);
+        std::fclose(f);
+    }
+#endif
+}
+
+static long peakRSS()
+{
+#ifdef __linux__
+    if (FILE* f = std::fopen("/proc/self/status", "r"))
+    {
+        char line[256];
+        long kb = 0;
+        while (std::fgets(line, sizeof(line), f))
+            if (std::sscanf(line, "VmHWM: %ld kB", &kb) == 1)
+                break;
+        std::fclose(f);
+        return kb;
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Corpus generator.
+ * Each shape stresses a different part: wide lists, deep nesting, long literals,
+ * many tiny literals and tables of records like the ones in real files.
+ */
+class Corpus
+{
+private:
+    std::mt19937_64 rng;
+    std::string out;
+
+    std::string word(std::size_t min, std::size_t max)
+    {
+        std::size_t n = min + rng() % (max - min + 1);
+        std::string w;
+        for (std::size_t i = 0; i < n; i++)
+            w += char('a' + rng() % 26);
+        return w;
+    }
+
+    void literal(const std::string& value)
+    {
+        out += '\'';
+        out += value;
+        out += "' ";
+    }
+
+    void wide(std::size_t size)
+    {
+        while (out.size() < size)
+            literal(word(3, 12));
+    }
+
+    void deep(std::size_t size)
+    {
+        // chains of nested lists, each one holding a literal
+        while (out.size() < size)
+        {
+            std::size_t depth = 1000 + rng() % 9000;
+            for (std::size_t i = 0; i < depth; i++)
+            {
+                out += "( ";
+                literal(word(1, 4));
+            }
+            for (std::size_t i = 0; i < depth; i++)
+                out += ") ";
+        }
+    }
+
+    void longLiterals(std::size_t size)
+    {
+        while (out.size() < size)
+        {
+            std::string value;
+            std::size_t n = 16 * 1024 + rng() % (64 * 1024);
+            while (value.size() < n)
+                value += word(1, 10) + (rng() % 20 == 0 ? "\n" : " ");
+            literal(value);
+        }
+    }
+
+    void tiny(std::size_t size)
+    {
+        while (out.size() < size)
+        {
+            out += "( ";
+            for (int i = 0; i < 16; i++)
+                literal(std::string(1, char('a' + rng() % 26)));
+            out += ") ";
+        }
+    }
+
+    void records(std::size_t size)
+    {
+        static const char* cities[] = {"Budapest", "Szeged", "Debrecen", "Pecs", "Gyor", "Miskolc"};
+        for (std::size_t id = 1; out.size() < size; id++)
+        {
+            out += "( ";
+            out += "( "; literal("id"); literal(std::to_string(id)); out += ") ";
+            std::string first = word(3, 8);
+            std::string last = word(4, 10);
+            out += "( "; literal("name"); literal(first + " " + last); out += ") ";
+            out += "( "; literal("email"); literal(first + "." + last + "@example.com"); out += ") ";
+            out += "( "; literal("city"); literal(cities[rng() % 6]); out += ") ";
+            out += "( "; literal("balance"); literal(std::to_string(rng() % 1000000) + "." + std::to_string(rng() % 100)); out += ") ";
+            out += "( "; literal("tags");
+            out += "( ";
+            for (std::size_t t = rng() % 5; t > 0; t--)
+                literal(word(3, 6));
+            out += ") ) ";
+            out += ") ";
+        }
+    }
+
+    // rows of a matrix, integers and floats
+    void numbers(std::size_t size)
+    {
+        char buffer[Number::MaxLength];
+        while (out.size() < size)
+        {
+            out += "( ";
+            for (int i = 0; i < 4; i++)
+                out += std::string(Number::format(std::int64_t(rng() % 2000001) - 1000000, buffer)) + " ";
+            for (int i = 0; i < 4; i++)
+                out += std::string(Number::format(double(rng() % 100000000) / 1000.0, buffer)) + " ";
+            out += ") ";
+        }
+    }
+public:
+    static constexpr const char* Shapes[] = {"wide", "deep", "long", "tiny", "records", "numbers"};
+
+    Corpus(std::uint64_t seed)
+        : rng(seed)
+    {}
+
+    // one top-level list of about size bytes, empty for an unknown shape
+    std::string generate(const std::string& shape, std::size_t size)
+    {
+        out.clear();
+        out.reserve(size + 1024);
+        out += "( ";
+        if (shape == "wide")
+            wide(size);
+        else if (shape == "deep")
+            deep(size);
+        else if (shape == "long")
+            longLiterals(size);
+        else if (shape == "tiny")
+            tiny(size);
+        else if (shape == "records")
+            records(size);
+        else if (shape == "numbers")
+            numbers(size);
+        else
+            return "";
+        out += ")";
+        return std::move(out);
+    }
+
+    // the same source with the numbers in literals
+    static std::string quoteNumbers(const std::string& src)
+    {
+        std::string quoted;
+        quoted.reserve(src.size() + src.size() / 4);
+        for (std::size_t i = 0; i < src.size(); i++)
+        {
+            bool number = src[i] != '(' && src[i] != ')' && src[i] != ' ';
+            if (number && (i == 0 || src[i - 1] == ' '))
+                quoted += '\'';
+            quoted += src[i];
+            if (number && (i + 1 == src.size() || src[i + 1] == ' '))
+                quoted += '\'';
+        }
+        return quoted;
+    }
+};
+
+/**
+ * The LiSON class of the round trip, it keeps the whole Object.
+ */
+class BenchDoc : public LiSON
+{
+public:
+    Object data = Object(Token{Tkn_Error{}});
+protected:
+    void interpret(const Object& obj) override
+    {
+        data = obj;
+    }
+
+    Object revert() const override
+    {
+        return data;
+    }
+};
+
+/**
+ * A record of the records corpus, read both by a binding and by a LiSON class.
+ */
+struct Record
+{
+    long id = 0;
+    std::string name;
+    std::string email;
+    std::string city;
+    double balance = 0;
+    std::vector<std::string> tags;
+};
+
+LISON_SCHEMA(Record,
+    lison::field("id", &Record::id),
+    lison::field("name", &Record::name),
+    lison::field("email", &Record::email),
+    lison::field("city", &Record::city),
+    lison::field("balance", &Record::balance),
+    lison::field("tags", &Record::tags));
+
+// the same records through the Object tree, the way interpret and revert are written by hand
+class RecordsDoc : public LiSON
+{
+public:
+    std::vector<Record> records;
+protected:
+    template <class N>
+    static void number(const Object& obj, N& out)
+    {
+        std::string_view value = obj.expectLiteralView().value_or("");
+        std::from_chars(value.data(), value.data() + value.size(), out);
+    }
+
+    void interpret(const Object& obj) override
+    {
+        obj.visitObjectData([this](const Object& o)
+        {
+            Record& r = records.emplace_back();
+            o.visitObjectData([&r](const Object& pair)
+            {
+                const ObjectList* kv = pair.expectObjectList();
+                if (kv == nullptr || kv->size() != 2)
+                    return;
+                std::string_view key = kv->front().expectLiteralView().value_or("");
+                const Object& value = kv->back();
+                if (key == "id")
+                    number(value, r.id);
+                else if (key == "name")
+                    r.name = value.expectLiteralView().value_or("");
+                else if (key == "email")
+                    r.email = value.expectLiteralView().value_or("");
+                else if (key == "city")
+                    r.city = value.expectLiteralView().value_or("");
+                else if (key == "balance")
+                    number(value, r.balance);
+                else if (key == "tags")
+                    value.visitObjectData([&r](const Object& t)
+                    {
+                        r.tags.emplace_back(t.expectLiteralView().value_or(""));
+                    });
+            });
+        });
+    }
+
+    static Object pair(const std::string& key, Object&& value)
+    {
+        Object p(Token{Tkn_Object{}});
+        p.add(Object::fromString(key));
+        p.add(std::move(value));
+        return p;
+    }
+
+    template <class N>
+    static Object number(N value)
+    {
+        char buffer[64];
+        auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return Object(Token{Tkn_Literal{std::string_view(buffer, error == std::errc() ? end - buffer : 0)}});
+    }
+
+    Object revert() const override
+    {
+        Object root(Token{Tkn_Object{}});
+        for (const Record& r : records)
+        {
+            Object o(Token{Tkn_Object{}});
+            o.add(pair("id", number(r.id)));
+            o.add(pair("name", Object::fromString(r.name)));
+            o.add(pair("email", Object::fromString(r.email)));
+            o.add(pair("city", Object::fromString(r.city)));
+            o.add(pair("balance", number(r.balance)));
+            Object tags(Token{Tkn_Object{}});
+            for (const std::string& t : r.tags)
+                tags.add(Object::fromString(t));
+            o.add(pair("tags", std::move(tags)));
+            root.add(std::move(o));
+        }
+        return root;
+    }
+};
+
+struct Result
+{
+    std::string name;
+    std::string shape;
+    std::size_t bytes;
+    std::size_t nodes;
+    double seconds;
+    std::size_t allocations;
+    std::size_t allocatedBytes;
+    long peakKB;
+};
+
+// memory taken by a representation of the parsed corpus
+struct MemoryResult
+{
+    std::string shape;
+    std::string representation;
+    MemoryReport report;
+};
+
+/**
+ * Runs a stage reps times and keeps the fastest run.
+ * setup runs before every run and is not measured.
+ */
+template <class Setup, class Run>
+static Result measure(const std::string& name, const std::string& shape, std::size_t bytes, std::size_t nodes,
+                      int reps, Setup&& setup, Run&& run)
+{
+    Result result{name, shape, bytes, nodes, 0, 0, 0, 0};
+    for (int r = 0; r < reps; r++)
+    {
+        setup();
+        resetPeak();
+        AllocationStats before = Allocations::stats();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || seconds < result.seconds)
+        {
+            result.seconds = seconds;
+            AllocationStats after = Allocations::stats();
+            result.allocations = after.allocations - before.allocations;
+            result.allocatedBytes = after.allocatedBytes - before.allocatedBytes;
+            result.peakKB = peakRSS();
+        }
+    }
+    return result;
+}
+
+static std::size_t parseSize(const std::string& s)
+{
+    std::size_t n = std::strtoull(s.c_str(), nullptr, 10);
+    switch (s.empty() ? ' ' : s.back())
+    {
+    case 'G': case 'g': n <<= 10; [[fallthrough]];
+    case 'M': case 'm': n <<= 10; [[fallthrough]];
+    case 'K': case 'k': n <<= 10;
+    default: break;
+    }
+    return n;
+}
+
+static std::vector<std::string> split(const std::string& s)
+{
+    std::vector<std::string> parts;
+    std::stringstream ss(s);
+    for (std::string part; std::getline(ss, part, ',');)
+        if (!part.empty())
+            parts.push_back(part);
+    return parts;
+}
+
+static void json(std::ostream& out, const std::vector<Result>& results, const std::vector<MemoryResult>& memory,
+                 std::size_t size, std::uint64_t seed, int reps)
+{
+    out << "{\n";
+    out << "  \"scanner\": \"" << Scanner::implementation() << "\",\n";
+    out << "  \"size\": " << size << ",\n";
+    out << "  \"seed\": " << seed << ",\n";
+    out << "  \"reps\": " << reps << ",\n";
+    out << "  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        double mb = r.bytes / (1024.0 * 1024.0);
+        out << "    {\"name\": \"" << r.name << "\", \"shape\": \"" << r.shape << "\""
+            << ", \"bytes\": " << r.bytes << ", \"nodes\": " << r.nodes
+            << ", \"seconds\": " << r.seconds
+            << ", \"mb_per_s\": " << (r.seconds > 0 ? mb / r.seconds : 0)
+            << ", \"nodes_per_s\": " << (r.seconds > 0 ? r.nodes / r.seconds : 0)
+            << ", \"allocations\": " << r.allocations
+            << ", \"allocated_bytes\": " << r.allocatedBytes
+            << ", \"peak_rss_kb\": " << r.peakKB << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+    out << "  \"memory\": [\n";
+    for (std::size_t i = 0; i < memory.size(); i++)
+    {
+        const MemoryReport& r = memory[i].report;
+        out << "    {\"shape\": \"" << memory[i].shape << "\", \"representation\": \"" << memory[i].representation << "\""
+            << ", \"nodes\": " << r.nodes
+            << ", \"literal_bytes\": " << r.literalBytes
+            << ", \"container_bytes\": " << r.containerBytes
+            << ", \"heap_bytes\": " << r.heapBytes
+            << ", \"bytes_per_node\": " << r.bytesPerNode() << "}"
+            << (i + 1 < memory.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static const char* Usage =
+    "usage: bench [--size 1M] [--shape wide,deep,long,tiny,records,numbers] [--reps 3] [--seed 1]\n"
+    "             [--dir .] [--out results.json] [--generate DIR]\n";
+
+int main(int argc, char** argv)
+{
+    std::size_t size = 1 << 20;
+    std::vector<std::string> shapes(std::begin(Corpus::Shapes), std::end(Corpus::Shapes));
+    int reps = 3;
+    std::uint64_t seed = 1;
+    std::string dir = ".";
+    std::string outFile;
+    std::string generateDir;
+    int i = 1;
+    for (; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+        if (arg == "--size")
+            size = parseSize(value);
+        else if (arg == "--shape")
+            shapes = split(value);
+        else if (arg == "--reps")
+            reps = std::max(1, std::atoi(value.c_str()));
+        else if (arg == "--seed")
+            seed = std::strtoull(value.c_str(), nullptr, 10);
+        else if (arg == "--dir")
+            dir = value;
+        else if (arg == "--out")
+            outFile = value;
+        else if (arg == "--generate")
+            generateDir = value;
+        else
+        {
+            std::cerr << "unknown option " << arg << std::endl << Usage;
+            return 1;
+        }
+    }
+    // an option without its value
+    if (i < argc)
+    {
+        std::cerr << "missing value of " << argv[i] << std::endl << Usage;
+        return 1;
+    }
+
+    // only the corpora, to be used by other tools
+    if (!generateDir.empty())
+    {
+        for (const std::string& shape : shapes)
+        {
+            Corpus corpus(seed);
+            Serializer(generateDir + "/" + shape + ".lison").write(corpus.generate(shape, size));
+        }
+        return 0;
+    }
+
+    std::vector<Result> results;
+    std::vector<MemoryResult> memory;
+    for (const std::string& shape : shapes)
+    {
+        Corpus corpus(seed);
+        std::string src = corpus.generate(shape, size);
+        if (src.empty())
+        {
+            std::cerr << "unknown shape " << shape << std::endl;
+            return 1;
+        }
+        std::size_t nodes = Parser().parseDocument(src).size();
+        std::string file = dir + "/bench_" + shape + ".lison";
+        std::cerr << shape << ": " << src.size() << " bytes, " << nodes << " nodes" << std::endl;
+        auto none = []() {};
+
+        // the symbol list takes dozens of bytes per character, so it is only measured on small inputs
+        if (src.size() <= (64u << 20))
+        {
+            results.push_back(measure("tokenize", shape, src.size(), nodes, reps, none, [&]()
+            {
+                Tokenizer tokenizer;
+                tokenizer.tokenize(src);
+            }));
+        }
+        results.push_back(measure("parse", shape, src.size(), nodes, reps, none, [&]()
+        {
+            Parser parser;
+            parser.parse(std::string_view(src));
+        }));
+        results.push_back(measure("parse_arena", shape, src.size(), nodes, reps, none, [&]()
+        {
+            // the tree and the arena are released at once
+            std::pmr::monotonic_buffer_resource arena;
+            Parser parser;
+            parser.set_memory_resource(&arena);
+            parser.parse(std::string_view(src));
+        }));
+        results.push_back(measure("parse_document", shape, src.size(), nodes, reps, none, [&]()
+        {
+            Parser parser;
+            parser.parseDocument(src);
+        }));
+
+        Object obj = Parser().parse(std::string_view(src));
+        memory.push_back({shape, "object", obj.memoryUsage()});
+        memory.push_back({shape, "document", Parser().parseDocument(src).memoryUsage()});
+        std::string text = obj.to_string();
+        results.push_back(measure("to_string", shape, text.size(), nodes, reps, none, [&]()
+        {
+            obj.to_string();
+        }));
+        results.push_back(measure("serializer_write", shape, text.size(), nodes, reps, none, [&]()
+        {
+            Serializer(file).write(obj);
+        }));
+        results.push_back(measure("serializer_read", shape, text.size(), nodes, reps, none, [&]()
+        {
+            Serializer(file).read();
+        }));
+        std::string out;
+        results.push_back(measure("lison_roundtrip", shape, src.size(), nodes, reps, [&]() { out.clear(); }, [&]()
+        {
+            BenchDoc doc;
+            src >> doc;
+            out << doc;
+        }));
+        std::remove(file.c_str());
+
+        // typed records, bound right to the structs or interpreted from the Object tree
+        if (shape == "records")
+        {
+            std::vector<Record> records;
+            results.push_back(measure("bind_read", shape, src.size(), nodes, reps, [&]() { records.clear(); }, [&]()
+            {
+                Binder::read(src, records);
+            }));
+            RecordsDoc doc;
+            results.push_back(measure("interpret_read", shape, src.size(), nodes, reps, [&]() { doc.records.clear(); }, [&]()
+            {
+                src >> doc;
+            }));
+            std::string text = Binder::to_string(records);
+            results.push_back(measure("bind_write", shape, text.size(), nodes, reps, none, [&]()
+            {
+                Binder::to_string(records);
+            }));
+            results.push_back(measure("revert_write", shape, text.size(), nodes, reps, none, [&]()
+            {
+                doc.serialize();
+            }));
+        }
+
+        // native numbers against the same values in literals, converted after the parse
+        if (shape == "numbers")
+        {
+            std::string quoted = Corpus::quoteNumbers(src);
+            double sum = 0;
+            results.push_back(measure("numbers_native", shape, src.size(), nodes, reps, none, [&]()
+            {
+                Parser().parse(std::string_view(src)).visitObjectData([&sum](const Object& row)
+                {
+                    row.visitObjectData([&sum](const Object& value) { sum += value.expectFloat().value_or(0); });
+                });
+            }));
+            results.push_back(measure("numbers_quoted", shape, quoted.size(), nodes, reps, none, [&]()
+            {
+                Parser().parse(std::string_view(quoted)).visitObjectData([&sum](const Object& row)
+                {
+                    row.visitObjectData([&sum](const Object& value)
+                    {
+                        std::string_view text = value.expectLiteralView().value_or("");
+                        double number = 0;
+                        std::from_chars(text.data(), text.data() + text.size(), number);
+                        sum += number;
+                    });
+                });
+            }));
+            memory.push_back({shape, "object_quoted", Parser().parse(std::string_view(quoted)).memoryUsage()});
+            std::cerr << "numbers: checksum " << sum << std::endl;
+        }
+    }
+
+    if (outFile.empty())
+        json(std::cout, results, memory, size, seed, reps);
+    else
+    {
+        std::ofstream file(outFile);
+        json(file, results, memory, size, seed, reps);
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+
+namespace lison
+{
+    static void putVarint(std::string& out, std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out += char((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += char(value);
+    }
+
+    static void putHead(std::string& out, std::uint64_t count, BinaryTag tag)
+    {
+        putVarint(out, count << 2 | tag);
+    }
+
+    // zigzag, so the small negative ones are short too
+    static void putInteger(std::string& out, std::int64_t value)
+    {
+        putHead(out, 0, Binary_Number);
+        putVarint(out, std::uint64_t(value) << 1 ^ std::uint64_t(value >> 63));
+    }
+
+    static void putFloat(std::string& out, double value)
+    {
+        putHead(out, 1, Binary_Number);
+        std::uint64_t bits = Number::toBits(value);
+        for (int i = 0; i < 8; i++, bits >>= 8)
+            out += char(bits & 0xff);
+    }
+
+    // object -> binary
+	std::string Object::to_binary() const
+	{
+		std::string out;
+		encode(out);
+		return out;
+	}
+
+	void Object::encode(std::string& out) const
+	{
+		out += Decoder::Magic;
+		// the children that are left to encode, the lists know their size up front
+		struct Frame
+		{
+			ObjectList::const_iterator it;
+			ObjectList::const_iterator end;
+		};
+		std::vector<Frame> open;
+		const Object* obj = this;
+		while (obj != nullptr)
+		{
+			auto visitor = overload
+			{
+				[&out](const Tkn_Literal& literal)
+				{
+					putHead(out, literal.value.size(), Binary_Literal);
+					out += literal.value;
+				},
+				[&out, &open](const Tkn_Object& object)
+				{
+					putHead(out, object.value.size(), Binary_List);
+					open.push_back(Frame{object.value.begin(), object.value.end()});
+				},
+				[&out](const Tkn_Error& error)
+				{
+					putHead(out, 0, Binary_Error);
+				},
+				[&out](const Tkn_Integer& number)
+				{
+					putInteger(out, number.value);
+				},
+				[&out](const Tkn_Float& number)
+				{
+					putFloat(out, number.value);
+				}
+			};
+			std::visit(visitor, obj->token);
+
+			obj = nullptr;
+			for (; !open.empty(); open.pop_back())
+			{
+				Frame& f = open.back();
+				if (f.it != f.end)
+				{
+					obj = &*f.it++;
+					break;
+				}
+			}
+		}
+	}
+
+    // document -> binary, the nodes are already in the order of the encoding
+    std::string Document::to_binary() const
+    {
+        std::string out;
+        encode(out);
+        return out;
+    }
+
+    void Document::encode(std::string& out) const
+    {
+        out += Decoder::Magic;
+        for (const Node& n : nodes)
+        {
+            switch (n.type)
+            {
+            case Node_Literal:
+                putHead(out, n.length, Binary_Literal);
+                out += literal(n);
+                break;
+            case Node_List:
+                putHead(out, n.length, Binary_List);
+                break;
+            case Node_Integer:
+                putInteger(out, std::int64_t(n.offset));
+                break;
+            case Node_Float:
+                putFloat(out, Number::fromBits(n.offset));
+                break;
+            default:
+                putHead(out, 0, Binary_Error);
+            }
+        }
+    }
+
+    // binary -> events
+    bool Decoder::detect(std::string_view src)
+    {
+        return src.substr(0, Magic.size()) == Magic;
+    }
+
+    void Decoder::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool Decoder::varint(std::uint64_t& value)
+    {
+        value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= src.size())
+                return false;
+            std::uint8_t byte = src[pos++];
+            // only the lowest bit of the 10th byte is left of the 64, and it must be the last one
+            if (shift == 63 && byte > 1)
+                return false;
+            value |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool Decoder::element(Handler& handler)
+    {
+        // children left of the open lists
+        std::vector<std::uint64_t> open;
+        while (true)
+        {
+            std::uint64_t head;
+            if (!varint(head))
+                return false;
+            std::uint64_t count = head >> 2;
+            if (!open.empty())
+                open.back()--;
+            switch (head & 3)
+            {
+            case Binary_Literal:
+                if (count > src.size() - pos)
+                    return false;
+                handler.on_literal(src.substr(pos, count));
+                pos += count;
+                break;
+            case Binary_List:
+                // every child is one byte at least, so a bigger count is broken for sure
+                if (count > src.size() - pos || open.size() >= maxDepth)
+                    return false;
+                handler.on_list_begin();
+                open.push_back(count);
+                break;
+            case Binary_Number:
+                if (count == 0)
+                {
+                    std::uint64_t zigzag;
+                    if (!varint(zigzag))
+                        return false;
+                    handler.on_integer(std::int64_t(zigzag >> 1 ^ -(zigzag & 1)));
+                }
+                else if (count == 1 && src.size() - pos >= 8)
+                {
+                    std::uint64_t bits = 0;
+                    for (int i = 7; i >= 0; i--)
+                        bits = bits << 8 | std::uint8_t(src[pos + i]);
+                    pos += 8;
+                    handler.on_float(Number::fromBits(bits));
+                }
+                else
+                    return false;
+                break;
+            case Binary_Error:
+            default:
+                // an error node: the tree was broken when it was encoded, parse reports it with on_error
+                return false;
+            }
+            for (; !open.empty() && open.back() == 0; open.pop_back())
+                handler.on_list_end();
+            if (open.empty())
+                return true;
+        }
+    }
+
+    bool Decoder::parse(std::string_view _src, Handler& handler)
+    {
+        src = _src;
+        pos = Magic.size();
+        if (!detect(src) || !element(handler))
+        {
+            handler.on_error();
+            return false;
+        }
+        handler.on_element_end();
+        return true;
+    }
+
+    Object Decoder::parse(std::string_view src)
+    {
+        ObjectBuilder builder;
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Decoder::parseDocument(std::string_view src, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(src);
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Decoder::parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        // a file that could not be opened is a broken document
+        if (!source)
+        {
+            builder.on_error();
+            return builder.take();
+        }
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(source->view(), source);
+        parse(source->view(), builder);
+        return builder.take();
+    }
+}
@@ -0,0 +1,931 @@
+/**
+ * Behavioral checks for LiSON.
+ * Every feature is checked against the plain sequential path it has to agree with
+ * (the Parser and Object::to_string), and on the edge cases it has to survive.
+ * Prints the failed checks and exits with 1 if there was any.
+ *
+ * usage: check
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include "LiSON_base.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <thread>
+#endif
+
+using namespace lison;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what)
+{
+    if (ok)
+        return;
+    failures++;
+    std::cout << "FAILED: " << what << std::endl;
+}
+
+// sources that every parser has to read the same way
+static const char* Sources[] = {
+    "( 'a' 'b c' ( 'd' ( ) ) )",
+    "('multi\n  line'\t( 'x' )('y'))",
+    "( 1 -2 0.5 1e+300 -0.0 'n' ( 42 ) )",
+    "( 9223372036854775807 -9223372036854775808 99999999999999999999 1e400 )",
+    "( 'unclosed'",
+    "( 1.5abc )",
+    "( 'a' ) )",
+    "'top' ( 'level' ) 7",
+};
+
+// the events of a parse, as text
+class Recorder : public Handler
+{
+public:
+    std::string events;
+
+    void on_list_begin() override { events += "("; }
+    void on_list_end() override { events += ")"; }
+    void on_literal(std::string_view value) override { events += "'" + std::string(value) + "'"; }
+    void on_integer(std::int64_t value) override { events += "i" + std::to_string(value); }
+    void on_float(double value) override
+    {
+        char buffer[Number::MaxLength];
+        events += "f" + std::string(Number::format(value, buffer));
+    }
+    void on_element_end() override { events += ";"; }
+    void on_error() override { events += "!"; }
+};
+
+// the Lexer reads the source in place, it has to agree with the symbol stream of the Tokenizer
+static void checkLexer()
+{
+    for (const char* src : Sources)
+    {
+        Tokenizer tokenizer;
+        std::string text(src);
+        check(Parser().parse(text).to_string(Write_Compact) == Parser().parse(tokenizer.tokenize(text)).to_string(Write_Compact),
+              std::string("lexer against tokenizer on ") + src);
+    }
+    check(Parser().parse("( 'a\n\tb'  'c' )").to_string(Write_Compact) == "('a  b' 'c')", "whitespaces folded in a literal");
+}
+
+static std::string parsed(const std::string& src)
+{
+    return Parser().parse(src).to_string(Write_Compact);
+}
+
+// the view of a node has to read the same as the object it was parsed next to
+static bool sameNode(const DocumentView& view, const Object& obj)
+{
+    if (const ObjectList* list = obj.expectObjectList())
+    {
+        if (view.type() != Node_List || view.size() != list->size())
+            return false;
+        std::size_t i = 0;
+        for (const Object& child : *list)
+        {
+            DocumentView c = view.child(i++);
+            if (c.parent().to_string() != view.to_string() || !sameNode(c, child))
+                return false;
+        }
+        return true;
+    }
+    return view.expectLiteralData() == obj.expectLiteralView()
+        && view.expectInteger() == obj.expectInteger()
+        && view.expectFloat() == obj.expectFloat();
+}
+
+static void checkDocument()
+{
+    for (const char* src : Sources)
+    {
+        Object obj = Parser().parse(src);
+        Document doc = Parser().parseDocument(src);
+        for (WriteMode mode : {Write_Padded, Write_Compact})
+            check(doc.to_string(mode) == obj.to_string(mode), std::string("document against object on ") + src);
+        check(sameNode(doc.root(), obj), std::string("document view against object on ") + src);
+        check(doc.root().toObject().to_string() == obj.to_string(), std::string("document to object on ") + src);
+        check(Document::fromObject(obj).to_string() == obj.to_string(), std::string("document from object on ") + src);
+    }
+    check(Parser().parseDocument("( 'a' ").root().type() == Node_Error, "a broken document is an error node");
+}
+
+// every implementation the CPU has must classify like the scalar loop, on any length and alignment
+static void checkScanner()
+{
+    const std::string original = Scanner::implementation();
+    const char alphabet[] = "'() \t\n\r\vab1-.\x80\xff";
+    std::string text;
+    std::uint32_t seed = 12345;
+    for (int i = 0; i < 4096; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        text += alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    std::string src;
+    for (int i = 0; i < 200; i++)
+        src += "( 'literal " + std::to_string(i) + "'\t( " + std::to_string(i * 7) + " 'x' ) )\n";
+    src = "(" + src + ")";
+
+    check(Scanner::select("scalar"), "scalar scanner is always there");
+    std::vector<BlockMasks> expected;
+    for (std::size_t at = 0; at + Scanner::BlockSize <= text.size(); at += 37)
+        for (std::size_t length : {std::size_t(0), std::size_t(1), std::size_t(31), std::size_t(63), Scanner::BlockSize})
+            expected.push_back(Scanner::classify(text.data() + at, length));
+    std::string expectedTree = parsed(src);
+
+    for (const char* name : {"avx512", "avx2", "sse2"})
+    {
+        if (!Scanner::select(name))
+            continue;
+        std::size_t i = 0;
+        bool same = true;
+        for (std::size_t at = 0; at + Scanner::BlockSize <= text.size(); at += 37)
+            for (std::size_t length : {std::size_t(0), std::size_t(1), std::size_t(31), std::size_t(63), Scanner::BlockSize})
+            {
+                BlockMasks got = Scanner::classify(text.data() + at, length);
+                const BlockMasks& want = expected[i++];
+                same = same && got.quote == want.quote && got.leftParen == want.leftParen
+                    && got.rightParen == want.rightParen && got.whitespace == want.whitespace;
+            }
+        check(same, std::string("scanner ") + name + " against scalar");
+        check(parsed(src) == expectedTree, std::string("parse with scanner ") + name);
+    }
+    Scanner::select(original);
+
+    bool inside = false;
+    std::uint64_t first = Scanner::literalMask(0x12, inside);
+    check(first == 0x0e && !inside, "literal mask inside a block");
+    std::uint64_t second = Scanner::literalMask(std::uint64_t(1) << 63, inside);
+    check(second == (std::uint64_t(1) << 63) && inside, "literal mask open at the end of a block");
+    check(Scanner::literalMask(1, inside) == 0 && !inside, "literal mask closed in the next block");
+}
+
+// a copy is deep, a move takes the children without copying them
+static void checkObjectCopy()
+{
+    Object obj = Parser().parse(Sources[0]);
+    std::string text = obj.to_string();
+    Object copy(obj);
+    copy.add(Object::fromString("e"));
+    check(obj.to_string() == text && copy.to_string() != text, "a copy doesn't share the children");
+    copy = obj;
+    check(copy.to_string() == text, "copy assignment");
+
+    const Object* first = &obj.expectObjectList()->front();
+    Object moved(std::move(obj));
+    check(moved.to_string() == text && &moved.expectObjectList()->front() == first, "a move keeps the children in place");
+    Object assigned(Token{Tkn_Error{}});
+    assigned = std::move(moved);
+    check(assigned.to_string() == text && &assigned.expectObjectList()->front() == first, "move assignment");
+}
+
+// the accessors without copying have to give what the copying ones give
+static void checkAccessors()
+{
+    Object obj = Parser().parse(Sources[2]);
+    std::vector<std::string> visited, foreach;
+    obj.visitObjectData([&visited](const Object& o) { visited.push_back(o.to_string()); });
+    obj.foreachObjectData([&foreach](const Object& o) { foreach.push_back(o.to_string()); });
+    check(!visited.empty() && visited == foreach, "visitObjectData against foreachObjectData");
+
+    bool same = true;
+    obj.visitObjectData([&same](const Object& o)
+    {
+        std::optional<std::string> data = o.expectLiteralData();
+        std::optional<std::string_view> view = o.expectLiteralView();
+        same = same && data.has_value() == view.has_value() && (!data || *data == *view);
+    });
+    check(same, "expectLiteralView against expectLiteralData");
+    check(obj.expectObjectList() && obj.expectObjectList()->size() == obj.expectObjectData()->size(),
+          "expectObjectList against expectObjectData");
+    check(!obj.expectLiteralView() && !Object::fromInteger(1).expectObjectList(), "accessors of the wrong type are empty");
+}
+
+// the one pass writers and the size in advance have to agree with to_string
+static void checkWriters()
+{
+    for (const char* src : Sources)
+    {
+        Object obj = Parser().parse(src);
+        for (WriteMode mode : {Write_Padded, Write_Compact})
+        {
+            std::string text = obj.to_string(mode);
+            std::string buffer = "prefix";
+            obj.write(buffer, mode);
+            std::ostringstream stream;
+            obj.write(stream, mode);
+            check(buffer == "prefix" + text && stream.str() == text && obj.serializedSize(mode) == text.size(),
+                  std::string("writers against to_string on ") + src);
+        }
+    }
+}
+
+// the events come in document order, and the tree built from them is the parsed tree
+static void checkHandler()
+{
+    Recorder events;
+    check(Parser().parse(Sources[2], events) && events.events == "(i1i-2f0.5f1e+300f-0.0'n'(i42));",
+          "parser events of " + std::string(Sources[2]));
+    Recorder broken;
+    check(!Parser().parse(Sources[4], broken) && broken.events == "('unclosed'!", "parser events of a broken source");
+
+    // an error in the middle of a tree is an error element, not a broken tree
+    Object obj = Parser().parse(Sources[0]);
+    obj.add(Object(Token{Tkn_Error{}}));
+    Document doc = Document::fromObject(obj);
+    check(doc.root().toObject().to_string() == obj.to_string() && obj.to_string().find("ERROR") != std::string::npos,
+          "error child kept from document to object");
+    check(Parser().parseDocument(Sources[4]).root().toObject().to_string() == Parser().parse(Sources[4]).to_string(),
+          "broken document to object");
+}
+
+// a chunk may end anywhere, even in the middle of a literal or a number
+static void checkPushParser()
+{
+    for (const char* src : Sources)
+    {
+        Recorder whole;
+        bool expected = Parser().parseSequence(src, whole);
+        Recorder pushed;
+        PushParser parser(pushed);
+        bool ok = true;
+        for (std::string_view rest(src); ok && !rest.empty(); rest.remove_prefix(1))
+            ok = parser.feed(rest.substr(0, 1));
+        ok = ok && parser.finish();
+        check(ok == expected && pushed.events == whole.events, std::string("push parser in 1 byte chunks on ") + src);
+    }
+}
+
+// the cursor has to find the same children as the parser, without parsing
+static bool sameCursor(const Cursor& cursor, const Object& obj)
+{
+    if (const ObjectList* list = obj.expectObjectList())
+    {
+        if (!cursor.isList() || cursor.size() != list->size())
+            return false;
+        Cursor c = cursor.child(0);
+        std::size_t i = 0;
+        for (const Object& child : *list)
+        {
+            if (c.raw() != cursor.child(i++).raw() || !sameCursor(c, child))
+                return false;
+            c = c.next_sibling();
+        }
+        return !c.valid();
+    }
+    return cursor.expectLiteralData() == obj.expectLiteralData()
+        && cursor.expectInteger() == obj.expectInteger()
+        && cursor.expectFloat() == obj.expectFloat();
+}
+
+static void checkCursor()
+{
+    for (const char* src : {Sources[0], Sources[1], Sources[2]})
+        check(sameCursor(Cursor(src), Parser().parse(src)), std::string("cursor against parser on ") + src);
+    Cursor cursor(Sources[1]);
+    check(cursor.child(0).literal() == std::string_view("multi\n  line")
+          && cursor.child(0).expectLiteralData() == std::string("multi   line"), "cursor literal and folded literal");
+    check(cursor.child(1).raw() == "( 'x' )" && cursor.child(2).child(0).literal() == std::string_view("y"),
+          "cursor on nested lists");
+    check(!cursor.child(3).valid() && !cursor.child(0).child(0).valid(), "cursor past the children");
+    Cursor top(Sources[7]);
+    check(top.literal() == std::string_view("top") && top.next_sibling().isList()
+          && top.next_sibling().next_sibling().expectInteger() == 7, "cursor on the top-level elements");
+}
+
+// far deeper than the stack would allow if anything recursed
+static void checkDeep()
+{
+    const std::size_t depth = 200000;
+    std::string src = std::string(depth, '(') + "'x'" + std::string(depth, ')');
+    std::string compact;
+    {
+        Object obj = Parser().parse(src);
+        compact = obj.to_string(Write_Compact);
+        check(compact == src, "deep object written back");
+        Object copy(obj);
+        check(copy.serializedSize(Write_Compact) == src.size(), "deep object copied");
+        Object other = Object::fromString("y");
+        other = copy;
+        Document doc = Document::fromObject(other);
+        check(doc.to_string(Write_Compact) == src, "deep document from object");
+    }
+    Document doc = Parser().parseDocument(src);
+    check(doc.size() == depth + 1 && doc.to_string(Write_Compact) == src, "deep document parsed");
+    check(doc.root().toObject().to_string(Write_Compact) == src, "deep document to object");
+    Parser limited;
+    limited.set_max_depth(depth - 1);
+    check(limited.parse(src).to_string(Write_Compact) == "ERROR", "depth limit");
+}
+
+// a file with the given contents, to be removed by the caller
+static std::string tempFile(const std::string& data)
+{
+    const char* name = "check.tmp";
+    std::ofstream(name, std::ios_base::out | std::ios_base::binary) << data;
+    return name;
+}
+
+// a regular file is mapped, a pipe is read once, from the descriptor that is already open
+static void checkSourceBuffer()
+{
+    std::string contents = std::string(Sources[1]) + std::string(100000, ' ') + "\r\n";
+    std::string name = tempFile(contents);
+    std::shared_ptr<const SourceBuffer> source = SourceBuffer::open(name);
+    check(source && source->view() == contents, "source buffer of a regular file");
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(LISON_NO_MMAP)
+    check(source && source->isMapped(), "regular file mapped");
+#endif
+    check(source && Parser().parseDocument(source).to_string() == Parser().parse(Sources[1]).to_string(),
+          "document borrowed from a mapped file");
+    source.reset();
+    std::remove(name.c_str());
+    check(!SourceBuffer::open("check.missing"), "missing file");
+
+#if defined(__unix__) || defined(__APPLE__)
+    const char* fifo = "check.fifo";
+    std::remove(fifo);
+    if (mkfifo(fifo, 0600) != 0)
+        return;
+    std::thread writer([fifo]()
+    {
+        std::ofstream(fifo) << "( 'piped' )";
+    });
+    source = SourceBuffer::open(fifo);
+    writer.join();
+    check(source && source->view() == "( 'piped' )" && !source->isMapped(), "source buffer of a fifo");
+    std::remove(fifo);
+#endif
+}
+
+// a borrowed document reads the literals from the source until it is materialized
+static void checkBorrowed()
+{
+    std::string text;
+    Document doc;
+    {
+        std::string src = Sources[0];
+        text = Parser().parse(src).to_string();
+        Document owned = Parser().parseDocument(src);
+        doc = Parser().parseDocument(src, Document_Borrowed);
+        check(!owned.borrowed() && doc.borrowed(), "borrowed documents");
+        check(doc.to_string() == text && owned.to_string() == text, "borrowed document against owned");
+        doc.materialize();
+        check(!doc.borrowed(), "materialized document");
+        src.assign(src.size(), 'x');
+    }
+    check(doc.to_string() == text, "materialized document outlives the source");
+
+    // the literals with folded whitespaces can't be borrowed
+    Document folded = Parser().parseDocument(Sources[1], Document_Borrowed);
+    check(folded.to_string() == Parser().parse(Sources[1]).to_string(), "borrowed document with folded literals");
+}
+
+// a class that only makes an Object
+class Pair : public LiSON
+{
+public:
+    std::string name;
+    std::int64_t value = 0;
+protected:
+    void interpret(const Object& obj) override
+    {
+        const ObjectList* list = obj.expectObjectList();
+        if (!list || list->size() != 2)
+            return;
+        name = list->front().expectLiteralData().value_or("");
+        value = list->back().expectInteger().value_or(0);
+    }
+
+    Object revert() const override
+    {
+        Object obj(Token{Tkn_Object{}});
+        obj.add(Object::fromString(name));
+        obj.add(Object::fromInteger(value));
+        return obj;
+    }
+};
+
+// the same class, written straight to the writer
+class EmittedPair : public Pair
+{
+protected:
+    void emit(Writer& writer) const override
+    {
+        writer.begin_list();
+        writer.literal(name);
+        writer.integer(value);
+        writer.end_list();
+    }
+
+    Object revert() const override
+    {
+        return emitted();
+    }
+};
+
+static void checkEmit()
+{
+    Pair pair;
+    EmittedPair emitted;
+    pair.deserialize("( 'some name' 42 )");
+    emitted.deserialize("( 'some name' 42 )");
+    std::string text = Parser().parse("( 'some name' 42 )").to_string();
+    check(pair.serialize() == text && emitted.serialize() == text, "serialize with and without emit");
+    check(Object::fromLiSON(emitted).to_string() == text, "revert of the emitted object");
+    for (WriteMode mode : {Write_Padded, Write_Compact})
+    {
+        std::ostringstream stream;
+        emitted.serialize(stream, mode);
+        std::string out;
+        StringWriter writer(out, mode);
+        pair.serialize(writer);
+        check(stream.str() == Object::fromLiSON(pair).to_string(mode) && out == stream.str(), "serialize to a stream and a writer");
+    }
+
+    // reformatting without a tree
+    for (const char* src : Sources)
+    {
+        std::string out;
+        StringWriter writer(out, Write_Compact);
+        WriteHandler handler(writer);
+        if (Parser().parse(src, handler))
+            check(out == parsed(src), std::string("write handler on ") + src);
+    }
+}
+
+// the binary encoding gives back the same tree, and is read from a file without any conversion
+static void checkBinary()
+{
+    for (const char* src : Sources)
+    {
+        Object obj = Parser().parse(src);
+        if (std::holds_alternative<Tkn_Error>(obj.token))
+            continue;
+        std::string text = obj.to_string(Write_Compact);
+        check(Decoder().parse(obj.to_binary()).to_string(Write_Compact) == text,
+              std::string("object binary round trip of ") + src);
+        Document doc = Parser().parseDocument(src);
+        check(Decoder().parseDocument(doc.to_binary()).to_string(Write_Compact) == text,
+              std::string("document binary round trip of ") + src);
+    }
+    // an error node breaks the decoded tree like ERROR breaks the text
+    Object broken(Token{Tkn_Object{}});
+    broken.add(Object::fromString("x"));
+    broken.add(Object(Token{Tkn_Error{}}));
+    check(std::holds_alternative<Tkn_Error>(Decoder().parse(broken.to_binary()).token), "binary error node");
+    check(!Decoder().parse(std::string("\0LSB\1\x05", 6)).expectObjectList(), "truncated binary");
+    // a head of 10 bytes only has room for one more bit in the last one
+    std::string magic(Decoder::Magic);
+    check(Decoder().parse(magic + std::string(9, '\x80') + '\x00').expectLiteralData() == std::string(), "longest varint");
+    check(!Decoder().parse(magic + std::string(9, '\x80') + '\x02').expectLiteralData(), "varint over 64 bits");
+
+    // the line ends in the literals are bytes of the encoding, they must not be converted
+    Pair pair;
+    pair.name = "line\r\nend\n\r";
+    pair.value = 0x0d0a;
+    std::string name = tempFile("");
+    Serializer serializer(name);
+    serializer.encode(Object::fromLiSON(pair));
+    Pair decoded;
+    decoded.deserialize(serializer);
+    check(decoded.name == pair.name && decoded.value == pair.value, "deserialize an encoded file");
+    ObjectBuilder builder;
+    check(serializer.read(builder) && builder.take().to_string() == Object::fromLiSON(pair).to_string(), "serializer binary read");
+    std::remove(name.c_str());
+
+    // a file that can't be opened is an error, not a crash
+    std::shared_ptr<const SourceBuffer> missing = Serializer("check.missing").map();
+    check(Parser().parseDocument(missing).root().type() == Node_Error, "parser null source");
+    check(Decoder().parseDocument(missing).root().type() == Node_Error, "decoder null source");
+}
+
+// a snapshot reads back the document it was saved from, and a broken file only gives invalid views
+static void checkSnapshot()
+{
+    std::string name = tempFile("");
+    for (const char* src : Sources)
+    {
+        Document doc = Parser().parseDocument(src);
+        if (doc.root().type() == Node_Error)
+            continue;
+        std::string text = doc.to_string(Write_Compact);
+        Serializer(name).snapshot(doc);
+        Snapshot snap = Snapshot::open(name);
+        check(snap.valid() && snap.size() == doc.size() && snap.to_string(Write_Compact) == text,
+              std::string("snapshot round trip of ") + src);
+        check(snap.valid() && snap.root().toObject().to_string(Write_Compact) == text,
+              std::string("snapshot to object of ") + src);
+        check(snap.root().size() == doc.root().size() && snap.root().child(0).to_string() == doc.root().child(0).to_string(),
+              std::string("snapshot view of ") + src);
+    }
+
+    std::string saved = Parser().parseDocument(Sources[0]).to_snapshot();
+    for (std::size_t length : {std::size_t(0), std::size_t(3), saved.size() / 2, saved.size() - 1})
+    {
+        Snapshot snap = Snapshot::open(tempFile(saved.substr(0, length)));
+        check(!snap.valid() && !snap.root().valid() && snap.to_string().empty(), "truncated snapshot");
+    }
+    check(!Snapshot::open(tempFile(Sources[0])).valid(), "text file is not a snapshot");
+    check(!Snapshot::open("check.missing").valid(), "missing snapshot");
+    std::remove(name.c_str());
+}
+
+// a big list generated for the threads
+static std::string rows(int count)
+{
+    std::string src = "(";
+    for (int i = 0; i < count; i++)
+        src += " ( " + std::to_string(i * 7919 - 100000) + " 'row " + std::to_string(i) + "' ( 'x' 0.25 ) )";
+    return src + " )";
+}
+
+// the threads give the same tree as the sequential parser
+static void checkParallelParser()
+{
+    std::string src = rows(50000);
+    std::string expected = parsed(src);
+    ParallelParser parser;
+    parser.set_threads(4);
+    parser.set_chunk_size(4096);
+    check(parser.parse(src).to_string(Write_Compact) == expected, "parallel parse");
+    check(parser.parseDocument(src).to_string(Write_Compact) == expected, "parallel parse document");
+    Document borrowed = parser.parseDocument(src, Document_Borrowed);
+    check(borrowed.borrowed() && borrowed.to_string(Write_Compact) == expected, "parallel parse borrowed document");
+    check(borrowed.root().size() == 50000 && borrowed.root().child(49999).parent().size() == 50000, "parallel document nodes");
+    for (const char* source : Sources)
+        check(parser.parse(source).to_string() == Parser().parse(source).to_string(), std::string("parallel parse of ") + source);
+    std::string broken = src;
+    broken[src.size() / 2] = ')';
+    check(parser.parse(broken).to_string() == Parser().parse(broken).to_string(), "parallel parse error in a range");
+    check(ParallelParser().parseDocument(std::shared_ptr<const SourceBuffer>()).root().type() == Node_Error,
+          "parallel parser null source");
+}
+
+// the threads write the same bytes as Object::write
+static void checkParallelWriter()
+{
+    Object obj = Parser().parse(rows(50000));
+    // a deep spine with wide lists in it, split at several levels
+    Object nested = Parser().parse("( 'head' " + rows(3000) + " ( " + rows(2000) + " 'tail' ) )");
+    ParallelWriter writer;
+    writer.set_threads(4);
+    writer.set_min_elements(16);
+    std::string name = tempFile("");
+    for (const Object* o : {&obj, &nested})
+        for (WriteMode mode : {Write_Padded, Write_Compact})
+        {
+            std::string text = o->to_string(mode);
+            check(writer.to_string(*o, mode) == text, "parallel write");
+            check(writer.write(*o, name, mode), "parallel write to a file");
+            std::shared_ptr<const SourceBuffer> file = SourceBuffer::open(name);
+            check(file && file->view() == text, "parallel write to a file");
+        }
+    for (const char* src : Sources)
+        check(writer.to_string(Parser().parse(src)) == Parser().parse(src).to_string(), std::string("parallel write of ") + src);
+    std::remove(name.c_str());
+}
+
+// the documents come in the order of their lines, whatever thread parsed them
+static void checkLines()
+{
+    std::stringstream stream;
+    LinesWriter writer(stream);
+    std::size_t count = 3 * LinesReader::BatchLines + 7;
+    for (std::size_t i = 0; i < count; i++)
+        writer.write(Parser().parse("( '" + std::to_string(i) + "' 'a\nb' " + std::to_string(i) + " )"));
+    writer.flush();
+    std::string lines = stream.str();
+
+    std::stringstream in(lines);
+    std::size_t next = 0;
+    bool ordered = true;
+    std::size_t read = LinesReader(in).forEach([&](std::size_t line, Object&& obj)
+    {
+        const ObjectList* list = obj.expectObjectList();
+        ordered = ordered && line == next + 1 && list && list->back().expectInteger() == std::int64_t(next);
+        next++;
+    }, 4);
+    check(read == count && ordered, "lines reader order");
+
+    std::stringstream unordered(lines);
+    std::vector<bool> seen(count, false);
+    read = LinesReader(unordered).forEach([&](std::size_t line, Object&& obj)
+    {
+        seen[line - 1] = obj.expectObjectList() != nullptr;
+    }, 4, false);
+    check(read == count && std::find(seen.begin(), seen.end(), false) == seen.end(), "lines reader out of order");
+
+    std::stringstream single(lines);
+    LinesReader reader(single);
+    Object obj(Token{Tkn_Error{}});
+    check(reader.next(obj) && reader.line() == 1 && obj.to_string(Write_Compact) == "('0' 'a b' 0)", "lines reader next");
+
+    // blank lines are skipped, a broken line is an error on its own
+    std::stringstream mixed("( 'a' )\n\n( 'b'\n'c'\n");
+    LinesReader mixedReader(mixed);
+    bool first = mixedReader.next(obj) && obj.to_string(Write_Compact) == "('a')";
+    bool second = mixedReader.next(obj) && mixedReader.line() == 3 && std::holds_alternative<Tkn_Error>(obj.token);
+    bool third = mixedReader.next(obj) && obj.to_string(Write_Compact) == "'c'" && !mixedReader.next(obj);
+    check(first && second && third, "lines reader on blank and broken lines");
+}
+
+#ifdef LISON_TRACE
+// counts the ends of the stages next to the metrics
+class StageCounter : public Trace
+{
+public:
+    std::uint64_t ends = 0;
+    void on_stage(Stage, std::uint64_t, std::uint64_t) override { ends++; }
+};
+#endif
+
+// the stages of a round trip are measured, with the shape of the source
+static void checkTrace()
+{
+#ifdef LISON_TRACE
+    StageCounter trace;
+    Pair pair;
+    pair.set_trace(&trace);
+    pair.deserialize("( 'some name' ( 42 ) )");
+    const Metrics& m = trace.metrics;
+    check(m.stages[Stage_Parse].calls == 1 && m.stages[Stage_Interpret].calls == 1
+          && m.stages[Stage_Parse].bytes == std::string("( 'some name' ( 42 ) )").size(), "trace of deserialize");
+    check(m.nodes == 4 && m.maxDepth == 2 && m.literalBytes == 9, "trace of the parsed source");
+
+    // the LiSON measures its own stages through the serializer
+    std::string name = tempFile("");
+    Serializer serializer(name);
+    serializer.write(pair);
+    pair.deserialize(serializer);
+    check(m.stages[Stage_Write].calls == 1 && m.stages[Stage_Revert].calls == 1 && m.stages[Stage_Read].calls == 1
+          && m.stages[Stage_Parse].calls == 2 && m.stages[Stage_Interpret].calls == 2, "trace of a file round trip");
+    std::uint64_t calls = 0;
+    for (const StageMetrics& stage : m.stages)
+        calls += stage.calls;
+    check(trace.ends == calls, "every stage ends once");
+    trace.reset();
+    check(trace.metrics.nodes == 0 && trace.metrics.stages[Stage_Parse].calls == 0, "trace reset");
+
+    // and the serializer its own
+    Trace reading;
+    serializer.set_trace(&reading);
+    ObjectBuilder builder;
+    check(serializer.read(builder) && reading.metrics.stages[Stage_Parse].calls == 1 && reading.metrics.nodes == 3,
+          "trace of a serializer read");
+    std::remove(name.c_str());
+#endif
+}
+
+// the reports count the same tree the same way, whatever holds it
+static void checkMemory()
+{
+    MemoryReport report = Parser().parse(Sources[0]).memoryUsage();
+    check(report.nodes == 6 && report.lists == 3 && report.literals == 3 && report.literalBytes == 5,
+          "memory report of an object");
+    check(report.heapBytes > 0 && report.totalBytes() >= report.literalBytes + report.containerBytes, "memory report bytes");
+    for (const char* src : Sources)
+    {
+        MemoryReport object = Parser().parse(src).memoryUsage();
+        MemoryReport document = Parser().parseDocument(src).memoryUsage();
+        check(object.nodes == document.nodes && object.lists == document.lists && object.literals == document.literals
+              && object.literalBytes == document.literalBytes, std::string("memory report of a document of ") + src);
+    }
+
+    if (!Allocations::enabled())
+        return;
+    AllocationStats before = Allocations::stats();
+    {
+        std::string* buffer = new std::string(1000, 'x');
+        AllocationStats during = Allocations::stats();
+        check(during.allocations >= before.allocations + 2 && during.allocatedBytes >= before.allocatedBytes + 1000
+              && during.liveBytes >= before.liveBytes + 1000, "allocations counted");
+        delete buffer;
+    }
+    AllocationStats after = Allocations::stats();
+    check(after.deallocations >= before.deallocations + 2 && after.liveBytes == before.liveBytes
+          && after.peakBytes >= before.liveBytes + 1000, "deallocations counted");
+    Allocations::reset_peak();
+    check(Allocations::stats().peakBytes == Allocations::stats().liveBytes, "peak reset");
+#ifdef LISON_TRACE
+    Trace trace;
+    Pair pair;
+    pair.set_trace(&trace);
+    pair.deserialize("( 'a name that is not short' 42 )");
+    check(trace.metrics.stages[Stage_Parse].allocations > 0 && trace.metrics.stages[Stage_Parse].allocatedBytes > 0,
+          "allocations of a stage");
+#endif
+}
+
+// a memory resource that counts what is allocated from it
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    std::size_t allocations = 0;
+    std::size_t live = 0;
+    std::pmr::monotonic_buffer_resource arena;
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        allocations++;
+        live += bytes;
+        return arena.allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override
+    {
+        live -= bytes;
+        arena.deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+// a tree parsed into an arena is the tree parsed on the heap, and takes all its memory from the arena
+static void checkArena()
+{
+    // a literal too long for the small string buffer too
+    std::string src = "( " + rows(1000) + " '" + std::string(200, 'l') + "' )";
+    CountingResource arena;
+    {
+        Parser parser;
+        parser.set_memory_resource(&arena);
+        Object obj = parser.parse(src);
+        check(obj.to_string() == Parser().parse(src).to_string() && arena.allocations > 1000, "object parsed into an arena");
+        Object copy(obj);
+        std::size_t used = arena.allocations;
+        copy.add(Object::fromString("new"));
+        check(arena.allocations == used && copy.to_string() != obj.to_string(), "copies go to the default resource");
+    }
+    check(arena.live == 0, "arena tree released");
+
+    ObjectBuilder builder(&arena);
+    Parser().parse(Sources[0], builder);
+    Object built = builder.take();
+    check(built.to_string() == Parser().parse(Sources[0]).to_string() && arena.live > 0, "object builder in an arena");
+}
+
+// the interned literals read the same, and a key is found by its id
+static void checkSymbols()
+{
+    SymbolTable table;
+    std::uint32_t a = table.intern("a");
+    check(table.intern("b") != a && table.intern("a") == a && table.size() == 2, "symbol ids");
+    check(table.find("a") == a && !table.find("c") && table.name(a) == "a", "symbol lookup");
+
+    auto symbols = std::make_shared<SymbolTable>();
+    Parser parser;
+    parser.set_symbols(symbols);
+    std::string src = "( ( 'key' 'x' ) ( 'key' 'y' ) ( 'other' '" + std::string(SymbolTable::MaxLength + 1, 'l') + "' ) )";
+    Document doc = parser.parseDocument(src);
+    check(doc.symbols() == symbols.get() && doc.to_string() == Parser().parse(src).to_string()
+          && parser.parseDocument(Sources[0]).to_string() == Parser().parse(Sources[0]).to_string(),
+          "documents with interned literals");
+    std::optional<std::uint32_t> key = symbols->find("key");
+    DocumentView root = doc.root();
+    check(key && root.child(0).child(0).symbol() == key && root.child(1).child(0).symbol() == key
+          && root.child(2).child(0).symbol() != key, "symbol ids compared");
+    check(!root.child(2).child(1).symbol() && root.child(2).child(1).expectLiteralData()->size() == SymbolTable::MaxLength + 1,
+          "long literal not interned");
+
+    std::string text = doc.to_string();
+    doc.materialize();
+    symbols.reset();
+    parser.set_symbols(nullptr);
+    check(!doc.symbols() && doc.to_string() == text, "materialized document without the table");
+}
+
+struct Point
+{
+    int x = 0;
+    int y = 0;
+};
+
+struct Shape
+{
+    std::string name;
+    bool closed = false;
+    double scale = 1;
+    std::vector<Point> points;
+};
+
+LISON_SCHEMA(Point, lison::field("x", &Point::x), lison::field("y", &Point::y));
+LISON_SCHEMA(Shape, lison::field("name", &Shape::name), lison::field("closed", &Shape::closed),
+             lison::field("scale", &Shape::scale), lison::field("points", &Shape::points));
+
+// the bindings write what they read
+static void checkBindings()
+{
+    Shape shape{"tri", true, 0.5, {{1, 2}, {3, 4}, {-5, 6}}};
+    std::string text = Binder::to_string(shape, Write_Compact);
+    check(text == "(('name' 'tri') ('closed' 'true') ('scale' 0.5) ('points' ((('x' 1) ('y' 2)) (('x' 3) ('y' 4)) (('x' -5) ('y' 6)))))",
+          "binder write");
+    check(parsed(text) == text, "binder write parses back");
+    Shape back;
+    check(Binder::read(text, back) && back.name == "tri" && back.closed && back.scale == 0.5
+          && back.points.size() == 3 && back.points[2].x == -5, "binder read");
+
+    // the fields in any order, the unknown ones skipped
+    Point p;
+    check(Binder::read("(('y' '6') ('v' 'q') ('u' ('deep' ( '1' ))) ('x' 5))", p) && p.x == 5 && p.y == 6,
+          "binder skips unknown fields");
+    check(Binder::read("(('closed' 'false') ('name' 'sq'))", back) && !back.closed && back.name == "sq", "binder bool");
+    check(!Binder::read("(('closed' 'maybe'))", back), "binder rejects a literal that is not a bool");
+    check(!Binder::read("(('x' 'abc'))", p), "binder rejects a literal that is not a number");
+    check(!Binder::read("(('x' 1)", p), "binder rejects an unclosed list");
+
+    std::string name = tempFile(text);
+    Shape loaded;
+    check(Binder::load(Serializer(name), loaded) && Binder::to_string(loaded, Write_Compact) == text, "binder load");
+    std::remove(name.c_str());
+    check(!Binder::load(Serializer("check.missing"), loaded), "binder load of a missing file");
+}
+
+// the numbers round-trip exactly, the ones that can't are kept as literals of their text
+static void checkNumbers()
+{
+    const char* src = "( 0 -1 9223372036854775807 -9223372036854775808 0.1 1e+300 -0.0 100.0 2.5e-07 )";
+    Object obj = Parser().parse(src);
+    check(obj.to_string(Write_Compact) == "(0 -1 9223372036854775807 -9223372036854775808 0.1 1e+300 -0.0 100.0 2.5e-07)",
+          "numbers round trip");
+    check(obj.serializedSize() == obj.to_string().size(), "numbers serialized size");
+    const ObjectList* list = obj.expectObjectList();
+    check(list && list->front().expectInteger() == 0 && !list->front().expectLiteralView(), "integer type");
+    check(list && std::signbit(*std::next(list->begin(), 6)->expectFloat()), "negative zero");
+
+    check(parsed("(99999999999999999999 1e400)") == "('99999999999999999999' '1e400')", "large numbers written back quoted");
+    check(parsed("( 1.5abc )") == "ERROR", "not a number");
+    check(parsed("( inf )") == "ERROR", "inf is not a number");
+    check(Object::fromFloat(INFINITY).to_string(Write_Compact) == "'inf'", "infinity written as a literal");
+    check(Object::fromFloat(NAN).serializedSize(Write_Compact) == Object::fromFloat(NAN).to_string(Write_Compact).size(),
+          "nan serialized size");
+
+    Cursor cursor(src);
+    check(cursor.child(2).expectInteger() == std::numeric_limits<std::int64_t>::max() && cursor.child(2).isNumber(),
+          "cursor integer");
+    check(cursor.child(4).expectFloat() == 0.1 && !cursor.child(4).expectInteger(), "cursor float");
+    check(cursor.size() == 9, "cursor size");
+    // the large ones are literals for the cursor too
+    Cursor large(Sources[3]);
+    for (std::size_t i : {2, 3})
+    {
+        Cursor c = large.child(i);
+        Object parsedChild = *std::next(Parser().parse(Sources[3]).expectObjectList()->begin(), i);
+        check(!c.isNumber() && c.isLiteral() && c.literal() == std::optional<std::string_view>(c.raw())
+              && c.expectLiteralData() == parsedChild.expectLiteralData() && !c.expectInteger() && !c.expectFloat(),
+              "cursor large number as a literal");
+    }
+    check(!Cursor("( 1.5abc )").child(0).isNumber() && !Cursor("( 1.5abc )").child(0).literal(), "cursor not a number");
+
+    PullParser pull(src);
+    check(pull.next() == Pull_ListBegin && pull.next() == Pull_Integer && pull.integer() == 0, "pull integer");
+
+    Point p;
+    check(Binder::read("(('x' 5) ('z' 42) ('w' 4.5) ('v' 99999999999999999999) ('y' 6))", p) && p.x == 5 && p.y == 6,
+          "binder skips unknown numeric fields");
+    check(!Binder::read("(('x' 4.5))", p), "binder rejects a float for an int");
+    check(!Binder::read("(('x' 99999999999))", p), "binder rejects an int out of range");
+}
+
+int main()
+{
+    checkLexer();
+    checkDocument();
+    checkScanner();
+    checkObjectCopy();
+    checkAccessors();
+    checkWriters();
+    checkHandler();
+    checkPushParser();
+    checkCursor();
+    checkDeep();
+    checkSourceBuffer();
+    checkBorrowed();
+    checkEmit();
+    checkBinary();
+    checkSnapshot();
+    checkParallelParser();
+    checkParallelWriter();
+    checkLines();
+    checkTrace();
+    checkMemory();
+    checkArena();
+    checkSymbols();
+    checkBindings();
+    checkNumbers();
+    if (failures > 0)
+    {
+        std::cout << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all checks passed" << std::endl;
+    return 0;
+}
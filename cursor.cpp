@@ -0,0 +1,203 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <algorithm>
+
+namespace lison
+{
+    Cursor::Cursor(std::string_view _src)
+        : src(_src)
+    {
+        pos = element(0);
+    }
+
+    Cursor::Cursor(std::string_view _src, std::size_t _pos)
+        : src(_src), pos(_pos)
+    {}
+
+    std::size_t Cursor::element(std::size_t from) const
+    {
+        while (from < src.length())
+        {
+            char c = src[from];
+            if (c == '(' || c == '\'' || c == '-' || (c >= '0' && c <= '9'))
+                return from;
+            if (c != ' ' && c != '\t' && c != '\n')
+                return std::string_view::npos;
+            ++from;
+        }
+        return std::string_view::npos;
+    }
+
+    std::size_t Cursor::skip(std::size_t from) const
+    {
+        if (src[from] == '\'')
+        {
+            std::size_t end = src.find('\'', from + 1);
+            return end == std::string_view::npos ? src.length() : end + 1;
+        }
+        if (src[from] != '(')
+        {
+            // a number runs until a structural symbol or a whitespace
+            std::size_t end = src.find_first_of("()' \t\n", from);
+            return end == std::string_view::npos ? src.length() : end;
+        }
+        // a list: the parens are counted a block at a time, the ones in literals don't count
+        std::size_t depth = 0;
+        bool inside = false;
+        for (std::size_t block = from - from % Scanner::BlockSize; block < src.length(); block += Scanner::BlockSize)
+        {
+            BlockMasks m = Scanner::classify(src.data() + block,
+                                             std::min(Scanner::BlockSize, src.length() - block));
+            if (block < from)
+            {
+                std::uint64_t after = ~std::uint64_t(0) << (from - block);
+                m.quote &= after;
+                m.leftParen &= after;
+                m.rightParen &= after;
+            }
+            std::uint64_t outside = ~Scanner::literalMask(m.quote, inside);
+            std::uint64_t left = m.leftParen & outside;
+            std::uint64_t parens = left | (m.rightParen & outside);
+            while (parens != 0)
+            {
+                int bit = __builtin_ctzll(parens);
+                if ((left >> bit) & 1)
+                    depth++;
+                else if (--depth == 0)
+                    return block + bit + 1;
+                parens &= parens - 1;
+            }
+        }
+        return src.length();
+    }
+
+    bool Cursor::valid() const
+    {
+        return pos < src.length();
+    }
+
+    bool Cursor::isList() const
+    {
+        return valid() && src[pos] == '(';
+    }
+
+    NumberType Cursor::number(std::int64_t& integer, double& floating) const
+    {
+        if (!valid() || src[pos] == '(' || src[pos] == '\'')
+            return Number_None;
+        return Number::parse(raw(), integer, floating);
+    }
+
+    bool Cursor::isLiteral() const
+    {
+        std::int64_t integer;
+        double floating;
+        return valid() && (src[pos] == '\'' || number(integer, floating) == Number_Large);
+    }
+
+    bool Cursor::isNumber() const
+    {
+        std::int64_t integer;
+        double floating;
+        NumberType type = number(integer, floating);
+        return type == Number_Integer || type == Number_Float;
+    }
+
+    Cursor Cursor::child(std::size_t i) const
+    {
+        if (!isList())
+            return Cursor();
+        Cursor c(src, element(pos + 1));
+        for (; c.valid() && i > 0; i--)
+            c = c.next_sibling();
+        return c;
+    }
+
+    Cursor Cursor::next_sibling() const
+    {
+        if (!valid())
+            return Cursor();
+        // a closing paren (or anything else) after the element means there is no sibling
+        return Cursor(src, element(skip(pos)));
+    }
+
+    std::size_t Cursor::size() const
+    {
+        std::size_t n = 0;
+        for (Cursor c = child(0); c.valid(); c = c.next_sibling())
+            n++;
+        return n;
+    }
+
+    std::optional<std::string_view> Cursor::literal() const
+    {
+        // a number out of range is a literal of its text, as the parser reads it
+        if (valid() && src[pos] != '\'')
+        {
+            std::int64_t integer;
+            double floating;
+            if (number(integer, floating) == Number_Large)
+                return {raw()};
+            return {};
+        }
+        std::size_t end = src.find('\'', pos + 1);
+        if (end == std::string_view::npos)
+            return {};
+        return {src.substr(pos + 1, end - pos - 1)};
+    }
+
+    std::optional<std::string> Cursor::expectLiteralData() const
+    {
+        std::optional<std::string_view> body = literal();
+        if (!body)
+            return {};
+        std::string buffer;
+        return {std::string(Lexer::fold(*body, buffer))};
+    }
+
+    std::optional<std::int64_t> Cursor::expectInteger() const
+    {
+        std::int64_t integer;
+        double floating;
+        if (number(integer, floating) != Number_Integer)
+            return {};
+        return {integer};
+    }
+
+    std::optional<double> Cursor::expectFloat() const
+    {
+        std::int64_t integer;
+        double floating;
+        switch (number(integer, floating))
+        {
+        case Number_Integer:
+            return {double(integer)};
+        case Number_Float:
+            return {floating};
+        default:
+            return {};
+        }
+    }
+
+    std::string_view Cursor::raw() const
+    {
+        if (!valid())
+            return {};
+        return src.substr(pos, skip(pos) - pos);
+    }
+}
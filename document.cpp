@@ -0,0 +1,442 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <cmath>
+#include <limits>
+
+namespace lison
+{
+    // view
+    DocumentView::DocumentView(const Document* _doc, std::uint32_t _index)
+        : doc(_doc), index(_index)
+    {}
+
+    bool DocumentView::valid() const
+    {
+        return doc != nullptr && index < doc->nodes.size();
+    }
+
+    NodeType DocumentView::type() const
+    {
+        if (!valid())
+            return Node_Error;
+        return doc->nodes[index].type;
+    }
+
+    std::size_t DocumentView::size() const
+    {
+        if (type() != Node_List)
+            return 0;
+        return doc->nodes[index].length;
+    }
+
+    DocumentView DocumentView::child(std::size_t i) const
+    {
+        if (i >= size())
+            return DocumentView();
+        // the first child is right after the list, the others are after the previous subtree
+        std::uint32_t c = index + 1;
+        for (; i > 0; i--)
+            c = doc->nodes[c].next;
+        return DocumentView(doc, c);
+    }
+
+    DocumentView DocumentView::parent() const
+    {
+        if (!valid())
+            return DocumentView();
+        return DocumentView(doc, doc->nodes[index].parent);
+    }
+
+    std::string DocumentView::to_string(WriteMode mode) const
+    {
+        std::string out;
+        if (valid())
+            doc->write(index, doc->nodes[index].next, out, mode);
+        return out;
+    }
+
+    Object DocumentView::toObject() const
+    {
+        if (!valid())
+            return Object(Token{Tkn_Error{}});
+        ObjectBuilder builder;
+        doc->write(index, doc->nodes[index].next, builder);
+        return builder.take();
+    }
+
+    void DocumentView::foreachObjectData(
+        std::function<void(const DocumentView&)> f) const
+    {
+        visitObjectData(f);
+    }
+
+    std::optional<std::string_view> DocumentView::expectLiteralData() const
+    {
+        if (type() != Node_Literal)
+            return {};
+        const Node& n = doc->nodes[index];
+        return {doc->literal(n)};
+    }
+
+    std::optional<std::int64_t> DocumentView::expectInteger() const
+    {
+        if (type() != Node_Integer)
+            return {};
+        return {std::int64_t(doc->nodes[index].offset)};
+    }
+
+    std::optional<double> DocumentView::expectFloat() const
+    {
+        if (type() == Node_Float)
+            return {Number::fromBits(doc->nodes[index].offset)};
+        if (type() == Node_Integer)
+            return {double(std::int64_t(doc->nodes[index].offset))};
+        return {};
+    }
+
+    std::optional<std::uint32_t> DocumentView::symbol() const
+    {
+        if (type() != Node_Literal)
+            return {};
+        const Node& n = doc->nodes[index];
+        if (!(n.flags & Node_Interned))
+            return {};
+        return {std::uint32_t(n.offset)};
+    }
+
+    // document
+    Document Document::fromObject(const Object& obj)
+    {
+        Document doc;
+        // the lists being filled, with the next child to add
+        struct Frame
+        {
+            std::uint32_t index;
+            ObjectList::const_iterator it;
+            ObjectList::const_iterator end;
+        };
+        std::vector<Frame> open;
+        const Object* o = &obj;
+        std::uint32_t parent = 0;
+        while (o != nullptr)
+        {
+            std::uint32_t idx = doc.nodes.size();
+            doc.nodes.push_back(Node{Node_Error, 0, parent, idx + 1, 0, 0});
+            if (parent != idx)
+                doc.nodes[parent].length++;
+            auto visitor = overload
+            {
+                [&doc, idx](const Tkn_Literal& literal)
+                {
+                    Node& n = doc.nodes[idx];
+                    n.type = Node_Literal;
+                    n.offset = doc.pool.size();
+                    n.length = literal.value.length();
+                    doc.pool += literal.value;
+                },
+                [&doc, &open, idx](const Tkn_Object& object)
+                {
+                    doc.nodes[idx].type = Node_List;
+                    open.push_back(Frame{idx, object.value.begin(), object.value.end()});
+                },
+                [](const Tkn_Error& error)
+                {},
+                [&doc, idx](const Tkn_Integer& number)
+                {
+                    doc.nodes[idx].type = Node_Integer;
+                    doc.nodes[idx].offset = number.value;
+                },
+                [&doc, idx](const Tkn_Float& number)
+                {
+                    doc.nodes[idx].type = Node_Float;
+                    doc.nodes[idx].offset = Number::toBits(number.value);
+                }
+            };
+            std::visit(visitor, o->token);
+
+            o = nullptr;
+            while (!open.empty())
+            {
+                Frame& f = open.back();
+                if (f.it != f.end)
+                {
+                    o = &*f.it++;
+                    parent = f.index;
+                    break;
+                }
+                doc.nodes[f.index].next = doc.nodes.size();
+                open.pop_back();
+            }
+        }
+        return doc;
+    }
+
+    DocumentView Document::root() const
+    {
+        return DocumentView(this, 0);
+    }
+
+    std::size_t Document::size() const
+    {
+        return nodes.size();
+    }
+
+    std::string_view Document::literal(const Node& n) const
+    {
+        if (n.flags & Node_Interned)
+            return symbolTable->name(n.offset);
+        if (n.flags & Node_Borrowed)
+            return source.substr(n.offset, n.length);
+        return std::string_view(pool).substr(n.offset, n.length);
+    }
+
+    bool Document::borrowed() const
+    {
+        return !source.empty();
+    }
+
+    const SymbolTable* Document::symbols() const
+    {
+        return symbolTable.get();
+    }
+
+    void Document::materialize()
+    {
+        // an interned literal is copied only once, the nodes of the same id share it
+        std::vector<std::uint64_t> interned(symbolTable ? symbolTable->size() : 0, pool.npos);
+        for (Node& n : nodes)
+        {
+            if (n.flags & Node_Interned)
+            {
+                std::uint64_t& offset = interned[n.offset];
+                if (offset == pool.npos)
+                {
+                    offset = pool.size();
+                    pool += literal(n);
+                }
+                n.offset = offset;
+                n.flags &= ~Node_Interned;
+            }
+            else if (n.flags & Node_Borrowed)
+            {
+                std::string_view value = literal(n);
+                n.offset = pool.size();
+                n.flags &= ~Node_Borrowed;
+                pool += value;
+            }
+        }
+        source = {};
+        owner.reset();
+        symbolTable.reset();
+    }
+
+    std::string Document::to_string(WriteMode mode) const
+    {
+        std::string out;
+        write(0, nodes.size(), out, mode);
+        return out;
+    }
+
+    void Document::write(std::uint32_t from, std::uint32_t to, std::string& out, WriteMode mode) const
+    {
+        bool padded = mode == Write_Padded;
+        const char* close = padded ? ") " : ")";
+        // ends of the lists that are still open, only as deep as the document
+        std::vector<std::uint32_t> open;
+        char buffer[Number::MaxLength];
+        for (std::uint32_t i = from; i < to; i++)
+        {
+            while (!open.empty() && open.back() == i)
+            {
+                out += close;
+                open.pop_back();
+            }
+            const Node& n = nodes[i];
+            // in compact mode only the siblings are separated
+            if (!padded && i != from && n.parent + 1 != i)
+                out += ' ';
+            switch (n.type)
+            {
+            case Node_Literal:
+                out += '\'';
+                out += literal(n);
+                out += '\'';
+                break;
+            case Node_List:
+                out += padded ? "( " : "(";
+                open.push_back(n.next);
+                break;
+            case Node_Integer:
+                out += Number::format(std::int64_t(n.offset), buffer);
+                break;
+            case Node_Float:
+            {
+                double value = Number::fromBits(n.offset);
+                // the infinite and NaN ones are quoted
+                if (!std::isfinite(value))
+                    out += '\'';
+                out += Number::format(value, buffer);
+                if (!std::isfinite(value))
+                    out += '\'';
+                break;
+            }
+            default:
+                out += "ERROR";
+            }
+            if (padded && n.type != Node_List)
+                out += ' ';
+        }
+        for (; !open.empty(); open.pop_back())
+            out += close;
+    }
+
+    void Document::write(std::uint32_t from, std::uint32_t to, Writer& writer) const
+    {
+        std::vector<std::uint32_t> open;
+        for (std::uint32_t i = from; i < to; i++)
+        {
+            for (; !open.empty() && open.back() == i; open.pop_back())
+                writer.end_list();
+            const Node& n = nodes[i];
+            switch (n.type)
+            {
+            case Node_Literal:
+                writer.literal(literal(n));
+                break;
+            case Node_List:
+                writer.begin_list();
+                open.push_back(n.next);
+                break;
+            case Node_Integer:
+                writer.integer(std::int64_t(n.offset));
+                break;
+            case Node_Float:
+                writer.floating(Number::fromBits(n.offset));
+                break;
+            default:
+                writer.error();
+            }
+        }
+        for (; !open.empty(); open.pop_back())
+            writer.end_list();
+    }
+
+    // builder
+    DocumentBuilder::DocumentBuilder(std::string_view source, std::shared_ptr<const SourceBuffer> owner)
+    {
+        doc.source = source;
+        doc.owner = owner;
+    }
+
+    void DocumentBuilder::set_symbols(std::shared_ptr<SymbolTable> _symbols)
+    {
+        symbols = _symbols;
+        doc.symbolTable = _symbols;
+    }
+
+    bool DocumentBuilder::add(NodeType type)
+    {
+        // the indices of the nodes are 32 bit, a bigger document can't be built
+        if (doc.nodes.size() >= std::numeric_limits<std::uint32_t>::max())
+        {
+            on_error();
+            return false;
+        }
+        std::uint32_t idx = doc.nodes.size();
+        std::uint32_t parent = open.empty() ? idx : open.back();
+        doc.nodes.push_back(Node{type, 0, parent, idx + 1, 0, 0});
+        if (parent != idx)
+            doc.nodes[parent].length++;
+        return true;
+    }
+
+    void DocumentBuilder::on_list_begin()
+    {
+        if (!failed && add(Node_List))
+            open.push_back(doc.nodes.size() - 1);
+    }
+
+    void DocumentBuilder::on_list_end()
+    {
+        if (failed)
+            return;
+        doc.nodes[open.back()].next = doc.nodes.size();
+        open.pop_back();
+    }
+
+    void DocumentBuilder::on_literal(std::string_view value)
+    {
+        if (failed)
+            return;
+        if (value.length() > std::numeric_limits<std::uint32_t>::max())
+        {
+            on_error();
+            return;
+        }
+        if (!add(Node_Literal))
+            return;
+        Node& n = doc.nodes.back();
+        n.length = value.length();
+        if (symbols && value.length() <= SymbolTable::MaxLength)
+        {
+            n.flags |= Node_Interned;
+            n.offset = symbols->intern(value);
+            return;
+        }
+        // a view into the source is kept as it is, anything else is copied to the pool
+        std::less_equal<const char*> le;
+        const char* begin = doc.source.data();
+        if (!doc.source.empty() && le(begin, value.data())
+            && le(value.data() + value.length(), begin + doc.source.length()))
+        {
+            n.flags |= Node_Borrowed;
+            n.offset = value.data() - begin;
+            return;
+        }
+        n.offset = doc.pool.size();
+        doc.pool += value;
+    }
+
+    void DocumentBuilder::on_integer(std::int64_t value)
+    {
+        if (!failed && add(Node_Integer))
+            doc.nodes.back().offset = value;
+    }
+
+    void DocumentBuilder::on_float(double value)
+    {
+        if (!failed && add(Node_Float))
+            doc.nodes.back().offset = Number::toBits(value);
+    }
+
+    void DocumentBuilder::on_error()
+    {
+        // a broken document is a single error node, the events after it are ignored
+        failed = true;
+        open.clear();
+        doc.nodes.assign(1, Node{Node_Error, 0, 0, 1, 0, 0});
+        doc.pool.clear();
+        doc.source = {};
+        doc.owner.reset();
+    }
+
+    Document DocumentBuilder::take()
+    {
+        return std::move(doc);
+    }
+}
@@ -0,0 +1,247 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace lison
+{
+    // reader
+    LinesReader::LinesReader(std::istream& _in)
+        : in(_in)
+    {}
+
+    bool LinesReader::line(std::string& out)
+    {
+        while (std::getline(in, out))
+        {
+            number++;
+            // the line ends of a file from windows
+            if (!out.empty() && out.back() == '\r')
+                out.pop_back();
+            for (char c : out)
+                if (Tokenizer::classify(c) != Tokenizer::Sym_Whitespace)
+                    return true;
+        }
+        return false;
+    }
+
+    std::size_t LinesReader::line() const
+    {
+        return number;
+    }
+
+    bool LinesReader::next(Object& obj)
+    {
+        std::string text;
+        if (!line(text))
+            return false;
+        Parser parser;
+        obj = parser.parse(std::string_view(text));
+        return true;
+    }
+
+    bool LinesReader::next(LiSON& lison)
+    {
+        std::string text;
+        if (!line(text))
+            return false;
+        lison.deserialize(text);
+        return true;
+    }
+
+    std::size_t LinesReader::forEach(std::function<void(std::size_t line, Object&& obj)> f,
+                                     unsigned threads, bool ordered)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+
+        // lines that are parsed together, and their documents
+        struct Batch
+        {
+            std::vector<std::string> lines;
+            std::vector<std::size_t> numbers;
+            std::vector<Object> docs;
+            bool done = false;
+        };
+        auto parse = [](Batch& batch)
+        {
+            Parser parser;
+            batch.docs.reserve(batch.lines.size());
+            for (std::string& text : batch.lines)
+            {
+                batch.docs.push_back(parser.parse(std::string_view(text)));
+                std::string().swap(text);
+            }
+        };
+        std::mutex deliver;
+        auto pass = [&f, &deliver](Batch& batch)
+        {
+            std::lock_guard<std::mutex> lock(deliver);
+            for (std::size_t i = 0; i < batch.docs.size(); i++)
+                f(batch.numbers[i], std::move(batch.docs[i]));
+        };
+        auto read = [this](Batch& batch)
+        {
+            std::size_t size = 0;
+            std::string text;
+            while (batch.lines.size() < BatchLines && size < BatchSize && line(text))
+            {
+                size += text.size();
+                batch.numbers.push_back(number);
+                batch.lines.push_back(std::move(text));
+            }
+            return !batch.lines.empty();
+        };
+
+        std::size_t count = 0;
+        if (threads == 1)
+        {
+            for (Batch batch; read(batch); batch = Batch())
+            {
+                count += batch.lines.size();
+                parse(batch);
+                pass(batch);
+            }
+            return count;
+        }
+
+        // the batches that were read and are not passed on yet, at most two per thread
+        std::deque<std::unique_ptr<Batch>> flight;
+        std::deque<Batch*> pending;
+        std::mutex mutex;
+        std::condition_variable work;
+        std::condition_variable finished;
+        bool stop = false;
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; i++)
+        {
+            workers.emplace_back([&]()
+            {
+                while (true)
+                {
+                    Batch* batch;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        work.wait(lock, [&]() { return stop || !pending.empty(); });
+                        if (pending.empty())
+                            return;
+                        batch = pending.front();
+                        pending.pop_front();
+                    }
+                    parse(*batch);
+                    if (!ordered)
+                        pass(*batch);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        batch->done = true;
+                    }
+                    finished.notify_all();
+                }
+            });
+        }
+
+        // passes on the batches that are done (in order: only from the front), the unordered ones
+        // were passed on by the workers already, so they are only dropped
+        auto drain = [&](bool wait)
+        {
+            auto ready = [&]()
+            {
+                if (ordered)
+                    return flight.front()->done ? flight.begin() : flight.end();
+                return std::find_if(flight.begin(), flight.end(),
+                                    [](const std::unique_ptr<Batch>& b) { return b->done; });
+            };
+            while (!flight.empty())
+            {
+                std::unique_ptr<Batch> batch;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    auto it = ready();
+                    if (it == flight.end() && wait)
+                        finished.wait(lock, [&]() { return (it = ready()) != flight.end(); });
+                    if (it == flight.end())
+                        return;
+                    batch = std::move(*it);
+                    flight.erase(it);
+                }
+                if (ordered)
+                    pass(*batch);
+                wait = false;
+            }
+        };
+        while (true)
+        {
+            auto batch = std::make_unique<Batch>();
+            if (!read(*batch))
+                break;
+            count += batch->lines.size();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back(batch.get());
+                flight.push_back(std::move(batch));
+            }
+            work.notify_one();
+            drain(false);
+            // bounded memory: the reading waits for the oldest batch
+            if (flight.size() >= 2 * threads)
+                drain(true);
+        }
+        while (!flight.empty())
+            drain(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        work.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+        return count;
+    }
+
+    // writer
+    LinesWriter::LinesWriter(std::ostream& _stream)
+        : StreamWriter(_stream, Write_Compact)
+    {}
+
+    void LinesWriter::literal(std::string_view value)
+    {
+        if (value.find('\n') == std::string_view::npos)
+        {
+            StreamWriter::literal(value);
+            return;
+        }
+        std::string folded(value);
+        std::replace(folded.begin(), folded.end(), '\n', ' ');
+        StreamWriter::literal(folded);
+    }
+
+    void LinesWriter::write(const Object& obj)
+    {
+        obj.write(*this);
+        newline();
+    }
+
+    void LinesWriter::write(const LiSON& lison)
+    {
+        lison.serialize(*this);
+        newline();
+    }
+}
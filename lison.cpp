@@ -19,18 +19,116 @@
 namespace lison
 {
 
+    void LiSON::set_trace(Trace* _trace)
+    {
+        trace = _trace;
+    }
+
     void LiSON::deserialize(const std::string& src)
     {
-        Tokenizer tokenizer;
+        ObjectBuilder builder;
+        Handler* handler = &builder;
+#ifdef LISON_TRACE
+        TraceHandler counter(builder, trace);
+        if (trace != nullptr)
+            handler = &counter;
+        StageTimer parsing(trace, Stage_Parse, src.size());
+#endif
         Parser parser;
-        std::list<Tokenizer::SymbolObject> symbolStream = tokenizer.tokenize(src);
-        Object o = parser.parse(symbolStream);
-        interpret(o);
+        parser.parse(std::string_view(src), *handler);
+#ifdef LISON_TRACE
+        parsing.stop();
+        StageTimer interpreting(trace, Stage_Interpret);
+#endif
+        interpret(builder.take());
+    }
+
+    void LiSON::deserialize(const Serializer& serializer)
+    {
+        ObjectBuilder builder;
+        Handler* handler = &builder;
+#ifdef LISON_TRACE
+        TraceHandler counter(builder, trace);
+        if (trace != nullptr)
+            handler = &counter;
+        StageTimer reading(trace, Stage_Read);
+#endif
+        // the file is parsed in place, whether it is mapped or read into a buffer
+        std::shared_ptr<const SourceBuffer> source = serializer.map();
+#ifdef LISON_TRACE
+        std::uint64_t size = source ? source->view().size() : 0;
+        reading.add_bytes(size);
+        reading.stop();
+        StageTimer parsing(trace, Stage_Parse, size);
+#endif
+        if (source && Decoder::detect(source->view()))
+        {
+            Decoder decoder;
+            decoder.parse(source->view(), *handler);
+        }
+        else if (source)
+        {
+            Parser parser;
+            parser.parse(source->view(), *handler);
+        }
+        else
+            handler->on_error();
+#ifdef LISON_TRACE
+        parsing.stop();
+        StageTimer interpreting(trace, Stage_Interpret);
+#endif
+        interpret(builder.take());
+    }
+
+    Object LiSON::emitted() const
+    {
+        ObjectBuilder builder;
+        emit(builder);
+        return builder.take();
+    }
+
+    void LiSON::emit(Writer& writer) const
+    {
+#ifdef LISON_TRACE
+        StageTimer reverting(trace, Stage_Revert);
+        Object obj = revert();
+        reverting.stop();
+        obj.write(writer);
+#else
+        revert().write(writer);
+#endif
+    }
+
+    void LiSON::write(Writer& writer) const
+    {
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+        std::uint64_t reverted = trace != nullptr ? trace->metrics.stages[Stage_Revert].ns : 0;
+        emit(writer);
+        if (trace != nullptr)
+            writing.exclude(trace->metrics.stages[Stage_Revert].ns - reverted);
+#else
+        emit(writer);
+#endif
     }
 
     std::string LiSON::serialize() const
     {
-        return revert().to_string();
+        std::string out;
+        StringWriter writer(out);
+        write(writer);
+        return out;
+    }
+
+    void LiSON::serialize(std::ostream& out, WriteMode mode) const
+    {
+        StreamWriter writer(out, mode);
+        write(writer);
+    }
+
+    void LiSON::serialize(Writer& writer) const
+    {
+        write(writer);
     }
 
     // wstring <-> lison
@@ -49,13 +147,13 @@ namespace lison
     // serializer <-> lison
     LiSON& operator >>(const Serializer& serializer, LiSON& lison)
     {
-        lison.deserialize(serializer.read());
+        lison.deserialize(serializer);
         return lison;
     }
 
     const Serializer& operator <<(const Serializer& serializer, const LiSON& lison)
     {
-        serializer.write(lison.serialize());
+        serializer.write(lison);
         return serializer;
     }
 
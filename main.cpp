@@ -65,9 +65,10 @@ protected:
 
 
 		// the shiny new api
-		obj.foreachObjectData([this](const Object& o)
+		// the visitor and the views read the object in place, nothing is copied
+		obj.visitObjectData([this](const Object& o)
 		{
-			data.push_back(o.expectLiteralData().value_or("ERROR"));
+			data.emplace_back(o.expectLiteralView().value_or("ERROR"));
 		});
 		
     }
@@ -0,0 +1,229 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace lison
+{
+    // memory report
+    std::size_t MemoryReport::totalBytes() const
+    {
+        return literalBytes + containerBytes;
+    }
+
+    double MemoryReport::bytesPerNode() const
+    {
+        return nodes == 0 ? 0 : double(totalBytes()) / nodes;
+    }
+
+    // heap bytes of a string, nothing if it fits in the string itself
+    static std::size_t stringHeap(std::size_t capacity)
+    {
+        static const std::size_t inplace = std::string().capacity();
+        return capacity > inplace ? capacity + 1 : 0;
+    }
+
+    MemoryReport Object::memoryUsage() const
+    {
+        // a child is a node of the std::list: two links and the object
+        constexpr std::size_t listNode = sizeof(Object) + 2 * sizeof(void*);
+        MemoryReport report;
+        report.containerBytes = sizeof(Object);
+        std::vector<const Object*> stack{this};
+        while (!stack.empty())
+        {
+            const Object* current = stack.back();
+            stack.pop_back();
+            report.nodes++;
+            std::visit(overload{
+                [&](const Tkn_Literal& lit) {
+                    std::size_t heap = stringHeap(lit.value.capacity());
+                    report.literals++;
+                    report.literalBytes += lit.value.size();
+                    report.heapBytes += heap;
+                    // the unused capacity, or nothing if the characters are in the object
+                    report.containerBytes += heap > 0 ? heap - lit.value.size() : 0;
+                },
+                [&](const Tkn_Object& obj) {
+                    report.lists++;
+                    report.heapBytes += obj.value.size() * listNode;
+                    report.containerBytes += obj.value.size() * listNode;
+                    for (const Object& child : obj.value)
+                        stack.push_back(&child);
+                },
+                // numbers are held in the object itself
+                [](const Tkn_Integer&) {},
+                [](const Tkn_Float&) {},
+                [](const Tkn_Error&) {},
+            }, current->token);
+        }
+        return report;
+    }
+
+    MemoryReport Document::memoryUsage() const
+    {
+        MemoryReport report;
+        report.nodes = nodes.size();
+        for (const Node& n : nodes)
+        {
+            if (n.type == Node_List)
+                report.lists++;
+            else if (n.type == Node_Literal)
+                report.literals++;
+        }
+        std::size_t table = nodes.capacity() * sizeof(Node);
+        std::size_t pooled = stringHeap(pool.capacity());
+        report.literalBytes = pool.size();
+        report.heapBytes = table + pooled;
+        report.containerBytes = sizeof(Document) + table + (pooled > 0 ? pooled - pool.size() : 0);
+        return report;
+    }
+
+    // allocation counters
+    static std::atomic<std::uint64_t> allocationCount{0};
+    static std::atomic<std::uint64_t> deallocationCount{0};
+    static std::atomic<std::uint64_t> allocatedTotal{0};
+    static std::atomic<std::uint64_t> liveTotal{0};
+    static std::atomic<std::uint64_t> peakTotal{0};
+
+    bool Allocations::enabled()
+    {
+#ifdef LISON_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    AllocationStats Allocations::stats()
+    {
+        AllocationStats stats;
+        stats.allocations = allocationCount.load(std::memory_order_relaxed);
+        stats.deallocations = deallocationCount.load(std::memory_order_relaxed);
+        stats.allocatedBytes = allocatedTotal.load(std::memory_order_relaxed);
+        stats.liveBytes = liveTotal.load(std::memory_order_relaxed);
+        stats.peakBytes = peakTotal.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void Allocations::reset_peak()
+    {
+        peakTotal.store(liveTotal.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+#ifdef LISON_COUNT_ALLOCATIONS
+    // the size and the start of the block are kept in front of the memory, for the deletes
+    static constexpr std::size_t AllocationHeader = alignof(std::max_align_t);
+
+    static void* countedAlloc(std::size_t size, std::size_t align = AllocationHeader)
+    {
+        align = std::max(align, AllocationHeader);
+        void* block = std::malloc(size + AllocationHeader + align);
+        if (block == nullptr)
+            throw std::bad_alloc();
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(block) + AllocationHeader;
+        void** p = reinterpret_cast<void**>((start + align - 1) / align * align);
+        p[-1] = reinterpret_cast<void*>(size);
+        p[-2] = block;
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocatedTotal.fetch_add(size, std::memory_order_relaxed);
+        std::uint64_t live = liveTotal.fetch_add(size, std::memory_order_relaxed) + size;
+        std::uint64_t peak = peakTotal.load(std::memory_order_relaxed);
+        while (live > peak && !peakTotal.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            ;
+        return p;
+    }
+
+    static void countedFree(void* p)
+    {
+        if (p == nullptr)
+            return;
+        void** header = static_cast<void**>(p);
+        deallocationCount.fetch_add(1, std::memory_order_relaxed);
+        liveTotal.fetch_sub(reinterpret_cast<std::size_t>(header[-1]), std::memory_order_relaxed);
+        std::free(header[-2]);
+    }
+#endif
+}
+
+#ifdef LISON_COUNT_ALLOCATIONS
+// the nothrow and the array forms of the standard library end up in these
+void* operator new(std::size_t size)
+{
+    return lison::countedAlloc(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return lison::countedAlloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+// the over-aligned forms, e.g. the new_delete_resource of std::pmr uses them
+void* operator new(std::size_t size, std::align_val_t align)
+{
+    return lison::countedAlloc(size, std::size_t(align));
+}
+
+void* operator new[](std::size_t size, std::align_val_t align)
+{
+    return lison::countedAlloc(size, std::size_t(align));
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    lison::countedFree(p);
+}
+#endif
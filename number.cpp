@@ -0,0 +1,96 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <cmath>
+#include <cstring>
+
+namespace lison
+{
+    NumberType Number::parse(std::string_view text, std::int64_t& integer, double& floating)
+    {
+        // a digit first (after the sign), so words like inf and nan are not numbers
+        std::size_t digit = !text.empty() && text[0] == '-' ? 1 : 0;
+        if (digit >= text.size() || text[digit] < '0' || text[digit] > '9')
+            return Number_None;
+        const char* begin = text.data();
+        const char* end = text.data() + text.size();
+        auto [last, error] = std::from_chars(begin, end, integer);
+        if (last == end)
+            return error == std::errc() ? Number_Integer : Number_Large;
+        auto [lastFloat, errorFloat] = std::from_chars(begin, end, floating);
+        if (lastFloat == end)
+            return errorFloat == std::errc() ? Number_Float : Number_Large;
+        return Number_None;
+    }
+
+    std::string_view Number::format(std::int64_t value, char* buffer)
+    {
+        char* end = std::to_chars(buffer, buffer + MaxLength, value).ptr;
+        return std::string_view(buffer, end - buffer);
+    }
+
+    std::string_view Number::format(double value, char* buffer)
+    {
+        char* end = std::to_chars(buffer, buffer + MaxLength - 2, value).ptr;
+        // a float that looks like an integer would be read back as one
+        if (std::isfinite(value) && std::memchr(buffer, '.', end - buffer) == nullptr && std::memchr(buffer, 'e', end - buffer) == nullptr)
+        {
+            *end++ = '.';
+            *end++ = '0';
+        }
+        return std::string_view(buffer, end - buffer);
+    }
+
+    std::uint64_t Number::toBits(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double Number::fromBits(std::uint64_t bits)
+    {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // the numbers of the receivers that don't know about them
+    void Handler::on_integer(std::int64_t value)
+    {
+        char buffer[Number::MaxLength];
+        on_literal(Number::format(value, buffer));
+    }
+
+    void Handler::on_float(double value)
+    {
+        char buffer[Number::MaxLength];
+        on_literal(Number::format(value, buffer));
+    }
+
+    void Writer::integer(std::int64_t value)
+    {
+        char buffer[Number::MaxLength];
+        literal(Number::format(value, buffer));
+    }
+
+    void Writer::floating(double value)
+    {
+        char buffer[Number::MaxLength];
+        literal(Number::format(value, buffer));
+    }
+}
@@ -15,6 +15,7 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "LiSON_base.h"
+#include <cmath>
 
 namespace lison
 {
@@ -49,43 +50,193 @@ namespace lison
 //         return ss.str();
 //     }
 
+	Tkn_Literal::Tkn_Literal(std::string_view _value, std::pmr::memory_resource* resource)
+		: value(_value, resource)
+	{}
+
 	Object::Object(const Token& t)
 		: token(t)
 	{}
 
-	Object::Object(const Object& other)
-		: token(other.token)
+	Object::Object(Token&& t)
+		: token(std::move(t))
 	{}
-	
-    std::string Object::to_string() const
+
+	Object::Object(const Object& other)
+		: token(Tkn_Error{})
 	{
-		// the new variant visitor magic
-		std::stringstream ss;
-		auto visitor = overload
+		auto* list = std::get_if<Tkn_Object>(&other.token);
+		if (list == nullptr)
+		{
+			token = other.token;
+			return;
+		}
+		token = Token{Tkn_Object{}};
+		// the lists are copied level by level with an explicit stack, not by recursion
+		std::vector<std::pair<const ObjectList*, ObjectList*>> todo;
+		todo.emplace_back(&list->value, &std::get<Tkn_Object>(token).value);
+		while (!todo.empty())
 		{
-			[&ss](const Tkn_Literal& literal)
+			auto [from, to] = todo.back();
+			todo.pop_back();
+			for (const Object& o : *from)
 			{
-                ss << "'";
-                ss << literal.value;
-                ss << "'";
-			},
-			[&ss](const Tkn_Object& object)
+				if (auto* l = std::get_if<Tkn_Object>(&o.token))
+				{
+					Object& copy = to->emplace_back(Token{Tkn_Object{}});
+					todo.emplace_back(&l->value, &std::get<Tkn_Object>(copy.token).value);
+				}
+				else
+					to->emplace_back(o.token);
+			}
+		}
+	}
+
+	Object& Object::operator =(const Object& other)
+	{
+		if (this != &other)
+			*this = Object(other);
+		return *this;
+	}
+
+	Object::~Object()
+	{
+		// the children are moved to a flat list before they die, so destroying a
+		// deep tree doesn't go as deep on the stack as the tree
+		auto* list = std::get_if<Tkn_Object>(&token);
+		if (list == nullptr || list->value.empty())
+			return;
+		ObjectList pending(list->value.get_allocator());
+		pending.splice(pending.end(), list->value);
+		while (!pending.empty())
+		{
+			// a list from another resource can't be spliced, it is flattened by its own destructor
+			auto* l = std::get_if<Tkn_Object>(&pending.front().token);
+			if (l != nullptr && l->value.get_allocator() == pending.get_allocator())
+				pending.splice(pending.end(), l->value);
+			pending.pop_front();
+		}
+	}
+	
+	void Object::write(Writer& writer) const
+	{
+		// the lists that are being written, with the next child to write
+		struct Frame
+		{
+			ObjectList::const_iterator it;
+			ObjectList::const_iterator end;
+		};
+		std::vector<Frame> open;
+		const Object* obj = this;
+		while (obj != nullptr)
+		{
+			// the new variant visitor magic
+			auto visitor = overload
 			{
-                ss << "( ";
-                for (auto o : object.value)
-                {
-                    ss << o.to_string();
-                }
-                ss << ")";
-			},
-			[&ss](const Tkn_Error& error)
+				[&writer](const Tkn_Literal& literal)
+				{
+					writer.literal(literal.value);
+				},
+				[&writer, &open](const Tkn_Object& object)
+				{
+					writer.begin_list();
+					open.push_back(Frame{object.value.begin(), object.value.end()});
+				},
+				[&writer](const Tkn_Error& error)
+				{
+					writer.error();
+				},
+				[&writer](const Tkn_Integer& number)
+				{
+					writer.integer(number.value);
+				},
+				[&writer](const Tkn_Float& number)
+				{
+					writer.floating(number.value);
+				}
+			};
+			std::visit(visitor, obj->token);
+
+			// next one is the following child of the innermost list that still has some
+			obj = nullptr;
+			while (!open.empty())
 			{
-				ss << "ERROR";
+				Frame& f = open.back();
+				if (f.it != f.end)
+				{
+					obj = &*f.it++;
+					break;
+				}
+				writer.end_list();
+				open.pop_back();
 			}
-		};
-		std::visit(visitor, token);
-		ss << " ";
-		return ss.str();
+		}
+	}
+
+    std::string Object::to_string(WriteMode mode) const
+	{
+		std::string out;
+		out.reserve(serializedSize(mode));
+		write(out, mode);
+		return out;
+	}
+
+	void Object::write(std::string& out, WriteMode mode) const
+	{
+		StringWriter writer(out, mode);
+		write(writer);
+	}
+
+	void Object::write(std::ostream& out, WriteMode mode) const
+	{
+		StreamWriter writer(out, mode);
+		write(writer);
+	}
+
+	std::size_t Object::serializedSize(WriteMode mode) const
+	{
+		bool padded = mode == Write_Padded;
+		std::size_t size = 0;
+		std::vector<const Object*> todo{this};
+		while (!todo.empty())
+		{
+			const Object* obj = todo.back();
+			todo.pop_back();
+			auto visitor = overload
+			{
+				[&size](const Tkn_Literal& literal)
+				{
+					size += literal.value.length() + 2;
+				},
+				[&size, &todo, padded](const Tkn_Object& object)
+				{
+					size += padded ? 3 : 2;
+					if (!padded && !object.value.empty())
+						size += object.value.size() - 1;
+					for (const Object& o : object.value)
+						todo.push_back(&o);
+				},
+				[&size](const Tkn_Error& error)
+				{
+					size += 5;
+				},
+				[&size](const Tkn_Integer& number)
+				{
+					char buffer[Number::MaxLength];
+					size += Number::format(number.value, buffer).length();
+				},
+				[&size](const Tkn_Float& number)
+				{
+					char buffer[Number::MaxLength];
+					// the infinite and NaN ones are quoted
+					size += Number::format(number.value, buffer).length() + (std::isfinite(number.value) ? 0 : 2);
+				}
+			};
+			std::visit(visitor, obj->token);
+			if (padded)
+				size++;
+		}
+		return size;
 	}
 
 	Object Object::fromString(const std::string& str)
@@ -93,6 +244,16 @@ namespace lison
 		return Object(Token{Tkn_Literal{str}});
 	}
 
+	Object Object::fromInteger(std::int64_t value)
+	{
+		return Object(Token{Tkn_Integer{value}});
+	}
+
+	Object Object::fromFloat(double value)
+	{
+		return Object(Token{Tkn_Float{value}});
+	}
+
 	Object Object::fromLiSON(const LiSON& lison)
 	{
 		return lison.revert();
@@ -111,7 +272,7 @@ namespace lison
 		if (!std::holds_alternative<Tkn_Object>(token))
 			return;
 		auto& t = std::get<Tkn_Object>(token);
-		for (auto it : t.value)
+		for (const Object& it : t.value)
 		{
 			f(it);
 		}
@@ -125,12 +286,36 @@ namespace lison
 		t.value.push_back(obj);
 	}
 
+	void Object::add(Object&& obj)
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return;
+		auto& t = std::get<Tkn_Object>(token);
+		t.value.push_back(std::move(obj));
+	}
+
 	std::optional<std::string> Object::expectLiteralData() const
 	{
 		if (!std::holds_alternative<Tkn_Literal>(token))
 			return {};
 		auto& t = std::get<Tkn_Literal>(token);
-		return {t.value};
+		return {std::string(t.value)};
+	}
+
+	std::optional<std::int64_t> Object::expectInteger() const
+	{
+		if (!std::holds_alternative<Tkn_Integer>(token))
+			return {};
+		return {std::get<Tkn_Integer>(token).value};
+	}
+
+	std::optional<double> Object::expectFloat() const
+	{
+		if (auto* number = std::get_if<Tkn_Float>(&token))
+			return {number->value};
+		if (auto* number = std::get_if<Tkn_Integer>(&token))
+			return {double(number->value)};
+		return {};
 	}
 
 	std::optional<std::list<Object>> Object::expectObjectData() const
@@ -138,7 +323,114 @@ namespace lison
 		if (!std::holds_alternative<Tkn_Object>(token))
 			return {};
 		auto& t = std::get<Tkn_Object>(token);
+		return {std::list<Object>(t.value.begin(), t.value.end())};
+	}
+
+	std::optional<std::string_view> Object::expectLiteralView() const
+	{
+		if (!std::holds_alternative<Tkn_Literal>(token))
+			return {};
+		auto& t = std::get<Tkn_Literal>(token);
 		return {t.value};
 	}
 
+	const ObjectList* Object::expectObjectList() const
+	{
+		if (!std::holds_alternative<Tkn_Object>(token))
+			return nullptr;
+		auto& t = std::get<Tkn_Object>(token);
+		return &t.value;
+	}
+
+	// builder
+	ObjectBuilder::ObjectBuilder(std::pmr::memory_resource* _resource)
+		: result(Token{Tkn_Error{}}), resource(_resource)
+	{}
+
+	Object& ObjectBuilder::add(Token&& token)
+	{
+		if (open.empty())
+		{
+			result = Object(std::move(token));
+			return result;
+		}
+		auto& list = std::get<Tkn_Object>(open.back()->token).value;
+		return list.emplace_back(std::move(token));
+	}
+
+	void ObjectBuilder::on_list_begin()
+	{
+		open.push_back(&add(Token{Tkn_Object{ObjectList(resource)}}));
+	}
+
+	void ObjectBuilder::on_list_end()
+	{
+		open.pop_back();
+	}
+
+	void ObjectBuilder::on_literal(std::string_view value)
+	{
+		add(Token{Tkn_Literal{value, resource}});
+	}
+
+	void ObjectBuilder::on_integer(std::int64_t value)
+	{
+		add(Token{Tkn_Integer{value}});
+	}
+
+	void ObjectBuilder::on_float(double value)
+	{
+		add(Token{Tkn_Float{value}});
+	}
+
+	void ObjectBuilder::on_error()
+	{
+		open.clear();
+		result = Object(Token{Tkn_Error{}});
+	}
+
+	void ObjectBuilder::begin_list()
+	{
+		on_list_begin();
+	}
+
+	void ObjectBuilder::end_list()
+	{
+		on_list_end();
+	}
+
+	void ObjectBuilder::literal(std::string_view value)
+	{
+		on_literal(value);
+	}
+
+	void ObjectBuilder::integer(std::int64_t value)
+	{
+		on_integer(value);
+	}
+
+	void ObjectBuilder::floating(double value)
+	{
+		on_float(value);
+	}
+
+	void ObjectBuilder::error()
+	{
+		add(Token{Tkn_Error{}});
+	}
+
+	Object ObjectBuilder::take()
+	{
+		return std::move(result);
+	}
+
+	// stream
+	ObjectStream::ObjectStream(std::function<void(Object&&)> _f, std::pmr::memory_resource* _resource)
+		: ObjectBuilder(_resource), f(_f)
+	{}
+
+	void ObjectStream::on_element_end()
+	{
+		f(take());
+	}
 }
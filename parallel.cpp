@@ -0,0 +1,491 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LISON_WRITEV
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <cerrno>
+#endif
+
+namespace lison
+{
+    // parallel parser
+    ParallelParser::ParallelParser()
+        : threads(std::max(1u, std::thread::hardware_concurrency()))
+    {}
+
+    void ParallelParser::set_threads(unsigned _threads)
+    {
+        threads = std::max(1u, _threads);
+    }
+
+    void ParallelParser::set_chunk_size(std::size_t _chunkSize)
+    {
+        chunkSize = std::max<std::size_t>(1, _chunkSize);
+    }
+
+    void ParallelParser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool ParallelParser::split(std::string_view src, std::vector<std::size_t>& bounds) const
+    {
+        std::size_t start = 0;
+        while (start < src.length() && Tokenizer::classify(src[start]) == Tokenizer::Sym_Whitespace)
+            start++;
+        if (start == src.length() || src[start] != '(')
+            return false;
+        std::size_t ranges = std::min<std::size_t>(threads, (src.length() - start) / chunkSize);
+        if (ranges < 2)
+            return false;
+        std::size_t step = (src.length() - start) / ranges;
+
+        bounds.assign(1, start + 1);
+        std::size_t target = start + step;
+        std::size_t depth = 0;
+        bool inside = false;
+        for (std::size_t block = start - start % Scanner::BlockSize; block < src.length(); block += Scanner::BlockSize)
+        {
+            BlockMasks m = Scanner::classify(src.data() + block,
+                                             std::min(Scanner::BlockSize, src.length() - block));
+            if (block < start)
+            {
+                std::uint64_t after = ~std::uint64_t(0) << (start - block);
+                m.quote &= after;
+                m.leftParen &= after;
+                m.rightParen &= after;
+            }
+            std::uint64_t literal = Scanner::literalMask(m.quote, inside);
+            std::uint64_t left = m.leftParen & ~literal;
+            std::uint64_t right = m.rightParen & ~literal;
+            bool hunting = bounds.size() < ranges && block + Scanner::BlockSize > target;
+            // nothing to look for in this block, only the depth matters
+            std::size_t closing = __builtin_popcountll(right);
+            if (!hunting && depth > closing)
+            {
+                depth += __builtin_popcountll(left);
+                depth -= closing;
+                continue;
+            }
+            // a range starts where a child of the root does, after the target
+            std::uint64_t events = left | right | (m.quote & literal);
+            while (events != 0)
+            {
+                int bit = __builtin_ctzll(events);
+                std::size_t pos = block + bit;
+                if ((right >> bit) & 1)
+                {
+                    if (--depth == 0)
+                    {
+                        bounds.push_back(pos);
+                        return true;
+                    }
+                }
+                else
+                {
+                    if (depth == 1 && pos >= target && bounds.size() < ranges)
+                    {
+                        bounds.push_back(pos);
+                        target = pos + step;
+                    }
+                    if ((left >> bit) & 1)
+                        depth++;
+                }
+                events &= events - 1;
+            }
+        }
+        // the root is never closed
+        return false;
+    }
+
+    template <class F>
+    void ParallelParser::run(std::size_t ranges, F&& f) const
+    {
+        std::vector<std::thread> workers;
+        for (std::size_t i = 1; i < ranges; i++)
+            workers.emplace_back([&f, i]() { f(i); });
+        f(0);
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    Object ParallelParser::parse(std::string_view src)
+    {
+        Parser sequential;
+        sequential.set_max_depth(maxDepth);
+        std::vector<std::size_t> bounds;
+        if (maxDepth == 0 || !split(src, bounds))
+            return sequential.parse(src);
+
+        // the children of every range, one list per range
+        std::size_t ranges = bounds.size() - 1;
+        std::vector<ObjectList> parts(ranges);
+        std::vector<char> ok(ranges, false);
+        run(ranges, [&](std::size_t i)
+        {
+            Parser parser;
+            // the root is one level already
+            parser.set_max_depth(maxDepth - 1);
+            ObjectList& part = parts[i];
+            ObjectStream stream([&part](Object&& obj) { part.push_back(std::move(obj)); });
+            ok[i] = parser.parseSequence(src.substr(bounds[i], bounds[i + 1] - bounds[i]), stream);
+        });
+        // a broken source is reported exactly the way the sequential parser does it
+        if (std::find(ok.begin(), ok.end(), false) != ok.end())
+            return sequential.parse(src);
+
+        Object root(Token{Tkn_Object{}});
+        ObjectList& children = std::get<Tkn_Object>(root.token).value;
+        for (ObjectList& part : parts)
+            children.splice(children.end(), part);
+        return root;
+    }
+
+    Document ParallelParser::parseDocument(std::string_view src, DocumentMode mode)
+    {
+        return build(src, mode, nullptr);
+    }
+
+    Document ParallelParser::parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode)
+    {
+        // a file that could not be opened is a broken document
+        if (!source)
+        {
+            DocumentBuilder builder;
+            builder.on_error();
+            return builder.take();
+        }
+        return build(source->view(), mode, source);
+    }
+
+    Document ParallelParser::build(std::string_view src, DocumentMode mode, std::shared_ptr<const SourceBuffer> owner)
+    {
+        bool borrowed = mode == Document_Borrowed;
+        auto sequential = [&]()
+        {
+            Parser parser;
+            parser.set_max_depth(maxDepth);
+            DocumentBuilder builder;
+            if (borrowed)
+                builder = DocumentBuilder(src, owner);
+            parser.parse(src, builder);
+            return builder.take();
+        };
+        std::vector<std::size_t> bounds;
+        if (maxDepth == 0 || !split(src, bounds))
+            return sequential();
+
+        // every range is a document of its own, with the children of the root as top-level nodes
+        std::size_t ranges = bounds.size() - 1;
+        std::vector<Document> parts(ranges);
+        std::vector<char> ok(ranges, false);
+        run(ranges, [&](std::size_t i)
+        {
+            Parser parser;
+            parser.set_max_depth(maxDepth - 1);
+            DocumentBuilder builder;
+            // the literals are borrowed from the whole source, so their offsets are already right
+            if (borrowed)
+                builder = DocumentBuilder(src, owner);
+            ok[i] = parser.parseSequence(src.substr(bounds[i], bounds[i + 1] - bounds[i]), builder);
+            parts[i] = builder.take();
+        });
+        if (std::find(ok.begin(), ok.end(), false) != ok.end())
+            return sequential();
+
+        // where the nodes and the literals of each part go in the joined document
+        std::vector<std::uint32_t> nodeBase(ranges);
+        std::vector<std::size_t> poolBase(ranges);
+        std::size_t nodes = 1;
+        std::size_t pool = 0;
+        for (std::size_t i = 0; i < ranges; i++)
+        {
+            nodeBase[i] = nodes;
+            poolBase[i] = pool;
+            nodes += parts[i].nodes.size();
+            pool += parts[i].pool.size();
+            // the node indices are 32 bit: a part that didn't fit in them is an error node,
+            // and so is the whole if the parts don't fit together
+            bool overflow = parts[i].nodes.size() == 1 && parts[i].nodes[0].type == Node_Error;
+            if (overflow || nodes > std::numeric_limits<std::uint32_t>::max())
+            {
+                DocumentBuilder builder;
+                builder.on_error();
+                return builder.take();
+            }
+        }
+        Document doc;
+        if (borrowed)
+        {
+            doc.source = src;
+            doc.owner = owner;
+        }
+        doc.nodes.resize(nodes);
+        doc.pool.resize(pool);
+        std::vector<std::uint32_t> children(ranges, 0);
+        run(ranges, [&](std::size_t i)
+        {
+            const Document& part = parts[i];
+            std::uint32_t base = nodeBase[i];
+            for (std::uint32_t j = 0; j < part.nodes.size(); j++)
+            {
+                Node n = part.nodes[j];
+                // the top-level nodes of the part are the children of the root
+                if (n.parent == j)
+                {
+                    n.parent = 0;
+                    children[i]++;
+                }
+                else
+                    n.parent += base;
+                n.next += base;
+                if (n.type == Node_Literal && !(n.flags & Node_Borrowed))
+                    n.offset += poolBase[i];
+                doc.nodes[base + j] = n;
+            }
+            std::memcpy(&doc.pool[poolBase[i]], part.pool.data(), part.pool.size());
+        });
+        std::uint32_t length = 0;
+        for (std::uint32_t c : children)
+            length += c;
+        doc.nodes[0] = Node{Node_List, 0, 0, std::uint32_t(nodes), length, 0};
+        return doc;
+    }
+
+    // parallel writer
+    ParallelWriter::ParallelWriter()
+        : threads(std::max(1u, std::thread::hardware_concurrency()))
+    {}
+
+    void ParallelWriter::set_threads(unsigned _threads)
+    {
+        threads = std::max(1u, _threads);
+    }
+
+    void ParallelWriter::set_min_elements(std::size_t _minElements)
+    {
+        minElements = _minElements;
+    }
+
+    void ParallelWriter::plan(const Object& obj, std::size_t want, std::size_t depth, WriteMode mode,
+                              std::vector<Piece>& pieces, std::size_t& split) const
+    {
+        bool padded = mode == Write_Padded;
+        const ObjectList* list = obj.expectObjectList();
+        if (list == nullptr || list->empty() || want < 2 || depth >= MaxSplitDepth)
+        {
+            Piece whole;
+            whole.single = &obj;
+            pieces.push_back(std::move(whole));
+            return;
+        }
+        Piece text;
+        text.text = padded ? "( " : "(";
+        pieces.push_back(text);
+        // in compact mode the pieces are siblings, so there is a space between them
+        text.text = " ";
+        if (list->size() >= want)
+        {
+            // long enough to be split into runs of about the same length
+            auto it = list->begin();
+            for (std::size_t r = 0; r < want; r++)
+            {
+                if (r > 0 && !padded)
+                    pieces.push_back(text);
+                Piece run;
+                run.first = it;
+                run.count = list->size() / want + (r < list->size() % want ? 1 : 0);
+                std::advance(it, run.count);
+                pieces.push_back(std::move(run));
+            }
+            split += list->size();
+        }
+        else
+        {
+            // too short, its children are split instead
+            std::size_t each = (want + list->size() - 1) / list->size();
+            for (auto it = list->begin(); it != list->end(); ++it)
+            {
+                if (it != list->begin() && !padded)
+                    pieces.push_back(text);
+                plan(*it, each, depth + 1, mode, pieces, split);
+            }
+        }
+        text.text = padded ? ") " : ")";
+        pieces.push_back(text);
+    }
+
+    void ParallelWriter::render(std::vector<Piece>& pieces, WriteMode mode,
+                                const std::function<void(std::size_t from, std::size_t to)>& ready) const
+    {
+        // the texts are done from the start, the rest is taken by the workers front to back
+        std::vector<std::size_t> tasks;
+        std::vector<char> done(pieces.size(), true);
+        for (std::size_t i = 0; i < pieces.size(); i++)
+        {
+            if (pieces[i].single != nullptr || pieces[i].count > 0)
+            {
+                tasks.push_back(i);
+                done[i] = false;
+            }
+        }
+        std::atomic<std::size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable finished;
+        auto work = [&]()
+        {
+            for (std::size_t t = next++; t < tasks.size(); t = next++)
+            {
+                Piece& piece = pieces[tasks[t]];
+                StringWriter writer(piece.text, mode);
+                if (piece.single != nullptr)
+                    piece.single->write(writer);
+                else
+                {
+                    auto it = piece.first;
+                    for (std::size_t i = 0; i < piece.count; i++, ++it)
+                        it->write(writer);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done[tasks[t]] = true;
+                }
+                finished.notify_one();
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < std::min<std::size_t>(threads, tasks.size()); i++)
+            workers.emplace_back(work);
+
+        // this thread passes the output on while the rest is being written
+        for (std::size_t from = 0; from < pieces.size();)
+        {
+            std::size_t to = from;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                finished.wait(lock, [&]() { return done[from]; });
+                while (to < pieces.size() && done[to])
+                    to++;
+            }
+            ready(from, to);
+            from = to;
+        }
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    std::string ParallelWriter::to_string(const Object& obj, WriteMode mode) const
+    {
+        std::vector<Piece> pieces;
+        std::size_t split = 0;
+        plan(obj, threads * 4, 0, mode, pieces, split);
+        if (threads < 2 || split < minElements)
+            return obj.to_string(mode);
+
+        std::string out;
+        render(pieces, mode, [&](std::size_t from, std::size_t to)
+        {
+            for (; from < to; from++)
+            {
+                out += pieces[from].text;
+                std::string().swap(pieces[from].text);
+            }
+        });
+        return out;
+    }
+
+    bool ParallelWriter::write(const Object& obj, const std::string& filename, WriteMode mode) const
+    {
+        std::vector<Piece> pieces;
+        std::size_t split = 0;
+        plan(obj, threads * 4, 0, mode, pieces, split);
+        if (threads < 2 || split < minElements)
+        {
+            // small enough to be streamed on this thread
+            FileWriter writer(filename, mode);
+            if (!writer.is_open())
+                return false;
+            obj.write(writer);
+            return true;
+        }
+
+#ifdef LISON_WRITEV
+        int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        bool ok = true;
+        render(pieces, mode, [&](std::size_t from, std::size_t to)
+        {
+            // the buffers go out as they are, without putting them together
+            std::vector<iovec> io;
+            for (std::size_t i = from; i < to; i++)
+                if (!pieces[i].text.empty())
+                    io.push_back(iovec{pieces[i].text.data(), pieces[i].text.size()});
+            std::size_t first = 0;
+            while (ok && first < io.size())
+            {
+                int count = std::min<std::size_t>(io.size() - first, IOV_MAX);
+                ssize_t written = ::writev(fd, &io[first], count);
+                if (written < 0)
+                {
+                    ok = errno == EINTR;
+                    continue;
+                }
+                // a short write leaves the rest of the buffers for the next round
+                for (; first < io.size() && std::size_t(written) >= io[first].iov_len; first++)
+                    written -= io[first].iov_len;
+                if (first < io.size())
+                {
+                    io[first].iov_base = static_cast<char*>(io[first].iov_base) + written;
+                    io[first].iov_len -= written;
+                }
+            }
+            for (std::size_t i = from; i < to; i++)
+                std::string().swap(pieces[i].text);
+        });
+        return ::close(fd) == 0 && ok;
+#else
+        std::ofstream file;
+        file.open(filename,std::ios_base::out);
+        if (!file.is_open())
+            return false;
+        render(pieces, mode, [&](std::size_t from, std::size_t to)
+        {
+            for (; from < to; from++)
+            {
+                file.write(pieces[from].text.data(), pieces[from].text.size());
+                std::string().swap(pieces[from].text);
+            }
+        });
+        file.close();
+        return bool(file);
+#endif
+    }
+}
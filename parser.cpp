@@ -22,148 +22,406 @@ namespace lison
 	// can be used to check if a special symbol is present
     bool Parser::accept(Tokenizer::Symbol req)
     {
-        if (iter->sym == req)
+        if (lexer.peek() == req)
         {
-            ++iter;
+            lexer.advance();
             return true;
         }
         return false;
     }
 
-    char Parser::character()
+    bool Parser::literal(Handler& handler)
     {
-        if (iter->sym == Tokenizer::Sym_Character)
+        if (!accept(Tokenizer::Sym_Quote))
+            return false;
+        // the whole body comes in one span, only the whitespaces get folded
+        std::string_view body = lexer.literal();
+        if (!accept(Tokenizer::Sym_Quote))
+            return false;
+        handler.on_literal(Lexer::fold(body, folded));
+        return true;
+    }
+
+    // unquoted, so it can only be a number
+    bool Parser::number(Handler& handler)
+    {
+        if (lexer.peek() != Tokenizer::Sym_Character)
+            return false;
+        std::int64_t integer;
+        double floating;
+        std::string_view text = lexer.number();
+        switch (Number::parse(text, integer, floating))
         {
-            char c =  iter->character;
-            ++iter;
-            return c;
+        case Number_Integer:
+            handler.on_integer(integer);
+            return true;
+        case Number_Float:
+            handler.on_float(floating);
+            return true;
+        case Number_Large:
+            handler.on_literal(text);
+            return true;
+        default:
+            return false;
         }
-        else
-            return 0;
     }
 
-    Object Parser::literal()
+	/*
+	  Object => [LeftParen] -> [String | [Whitespace -> Object] -> [RightParen]
+	            |------------------------|
+	 */
+
+    bool Parser::object(Handler& handler)
     {
-        if (accept(Tokenizer::Sym_Quote))
+        // no recursion: the events need nothing from the enclosing lists but their number
+        // (the builders keep their own stack), so any depth costs the same
+        std::size_t depth = 0;
+        while (true)
         {
-            std::stringstream ss;
-            char c;
-            bool whitespace;
-            bool loop = true;
-            while (loop)
+            // yank the whitespaces
+            while (accept(Tokenizer::Sym_Whitespace));
+
+            // end of the actual list
+            if (depth > 0 && accept(Tokenizer::Sym_RightParen))
             {
-                whitespace = accept(Tokenizer::Sym_Whitespace);
-                if (whitespace)
-                {
-                    ss << ' ';
-                    continue;
-                }
-                c = character();
-                if (c != 0)
-                    ss << c;
-                loop = c != 0 || whitespace;
+                handler.on_list_end();
+                if (--depth == 0)
+                    return true;
+            }
+            // left paren, that means a new list
+            else if (accept(Tokenizer::Sym_LeftParen))
+            {
+                if (++depth > maxDepth)
+                    return false;
+                handler.on_list_begin();
             }
-            if (accept(Tokenizer::Sym_Quote))
+            // doesn't start with a left paren -> it's a literal or a number
+            else if (literal(handler) || number(handler))
             {
-                // Object o;
-                // o.token = Object::Tkn_Literal;
-                // o.str = ss.str();
-				Object o(Token{Tkn_Literal{ss.str()}});
-                return o;
+                if (depth == 0)
+                    return true;
             }
+            else
+                return false;
         }
-        Object o(Token{Tkn_Error{}});
-        // o.token = Object::Tkn_Error;
-        return o;
     }
 
-	/*
-	  Object => [LeftParen] -> [String | [Whitespace -> Object] -> [RightParen]
-	            |------------------------|
-	 */
+    void Parser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
 
-    Object Parser::object()
+    void Parser::set_memory_resource(std::pmr::memory_resource* _resource)
     {
-		Object o(Token{Tkn_Object{}});
-		auto& token = std::get<Tkn_Object>(o.token);
-		// yank the whitespaces
-        while (accept(Tokenizer::Sym_Whitespace));
+        resource = _resource;
+    }
 
-		// outer if: looks for left paren, that means a new Object object
-        if (accept(Tokenizer::Sym_LeftParen))
+    void Parser::set_symbols(std::shared_ptr<SymbolTable> _symbols)
+    {
+        symbols = _symbols;
+    }
+
+    bool Parser::parse(std::string_view src, Handler& handler)
+    {
+        lexer = Lexer(src);
+        if (!object(handler))
+        {
+            handler.on_error();
+            return false;
+        }
+        handler.on_element_end();
+        return true;
+    }
+
+    bool Parser::parseSequence(std::string_view src, Handler& handler)
+    {
+        lexer = Lexer(src);
+        while (true)
         {
-            // yank the whitespaces
             while (accept(Tokenizer::Sym_Whitespace));
+            if (lexer.done())
+                return true;
+            if (!object(handler))
+            {
+                handler.on_error();
+                return false;
+            }
+            handler.on_element_end();
+        }
+    }
+
+    Object Parser::parse(const std::pmr::list<Tokenizer::SymbolObject>& symbolStream)
+    {
+        // the symbols are turned back into source, so there is only one grammar
+        std::string src;
+        for (auto& sym : symbolStream)
+        {
+            switch (sym.sym)
+            {
+            case Tokenizer::Sym_Quote: src += '\''; break;
+            case Tokenizer::Sym_LeftParen: src += '('; break;
+            case Tokenizer::Sym_RightParen: src += ')'; break;
+            case Tokenizer::Sym_Whitespace: src += ' '; break;
+            case Tokenizer::Sym_Character: src += sym.character; break;
+            default: break;
+            }
+        }
+        return parse(std::string_view(src));
+    }
+
+    // the trees are built from the same events
+    Object Parser::parse(std::string_view src)
+    {
+        ObjectBuilder builder(resource);
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Parser::parseDocument(std::string_view src, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(src);
+        builder.set_symbols(symbols);
+        parse(src, builder);
+        return builder.take();
+    }
+
+    Document Parser::parseDocument(std::shared_ptr<const SourceBuffer> source, DocumentMode mode)
+    {
+        DocumentBuilder builder;
+        // a file that could not be opened is a broken document
+        if (!source)
+        {
+            builder.on_error();
+            return builder.take();
+        }
+        if (mode == Document_Borrowed)
+            builder = DocumentBuilder(source->view(), source);
+        builder.set_symbols(symbols);
+        parse(source->view(), builder);
+        return builder.take();
+    }
+
+    // push parser
+    PushParser::PushParser(Handler& _handler)
+        : handler(_handler)
+    {}
 
-			// if it's an empty object, we return
-            if (accept(Tokenizer::Sym_RightParen))
-                return o;
-			// the object has some contents
-            else 
+    void PushParser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool PushParser::fail()
+    {
+        if (state != State_Error)
+        {
+            state = State_Error;
+            handler.on_error();
+        }
+        return false;
+    }
+
+    bool PushParser::number()
+    {
+        std::int64_t integer;
+        double floating;
+        switch (Number::parse(pending, integer, floating))
+        {
+        case Number_Integer:
+            handler.on_integer(integer);
+            break;
+        case Number_Float:
+            handler.on_float(floating);
+            break;
+        case Number_Large:
+            handler.on_literal(pending);
+            break;
+        default:
+            return fail();
+        }
+        pending.clear();
+        state = State_Between;
+        if (depth == 0)
+            handler.on_element_end();
+        return true;
+    }
+
+    bool PushParser::feed(std::string_view chunk)
+    {
+        Lexer lexer(chunk);
+        while (state != State_Error && !lexer.done())
+        {
+            if (state == State_Number)
+            {
+                // the number goes until anything but a character, that may be in a later chunk
+                pending += lexer.number();
+                if (lexer.done() || !number())
+                    break;
+                continue;
+            }
+            if (state == State_Literal)
             {
-				// get the first object in the object
-				// at this point there must be at least one
-                Object first_obj = object();
-
-				// put them object in with a visitor
-				if (std::holds_alternative<Tkn_Error>(first_obj.token))
-				{
-					o = Object(Token{Tkn_Error{}});
-					return o;
-				}
-
-				token.value.push_back(first_obj);
-
-                // optional objects
-                bool list = true;
-                while (list)
+                // the body goes until the next structural symbol, that may be in a later chunk
+                std::string_view body = lexer.literal();
+                if (lexer.done())
+                {
+                    pending += body;
+                    break;
+                }
+                if (lexer.peek() != Tokenizer::Sym_Quote)
+                    return fail();
+                lexer.advance();
+                if (!pending.empty())
                 {
-                    if (!accept(Tokenizer::Sym_Whitespace))
-                    {
-                        if (accept(Tokenizer::Sym_RightParen))
-						{
-							list = false;
-							break;
-						}
-                    }
-                    if (accept(Tokenizer::Sym_RightParen))
-                    {
-                        list = false;
-                        break;
-                    }
-
-					if (iter == endIter)
-					{
-						o = Object(Token{Tkn_Error{}});
-						list = false;
-						break;
-					}
-                    Object list_obj = object();
-					token.value.push_back(list_obj);
+                    pending += body;
+                    body = pending;
                 }
+                handler.on_literal(Lexer::fold(body, folded));
+                pending.clear();
+                state = State_Between;
+                if (depth == 0)
+                    handler.on_element_end();
+                continue;
+            }
+            switch (lexer.peek())
+            {
+            case Tokenizer::Sym_Whitespace:
+                break;
+            case Tokenizer::Sym_Quote:
+                state = State_Literal;
+                break;
+            case Tokenizer::Sym_Character:
+                state = State_Number;
+                continue;
+            case Tokenizer::Sym_LeftParen:
+                if (++depth > maxDepth)
+                    return fail();
+                handler.on_list_begin();
+                break;
+            case Tokenizer::Sym_RightParen:
+                if (depth == 0)
+                    return fail();
+                depth--;
+                handler.on_list_end();
+                if (depth == 0)
+                    handler.on_element_end();
+                break;
+            default:
+                return fail();
             }
+            lexer.advance();
+        }
+        return state != State_Error;
+    }
+
+    bool PushParser::finish()
+    {
+        // a number at the very end has nothing after it to close it
+        if (state == State_Number && !number())
+            return false;
+        if (state != State_Between || depth != 0)
+            return fail();
+        return true;
+    }
+
+    // pull parser
+    PullParser::PullParser(std::string_view src)
+        : lexer(src)
+    {}
+
+    void PullParser::set_max_depth(std::size_t _maxDepth)
+    {
+        maxDepth = _maxDepth;
+    }
+
+    bool PullParser::accept(Tokenizer::Symbol req)
+    {
+        if (lexer.peek() == req)
+        {
+            lexer.advance();
+            return true;
+        }
+        return false;
+    }
+
+    PullEvent PullParser::fail()
+    {
+        failed = true;
+        return Pull_Error;
+    }
+
+    // the same grammar as Parser::object, one event at a time
+    PullEvent PullParser::next()
+    {
+        if (failed)
+            return Pull_Error;
+        if (done)
+            return Pull_End;
+        while (accept(Tokenizer::Sym_Whitespace));
+        if (depth > 0 && accept(Tokenizer::Sym_RightParen))
+        {
+            done = --depth == 0;
+            return Pull_ListEnd;
         }
-		// outer else:
-		// happens if the object doesn't start with a left paren -> it's a literal (or later something else)
-        else
+        if (accept(Tokenizer::Sym_LeftParen))
+        {
+            if (++depth > maxDepth)
+                return fail();
+            return Pull_ListBegin;
+        }
+        if (lexer.peek() == Tokenizer::Sym_Character)
         {
-			// we try with the literal
-            Object tmp = literal();
-			if (!std::holds_alternative<Tkn_Error>(tmp.token))
-			{
-				auto v = std::get<Tkn_Literal>(tmp.token);
-				o = tmp;
-			}
-			// else try with integer, float and other types
+            std::string_view text = lexer.number();
+            NumberType type = Number::parse(text, integerValue, floatValue);
+            if (type == Number_None)
+                return fail();
+            if (type == Number_Large)
+            {
+                value = text;
+                done = depth == 0;
+                return Pull_Literal;
+            }
+            if (type == Number_Integer)
+                floatValue = double(integerValue);
+            done = depth == 0;
+            return type == Number_Integer ? Pull_Integer : Pull_Float;
         }
-		return o;
+        if (!accept(Tokenizer::Sym_Quote))
+            return fail();
+        std::string_view body = lexer.literal();
+        if (!accept(Tokenizer::Sym_Quote))
+            return fail();
+        value = Lexer::fold(body, folded);
+        done = depth == 0;
+        return Pull_Literal;
+    }
+
+    std::string_view PullParser::literal() const
+    {
+        return value;
     }
 
-    Object Parser::parse(std::list<Tokenizer::SymbolObject> symbolStream)
+    std::int64_t PullParser::integer() const
     {
-        iter = symbolStream.begin();
-		endIter = symbolStream.end();
-        return object();
+        return integerValue;
     }
 
+    double PullParser::floating() const
+    {
+        return floatValue;
+    }
+
+    bool PullParser::skip()
+    {
+        std::size_t until = depth - 1;
+        while (depth > until)
+        {
+            PullEvent event = next();
+            if (event == Pull_Error || event == Pull_End)
+                return false;
+        }
+        return true;
+    }
 }
@@ -0,0 +1,190 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LISON_X86
+#include <immintrin.h>
+#endif
+
+namespace lison
+{
+    using ClassifyFn = BlockMasks (*)(const char*);
+
+    static BlockMasks classifyScalar(const char* block)
+    {
+        BlockMasks m{0, 0, 0, 0};
+        for (std::size_t i = 0; i < Scanner::BlockSize; i++)
+        {
+            std::uint64_t bit = std::uint64_t(1) << i;
+            switch (block[i])
+            {
+            case '\'': m.quote |= bit; break;
+            case '(': m.leftParen |= bit; break;
+            case ')': m.rightParen |= bit; break;
+            case ' ': case '\t': case '\n': m.whitespace |= bit; break;
+            default: break;
+            }
+        }
+        return m;
+    }
+
+#ifdef LISON_X86
+    __attribute__((target("sse2")))
+    static inline std::uint64_t equal128(__m128i v, char c)
+    {
+        return static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c))));
+    }
+
+    __attribute__((target("sse2")))
+    static BlockMasks classifySSE2(const char* block)
+    {
+        BlockMasks m{0, 0, 0, 0};
+        for (std::size_t i = 0; i < Scanner::BlockSize; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+            m.quote |= equal128(v, '\'') << i;
+            m.leftParen |= equal128(v, '(') << i;
+            m.rightParen |= equal128(v, ')') << i;
+            m.whitespace |= (equal128(v, ' ') | equal128(v, '\t') | equal128(v, '\n')) << i;
+        }
+        return m;
+    }
+
+    __attribute__((target("avx2")))
+    static inline std::uint64_t equal256(__m256i v, char c)
+    {
+        return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))));
+    }
+
+    __attribute__((target("avx2")))
+    static BlockMasks classifyAVX2(const char* block)
+    {
+        BlockMasks m{0, 0, 0, 0};
+        for (std::size_t i = 0; i < Scanner::BlockSize; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+            m.quote |= equal256(v, '\'') << i;
+            m.leftParen |= equal256(v, '(') << i;
+            m.rightParen |= equal256(v, ')') << i;
+            m.whitespace |= (equal256(v, ' ') | equal256(v, '\t') | equal256(v, '\n')) << i;
+        }
+        return m;
+    }
+
+    __attribute__((target("avx512f,avx512bw")))
+    static BlockMasks classifyAVX512(const char* block)
+    {
+        __m512i v = _mm512_loadu_si512(block);
+        BlockMasks m;
+        m.quote = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\''));
+        m.leftParen = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('('));
+        m.rightParen = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(')'));
+        m.whitespace = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '))
+            | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\t'))
+            | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+        return m;
+    }
+#endif
+
+    struct ScannerImplementation
+    {
+        const char* name;
+        ClassifyFn fn;
+        bool supported;
+    };
+
+    // the best one first
+    static const std::vector<ScannerImplementation>& scannerImplementations()
+    {
+        static const std::vector<ScannerImplementation> impls = []
+        {
+            std::vector<ScannerImplementation> list;
+#ifdef LISON_X86
+            __builtin_cpu_init();
+            list.push_back({"avx512", classifyAVX512,
+                            __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")});
+            list.push_back({"avx2", classifyAVX2, (bool)__builtin_cpu_supports("avx2")});
+            list.push_back({"sse2", classifySSE2, (bool)__builtin_cpu_supports("sse2")});
+#endif
+            list.push_back({"scalar", classifyScalar, true});
+            return list;
+        }();
+        return impls;
+    }
+
+    // atomic, select can be called while the workers of a parser classify
+    static std::atomic<const ScannerImplementation*>& activeScanner()
+    {
+        static std::atomic<const ScannerImplementation*> active = []
+        {
+            // the scalar one is always supported
+            for (auto& impl : scannerImplementations())
+                if (impl.supported)
+                    return &impl;
+            return &scannerImplementations().back();
+        }();
+        return active;
+    }
+
+    BlockMasks Scanner::classify(const char* block, std::size_t length)
+    {
+        ClassifyFn fn = activeScanner().load(std::memory_order_relaxed)->fn;
+        if (length >= BlockSize)
+            return fn(block);
+        // the tail of the source, zeros are not structural
+        char padded[BlockSize] = {0};
+        std::memcpy(padded, block, length);
+        return fn(padded);
+    }
+
+    std::uint64_t Scanner::literalMask(std::uint64_t quote, bool& inside)
+    {
+        // prefix xor: every bit is the parity of the quotes up to and including it
+        std::uint64_t mask = quote;
+        mask ^= mask << 1;
+        mask ^= mask << 2;
+        mask ^= mask << 4;
+        mask ^= mask << 8;
+        mask ^= mask << 16;
+        mask ^= mask << 32;
+        if (inside)
+            mask = ~mask;
+        inside = (mask >> (BlockSize - 1)) & 1;
+        return mask;
+    }
+
+    const char* Scanner::implementation()
+    {
+        return activeScanner().load(std::memory_order_relaxed)->name;
+    }
+
+    bool Scanner::select(const std::string& name)
+    {
+        for (auto& impl : scannerImplementations())
+        {
+            if (name == impl.name && impl.supported)
+            {
+                activeScanner().store(&impl, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+}
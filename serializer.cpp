@@ -16,9 +16,107 @@
  */
 #include "LiSON_base.h"
 
+// LISON_NO_MMAP turns the mapping off, to read the files the way the systems without mmap do
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(LISON_NO_MMAP)
+#define LISON_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
 namespace lison
 {
+    // source buffer
+    SourceBuffer::~SourceBuffer()
+    {
+#ifdef LISON_MMAP
+        if (mapped)
+            munmap(const_cast<char*>(data), length);
+#endif
+    }
+
+    std::shared_ptr<const SourceBuffer> SourceBuffer::open(const std::string& filename, SourceMode mode)
+    {
+        auto source = std::make_shared<SourceBuffer>();
+#ifdef LISON_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return nullptr;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED)
+            {
+                madvise(addr, st.st_size, mode == Source_Text ? MADV_SEQUENTIAL : MADV_RANDOM);
+                source->data = static_cast<const char*>(addr);
+                source->length = st.st_size;
+                source->mapped = true;
+                close(fd);
+                return source;
+            }
+        }
+        // not a regular file (a pipe, a device): read it from the same descriptor, it can't be opened twice
+        std::vector<char> chunk(64 * 1024);
+        for (;;)
+        {
+            ssize_t n = ::read(fd, chunk.data(), chunk.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                close(fd);
+                return nullptr;
+            }
+            if (n == 0)
+                break;
+            source->buffer.append(chunk.data(), n);
+        }
+        close(fd);
+#else
+        // no mmap: read it in one pass (it may be a pipe), in binary, so the bytes of a binary
+        // encoded file are never converted
+        std::ifstream file;
+        file.open(filename,std::ios_base::in | std::ios_base::binary);
+        if (!file.is_open())
+            return nullptr;
+        std::vector<char> chunk(64 * 1024);
+        while (file)
+        {
+            file.read(chunk.data(), chunk.size());
+            source->buffer.append(chunk.data(), file.gcount());
+        }
+#ifdef _WIN32
+        // the line ends of a text file as the text mode would read them
+        if (mode == Source_Text && !Decoder::detect(source->buffer))
+        {
+            std::string& text = source->buffer;
+            std::size_t out = 0;
+            for (std::size_t i = 0; i < text.size(); i++)
+                if (text[i] != '\r' || i + 1 == text.size() || text[i + 1] != '\n')
+                    text[out++] = text[i];
+            text.resize(out);
+        }
+#endif
+#endif
+        source->data = source->buffer.data();
+        source->length = source->buffer.length();
+        return source;
+    }
+
+    std::string_view SourceBuffer::view() const
+    {
+        return std::string_view(data, length);
+    }
+
+    bool SourceBuffer::isMapped() const
+    {
+        return mapped;
+    }
 
+    // serializer
     Serializer::Serializer(const std::string& _filename)
         :filename(_filename)
     {}
@@ -28,18 +126,33 @@ namespace lison
         this->filename = _filename;
     }
 
+    void Serializer::set_trace(Trace* _trace)
+    {
+        trace = _trace;
+    }
+
     std::string Serializer::read() const
     {
         if (filename.empty())
             return "";
-        std::ifstream file;
-        file.open(filename,std::ios_base::in);
-        if (!file.is_open())
+        std::shared_ptr<const SourceBuffer> source = map();
+        if (!source)
             return "";
-        std::stringstream ss;
-        ss << file.rdbuf();
-        file.close();
-        return ss.str();
+        return std::string(source->view());
+    }
+
+    std::shared_ptr<const SourceBuffer> Serializer::map() const
+    {
+        if (filename.empty())
+            return nullptr;
+#ifdef LISON_TRACE
+        StageTimer reading(trace, Stage_Read);
+        std::shared_ptr<const SourceBuffer> source = SourceBuffer::open(filename);
+        reading.add_bytes(source ? source->view().size() : 0);
+        return source;
+#else
+        return SourceBuffer::open(filename);
+#endif
     }
 
     void Serializer::write(const std::string& source) const
@@ -50,7 +163,123 @@ namespace lison
         file.open(filename,std::ios_base::out);
         if (!file.is_open())
             return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write, source.size());
+#endif
         file << source;
         file.close();
     }
-}
\ No newline at end of file
+
+    void Serializer::write(const Object& obj, WriteMode mode) const
+    {
+        if (filename.empty())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        // big lists are written on all the cores, anything else straight into the file
+        ParallelWriter writer;
+        writer.write(obj, filename, mode);
+    }
+
+    void Serializer::write(const LiSON& lison, WriteMode mode) const
+    {
+        FileWriter writer(filename, mode);
+        if (!writer.is_open())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        lison.serialize(writer);
+    }
+
+    void Serializer::encode(const Object& obj) const
+    {
+        if (filename.empty())
+            return;
+        std::ofstream file;
+        file.open(filename,std::ios_base::out | std::ios_base::binary);
+        if (!file.is_open())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        file << obj.to_binary();
+        file.close();
+    }
+
+    void Serializer::snapshot(const Document& doc) const
+    {
+        if (filename.empty())
+            return;
+        std::ofstream file;
+        file.open(filename,std::ios_base::out | std::ios_base::binary);
+        if (!file.is_open())
+            return;
+#ifdef LISON_TRACE
+        StageTimer writing(trace, Stage_Write);
+#endif
+        file << doc.to_snapshot();
+        file.close();
+    }
+
+    bool Serializer::read(Handler& handler, std::size_t chunkSize) const
+    {
+        Handler* target = &handler;
+#ifdef LISON_TRACE
+        // reading and parsing are done together here
+        TraceHandler counter(handler, trace);
+        if (trace != nullptr)
+            target = &counter;
+        StageTimer parsing(trace, Stage_Parse);
+#endif
+        PushParser parser(*target);
+        std::ifstream file;
+        if (!filename.empty())
+            file.open(filename,std::ios_base::in);
+        if (!file.is_open())
+        {
+            target->on_error();
+            return false;
+        }
+        // the parsing goes on while the file is read, only one chunk is in memory
+        std::vector<char> chunk(chunkSize > Decoder::Magic.size() ? chunkSize : Decoder::Magic.size());
+        bool first = true;
+        while (file)
+        {
+            file.read(chunk.data(), chunk.size());
+            std::string_view part(chunk.data(), file.gcount());
+#ifdef LISON_TRACE
+            parsing.add_bytes(part.size());
+#endif
+            // the binary encoding is decoded in one piece
+            if (first && Decoder::detect(part))
+            {
+                file.close();
+                Decoder decoder;
+#ifdef LISON_TRACE
+                // map times the reading itself, it is not a part of the parsing
+                std::uint64_t read = trace != nullptr ? trace->metrics.stages[Stage_Read].ns : 0;
+#endif
+                std::shared_ptr<const SourceBuffer> source = map();
+#ifdef LISON_TRACE
+                if (trace != nullptr)
+                    parsing.exclude(trace->metrics.stages[Stage_Read].ns - read);
+                if (source)
+                    parsing.add_bytes(source->view().size() - part.size());
+#endif
+                // the source buffer reads an encoded file without any newline conversion
+                if (!source)
+                {
+                    target->on_error();
+                    return false;
+                }
+                return decoder.parse(source->view(), *target);
+            }
+            first = false;
+            if (!parser.feed(part))
+                return false;
+        }
+        return parser.finish();
+    }
+}
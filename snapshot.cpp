@@ -0,0 +1,255 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace lison
+{
+    // start of the file, the node table follows right after it
+    struct SnapshotHeader
+    {
+        char magic[4];
+        std::uint16_t version;
+        // the table is only usable with the same layout and byte order
+        std::uint16_t nodeSize;
+        std::uint32_t order;
+        std::uint32_t reserved;
+        std::uint64_t count;
+        std::uint64_t poolSize;
+    };
+
+    static_assert(sizeof(SnapshotHeader) % alignof(Node) == 0, "the node table must stay aligned");
+
+    // document -> snapshot
+    std::string Document::to_snapshot() const
+    {
+        // the file has to stand on its own, so the borrowed and interned literals go to the pool
+        if (borrowed() || symbolTable)
+        {
+            Document copy = *this;
+            copy.materialize();
+            return copy.to_snapshot();
+        }
+        SnapshotHeader header{};
+        std::memcpy(header.magic, Snapshot::Magic.data(), Snapshot::Magic.size());
+        header.version = Snapshot::Version;
+        header.nodeSize = sizeof(Node);
+        header.order = 1;
+        header.count = nodes.size();
+        header.poolSize = pool.size();
+
+        std::string out;
+        out.reserve(sizeof(header) + nodes.size() * sizeof(Node) + pool.size());
+        out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.append(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(Node));
+        out += pool;
+        return out;
+    }
+
+    // snapshot
+    Snapshot Snapshot::open(const std::string& filename)
+    {
+        return load(SourceBuffer::open(filename, Source_Binary));
+    }
+
+    Snapshot Snapshot::load(std::shared_ptr<const SourceBuffer> source)
+    {
+        Snapshot snap;
+        if (!source)
+            return snap;
+        std::string_view data = source->view();
+        SnapshotHeader header;
+        if (data.size() < sizeof(header))
+            return snap;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::string_view(header.magic, sizeof(header.magic)) != Magic || header.version != Version
+            || header.nodeSize != sizeof(Node) || header.order != 1)
+            return snap;
+        // only the sizes are checked, the nodes are checked when they are looked up
+        std::size_t rest = data.size() - sizeof(header);
+        if (header.count > std::numeric_limits<std::uint32_t>::max() || header.count > rest / sizeof(Node)
+            || header.poolSize != rest - header.count * sizeof(Node))
+            return snap;
+        // the table is used in place, so it has to be aligned like in memory
+        const char* table = data.data() + sizeof(header);
+        if (reinterpret_cast<std::uintptr_t>(table) % alignof(Node) != 0)
+            return snap;
+        snap.owner = source;
+        snap.nodes = reinterpret_cast<const Node*>(table);
+        snap.count = header.count;
+        snap.pool = data.substr(sizeof(header) + header.count * sizeof(Node));
+        return snap;
+    }
+
+    bool Snapshot::valid() const
+    {
+        return owner != nullptr;
+    }
+
+    SnapshotView Snapshot::root() const
+    {
+        return SnapshotView(this, 0);
+    }
+
+    std::size_t Snapshot::size() const
+    {
+        return count;
+    }
+
+    std::string Snapshot::to_string(WriteMode mode) const
+    {
+        return root().to_string(mode);
+    }
+
+    std::optional<std::string_view> Snapshot::literal(std::uint32_t index) const
+    {
+        const Node& n = nodes[index];
+        if (n.offset > pool.size() || n.length > pool.size() - n.offset)
+            return {};
+        return {pool.substr(n.offset, n.length)};
+    }
+
+    void Snapshot::write(std::uint32_t index, Writer& writer) const
+    {
+        // ends of the lists that are still open
+        std::vector<std::uint32_t> open;
+        std::uint32_t to = std::min(nodes[index].next, count);
+        for (std::uint32_t i = index; i < to; i++)
+        {
+            for (; !open.empty() && open.back() <= i; open.pop_back())
+                writer.end_list();
+            std::optional<std::string_view> value;
+            switch (nodes[i].type)
+            {
+            case Node_Literal:
+                value = literal(i);
+                if (value)
+                    writer.literal(*value);
+                else
+                    writer.error();
+                break;
+            case Node_List:
+                writer.begin_list();
+                open.push_back(nodes[i].next);
+                break;
+            case Node_Integer:
+                writer.integer(std::int64_t(nodes[i].offset));
+                break;
+            case Node_Float:
+                writer.floating(Number::fromBits(nodes[i].offset));
+                break;
+            default:
+                writer.error();
+            }
+        }
+        for (; !open.empty(); open.pop_back())
+            writer.end_list();
+    }
+
+    // view
+    SnapshotView::SnapshotView(const Snapshot* _snap, std::uint32_t _index)
+        : snap(_snap), index(_index)
+    {}
+
+    bool SnapshotView::valid() const
+    {
+        return snap != nullptr && index < snap->count;
+    }
+
+    NodeType SnapshotView::type() const
+    {
+        if (!valid())
+            return Node_Error;
+        return snap->nodes[index].type;
+    }
+
+    std::size_t SnapshotView::size() const
+    {
+        if (type() != Node_List)
+            return 0;
+        return snap->nodes[index].length;
+    }
+
+    SnapshotView SnapshotView::child(std::size_t i) const
+    {
+        if (i >= size())
+            return SnapshotView();
+        std::uint32_t end = snap->nodes[index].next;
+        std::uint32_t c = index + 1;
+        for (; i > 0 && c < end && c < snap->count && snap->nodes[c].next > c; i--)
+            c = snap->nodes[c].next;
+        if (i > 0 || c >= end)
+            return SnapshotView();
+        return SnapshotView(snap, c);
+    }
+
+    SnapshotView SnapshotView::parent() const
+    {
+        if (!valid())
+            return SnapshotView();
+        return SnapshotView(snap, snap->nodes[index].parent);
+    }
+
+    std::string SnapshotView::to_string(WriteMode mode) const
+    {
+        std::string out;
+        StringWriter writer(out, mode);
+        if (valid())
+            snap->write(index, writer);
+        return out;
+    }
+
+    Object SnapshotView::toObject() const
+    {
+        if (!valid())
+            return Object(Token{Tkn_Error{}});
+        ObjectBuilder builder;
+        snap->write(index, builder);
+        return builder.take();
+    }
+
+    void SnapshotView::foreachObjectData(
+        std::function<void(const SnapshotView&)> f) const
+    {
+        visitObjectData(f);
+    }
+
+    std::optional<std::string_view> SnapshotView::expectLiteralData() const
+    {
+        if (type() != Node_Literal)
+            return {};
+        return snap->literal(index);
+    }
+
+    std::optional<std::int64_t> SnapshotView::expectInteger() const
+    {
+        if (type() != Node_Integer)
+            return {};
+        return {std::int64_t(snap->nodes[index].offset)};
+    }
+
+    std::optional<double> SnapshotView::expectFloat() const
+    {
+        if (type() == Node_Float)
+            return {Number::fromBits(snap->nodes[index].offset)};
+        if (type() == Node_Integer)
+            return {double(std::int64_t(snap->nodes[index].offset))};
+        return {};
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+
+namespace lison
+{
+    std::uint32_t SymbolTable::intern(std::string_view name)
+    {
+        auto it = ids.find(name);
+        if (it != ids.end())
+            return it->second;
+        std::uint32_t id = names.size();
+        const std::string& stored = names.emplace_back(name);
+        ids.emplace(stored, id);
+        return id;
+    }
+
+    std::optional<std::uint32_t> SymbolTable::find(std::string_view name) const
+    {
+        auto it = ids.find(name);
+        if (it == ids.end())
+            return {};
+        return {it->second};
+    }
+
+    std::string_view SymbolTable::name(std::uint32_t id) const
+    {
+        if (id >= names.size())
+            return {};
+        return names[id];
+    }
+
+    std::size_t SymbolTable::size() const
+    {
+        return names.size();
+    }
+}
@@ -15,33 +15,110 @@
  *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "LiSON_base.h"
+#include <algorithm>
 
 namespace lison
 {
-    std::list<Tokenizer::SymbolObject> Tokenizer::tokenize(const std::string& src)
+    Tokenizer::Symbol Tokenizer::classify(char c)
     {
-        std::list<SymbolObject> symbolStream;
+        if (c == '\'')
+            return Sym_Quote;
+        else if (c == '(')
+            return Sym_LeftParen;
+        else if (c == ')')
+            return Sym_RightParen;
+        else if (c == '\t' || c == '\n' || c == ' ')
+            return Sym_Whitespace;
+        else
+            return Sym_Character;
+    }
+
+    void Tokenizer::set_memory_resource(std::pmr::memory_resource* _resource)
+    {
+        resource = _resource;
+    }
+
+    std::pmr::list<Tokenizer::SymbolObject> Tokenizer::tokenize(const std::string& src)
+    {
+        std::pmr::list<SymbolObject> symbolStream(resource);
         for (unsigned i=0;i<src.length();i++)
         {
             char c = src[i];
             SymbolObject sym;
-            if (c == '\'')
-                sym.sym = Sym_Quote;
-            else if (c == '(')
-                sym.sym = Sym_LeftParen;
-            else if (c == ')')
-                sym.sym = Sym_RightParen;
-            else if (c == '\t' || c == '\n' || c == ' ')
+            sym.sym = classify(c);
+            if (sym.sym == Sym_Character)
+                sym.character = c;
+            symbolStream.push_back(sym);
+        }
+        return symbolStream;
+    }
+
+    // lexer
+    Lexer::Lexer(std::string_view _src)
+        : src(_src)
+    {}
+
+    Tokenizer::Symbol Lexer::peek() const
+    {
+        if (pos >= src.length())
+            return Tokenizer::Sym_NIL;
+        return Tokenizer::classify(src[pos]);
+    }
+
+    void Lexer::advance()
+    {
+        if (pos < src.length())
+            ++pos;
+    }
+
+    bool Lexer::done() const
+    {
+        return pos >= src.length();
+    }
+
+    std::string_view Lexer::literal()
+    {
+        // jumps to the next structural character a block at a time
+        std::size_t start = pos;
+        while (pos < src.length())
+        {
+            std::size_t current = pos - pos % Scanner::BlockSize;
+            if (current != block)
             {
-                sym.sym = Sym_Whitespace;
+                BlockMasks m = Scanner::classify(src.data() + current,
+                                                 std::min(Scanner::BlockSize, src.length() - current));
+                structural = m.quote | m.leftParen | m.rightParen;
+                block = current;
             }
-            else
+            std::uint64_t ahead = structural >> (pos - current);
+            if (ahead != 0)
             {
-                sym.sym = Sym_Character;
-                sym.character = c;
+                pos += __builtin_ctzll(ahead);
+                break;
             }
-            symbolStream.push_back(sym);
+            pos = current + Scanner::BlockSize;
         }
-        return symbolStream;
+        if (pos > src.length())
+            pos = src.length();
+        return src.substr(start, pos - start);
+    }
+
+    std::string_view Lexer::number()
+    {
+        std::size_t start = pos;
+        while (peek() == Tokenizer::Sym_Character)
+            ++pos;
+        return src.substr(start, pos - start);
+    }
+
+    std::string_view Lexer::fold(std::string_view body, std::string& buffer)
+    {
+        if (body.find_first_of("\t\n") == std::string_view::npos)
+            return body;
+        buffer.assign(body);
+        for (char& c : buffer)
+            if (c == '\t' || c == '\n')
+                c = ' ';
+        return buffer;
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,128 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <algorithm>
+
+namespace lison
+{
+    void Trace::reset()
+    {
+        metrics = Metrics();
+    }
+
+#ifdef LISON_TRACE
+    // stage timer
+    StageTimer::StageTimer(Trace* _trace, Stage _stage, std::uint64_t _bytes)
+        : trace(_trace), stage(_stage), bytes(_bytes)
+    {
+        if (trace == nullptr)
+            return;
+        startAllocations = Allocations::stats();
+        start = std::chrono::steady_clock::now();
+    }
+
+    StageTimer::~StageTimer()
+    {
+        stop();
+    }
+
+    void StageTimer::add_bytes(std::uint64_t n)
+    {
+        bytes += n;
+    }
+
+    void StageTimer::exclude(std::uint64_t ns)
+    {
+        excluded += ns;
+    }
+
+    void StageTimer::stop()
+    {
+        if (trace == nullptr || !running)
+            return;
+        running = false;
+        std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        ns -= std::min(ns, excluded);
+        StageMetrics& m = trace->metrics.stages[stage];
+        m.calls++;
+        m.ns += ns;
+        m.bytes += bytes;
+        AllocationStats now = Allocations::stats();
+        m.allocations += now.allocations - startAllocations.allocations;
+        m.allocatedBytes += now.allocatedBytes - startAllocations.allocatedBytes;
+        trace->on_stage(stage, ns, bytes);
+    }
+
+    // counting handler
+    TraceHandler::TraceHandler(Handler& _handler, Trace* _trace)
+        : handler(_handler), trace(_trace)
+    {}
+
+    void TraceHandler::on_list_begin()
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        m.maxDepth = std::max(m.maxDepth, ++depth);
+        handler.on_list_begin();
+    }
+
+    void TraceHandler::on_list_end()
+    {
+        trace->metrics.symbols++;
+        depth--;
+        handler.on_list_end();
+    }
+
+    void TraceHandler::on_literal(std::string_view value)
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        m.literalBytes += value.size();
+        handler.on_literal(value);
+    }
+
+    void TraceHandler::on_integer(std::int64_t value)
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        handler.on_integer(value);
+    }
+
+    void TraceHandler::on_float(double value)
+    {
+        Metrics& m = trace->metrics;
+        m.symbols++;
+        m.nodes++;
+        handler.on_float(value);
+    }
+
+    void TraceHandler::on_element_end()
+    {
+        handler.on_element_end();
+    }
+
+    void TraceHandler::on_error()
+    {
+        depth = 0;
+        handler.on_error();
+    }
+#endif
+}
@@ -0,0 +1,206 @@
+/**
+ *     Copyright (C) 2022  Tóth Bálint
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "LiSON_base.h"
+#include <cmath>
+
+namespace lison
+{
+    // text writer
+    TextWriter::TextWriter(std::string* _out, std::size_t _limit, WriteMode _mode)
+        : mode(_mode), out(_out), limit(_limit)
+    {}
+
+    void TextWriter::put(char c)
+    {
+        *out += c;
+        if (out->size() >= limit)
+            drain();
+    }
+
+    void TextWriter::put(std::string_view s)
+    {
+        out->append(s.data(), s.size());
+        if (out->size() >= limit)
+            drain();
+    }
+
+    void TextWriter::newline()
+    {
+        put('\n');
+        separate = false;
+    }
+
+    // in compact mode only the siblings are separated
+    void TextWriter::element()
+    {
+        if (mode == Write_Compact && separate)
+            put(' ');
+    }
+
+    void TextWriter::begin_list()
+    {
+        element();
+        put(mode == Write_Padded ? "( " : "(");
+        separate = false;
+    }
+
+    void TextWriter::end_list()
+    {
+        put(mode == Write_Padded ? ") " : ")");
+        separate = true;
+    }
+
+    void TextWriter::literal(std::string_view value)
+    {
+        element();
+        put('\'');
+        put(value);
+        put(mode == Write_Padded ? "' " : "'");
+        separate = true;
+    }
+
+    // a number is written without the quotes, if it has a number form
+    void TextWriter::integer(std::int64_t value)
+    {
+        char buffer[Number::MaxLength];
+        element();
+        put(Number::format(value, buffer));
+        if (mode == Write_Padded)
+            put(' ');
+        separate = true;
+    }
+
+    void TextWriter::floating(double value)
+    {
+        if (!std::isfinite(value))
+        {
+            Writer::floating(value);
+            return;
+        }
+        char buffer[Number::MaxLength];
+        element();
+        put(Number::format(value, buffer));
+        if (mode == Write_Padded)
+            put(' ');
+        separate = true;
+    }
+
+    void TextWriter::error()
+    {
+        element();
+        put(mode == Write_Padded ? "ERROR " : "ERROR");
+        separate = true;
+    }
+
+    // string writer, the string is the output, there is nothing to drain
+    StringWriter::StringWriter(std::string& _out, WriteMode _mode)
+        : TextWriter(&_out, std::string::npos, _mode)
+    {}
+
+    // stream writer
+    StreamWriter::StreamWriter(std::ostream& _stream, WriteMode _mode)
+        : TextWriter(&buffer, BufferSize, _mode), stream(_stream)
+    {
+        buffer.reserve(BufferSize);
+    }
+
+    StreamWriter::~StreamWriter()
+    {
+        flush();
+    }
+
+    void StreamWriter::drain()
+    {
+        stream.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void StreamWriter::flush()
+    {
+        drain();
+        stream.flush();
+    }
+
+    // file writer
+    FileWriter::FileWriter(const std::string& filename, WriteMode _mode)
+        : TextWriter(&buffer, StreamWriter::BufferSize, _mode)
+    {
+        if (!filename.empty())
+            file.open(filename, std::ios_base::out);
+        buffer.reserve(StreamWriter::BufferSize);
+    }
+
+    FileWriter::~FileWriter()
+    {
+        flush();
+    }
+
+    bool FileWriter::is_open() const
+    {
+        return file.is_open();
+    }
+
+    void FileWriter::drain()
+    {
+        // nowhere to write, the output is dropped
+        if (file.is_open())
+            file.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void FileWriter::flush()
+    {
+        drain();
+        if (file.is_open())
+            file.flush();
+    }
+
+    // handler -> writer
+    WriteHandler::WriteHandler(Writer& _writer)
+        : writer(_writer)
+    {}
+
+    void WriteHandler::on_list_begin()
+    {
+        writer.begin_list();
+    }
+
+    void WriteHandler::on_list_end()
+    {
+        writer.end_list();
+    }
+
+    void WriteHandler::on_literal(std::string_view value)
+    {
+        writer.literal(value);
+    }
+
+    void WriteHandler::on_integer(std::int64_t value)
+    {
+        writer.integer(value);
+    }
+
+    void WriteHandler::on_float(double value)
+    {
+        writer.floating(value);
+    }
+
+    void WriteHandler::on_error()
+    {
+        writer.error();
+    }
+}